@@ -2,15 +2,35 @@
 #include <string.h>
 #include <math.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <time.h>
+#include <limits.h>
+#include <threads.h>
+#include <stdatomic.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAS_SSE2
+#include <emmintrin.h>
+#endif
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include <raylib.h>
 #include <rlgl.h>
 #include <stb_rect_pack.h>
+#include <stb_image_write.h>	// implemented inside raylib, like stb_rect_pack
 
 #pragma region Defines
 
 #define DEV
 #define LOG_PRINT true
+//#define DUMP_ATLASES	// write the packed atlases out as PNGs at startup, for debugging
 
 // resource related defines
 #ifdef EDIT_MODE
@@ -21,15 +41,63 @@
 #define SPRITES_PATH 			"assets/sprites"
 #define SOUNDS_PATH 			"assets/sounds"
 #define BACKGROUNDS_PATH 		"assets/backgrounds"
+#define LEVELS_PATH 			"assets/levels"
+#define TILES_PATH 				"assets/tiles"
+#define ATLAS_CACHE_PATH 		"atlas.cache"
 #define MAX_PATH_LEN 256
 
 #define GAME_WIDTH 			256
 #define GAME_HEIGHT 		224
 
+// headless simulation defines
+#define HEADLESS_DEFAULT_TICKS	1000000
+#define SOFT_RENDER_IMAGE_TICKS	60		// ticks between the frames --render writes out as images (every frame is hashed)
+
+// simulation timing defines
+#define SIM_TICK_RATE			60	// simulation ticks per second, independent of the display refresh rate
+#define SIM_MAX_TICKS_PER_FRAME	5	// caps catch-up after a long frame, so a hitch can't snowball
+
 // game related defines
 #define MAX_CONTROLLERS 4
 #define ENTITY_DEFAULT_ALLOCATION_SIZE 64
 
+// atlas cache defines
+#define ATLAS_CACHE_MAGIC 			"SFMA"
+#define ATLAS_CACHE_VERSION 		3		// bump whenever atlas building changes, to invalidate existing caches
+#define ASSET_DECODE_THREADS 		4		// threads decoding images & .dat files when the atlases are built
+
+// job system defines
+#define JOB_THREADS 				4		// default threads entities think on, including the main thread
+#define JOB_MAX_THREADS 			16
+#define JOB_QUEUE_SIZE 				256		// batches per thread queue, a power of two
+
+// level file defines
+#define LEVEL_FILE_MAGIC 			"SFML"
+#define LEVEL_FILE_VERSION 			1
+#define LEVEL_FILE_ALIGNMENT 		64		// sections are aligned so bitplanes can be used in place
+#define LEVEL_BACKGROUND_NAME_LEN 	32
+#define LEVEL_MIN_TILE_SIZE 		8		// smallest tile size a level can use (render snapshots are sized for it)
+
+// input recording defines
+#define INPUT_RECORDING_MAGIC 		"SFMI"
+#define INPUT_RECORDING_VERSION 	1
+#define CONTROLLER_PACKED_BITS 		10		// bits per controller per tick in a packed input frame
+
+// frame capture defines
+#define FRAME_CAPTURE_MAGIC 		"SFMC"
+#define FRAME_CAPTURE_VERSION 		1
+#define FRAME_CAPTURE_RING_SIZE 	8		// frames waiting on the encoder before new ones are dropped
+
+// entity defines
+#define BROADPHASE_CELL_TILES	4		// width & height of a broadphase cell, in tiles
+#define ENTITY_THINK_BATCH_SIZE	256		// entities per job when thinking
+#define ENTITY_SPAWN_MARGIN		2		// tiles out of view at which spawns trigger
+#define ENTITY_SLEEP_MARGIN		4		// tiles out of view past which entities sleep
+#define ENTITY_DESPAWN_MARGIN	12		// tiles out of view past which entities despawn
+
+// enemy speeds
+#define GOOMBA_WALK_SPEED 		0.5f
+
 // player speeds
 #define PLAYER_WALK_SPEED 		1.25f
 #define PLAYER_RUN_SPEED 		2.25f
@@ -41,6 +109,7 @@
 #define PLAYER_TURN_AIR			0.15625f
 #define PLAYER_GRAVITY			0.375f
 #define PLAYER_GRAVITY_HOLD		0.1875f
+#define PLAYER_STOMP_BOUNCE		4.0f		// upward speed after landing on an enemy
 
 // background colors
 #define ORANGE_SKY	(Color) { 255, 231, 181, 255 }
@@ -51,14 +120,42 @@
 #define EDITOR_GRADIENT_BOTTOM 	((Color) { .b = 255, .a = 255 })
 
 // texture atlas defines
-#define TEXTURE_ATLAS_WIDTH 	512
+#define TEXTURE_ATLAS_WIDTH 	512		// size of a sprite atlas page
 #define TEXTURE_ATLAS_HEIGHT 	512
-#define MAX_TEXTURE_NODES 		1024
+#define ATLAS_MAX_PAGES 		8		// pages an atlas can spill onto when its contents outgrow one
+#define SPRITE_BATCH_SIZE 		256		// initial capacity of the sprite draw queue
+#define SPRITE_BATCH_MAX_QUADS 	65536	// quads that can be queued per frame; any more are dropped (see sprite_batch_stats_t)
+#define SPRITE_BATCH_CHUNK 		1024	// most quads handed to rlgl at once, so a run never overflows its vertex buffer
 
 #define TILE_ATLAS_WIDTH 		1024
 #define TILE_ATLAS_HEIGHT 		1024
 #define DEFAULT_TILE_SIZE 		16
-#define MAX_TILE_NODES 			8192
+
+// tilemap storage defines
+#define TILEMAP_CHUNK_SHIFT		4							// chunks are 16x16 tiles
+#define TILEMAP_CHUNK_SIZE		(1 << TILEMAP_CHUNK_SHIFT)
+#define TILEMAP_CHUNK_MASK		(TILEMAP_CHUNK_SIZE - 1)
+#define TILE_COLLISION_MASK		0x03						// bits of a packed tile holding its collision type
+
+// tilemap streaming defines
+#define TILEMAP_SEGMENT_WIDTH		64	// columns per streamed segment (one bitplane word)
+#define TILEMAP_STREAM_SEGMENTS		8	// segments kept in memory (power of two)
+#define TILEMAP_STREAM_VISIBLE		2	// segments either side of the camera the simulation can see
+#define TILEMAP_STREAM_BEHIND		3	// segments kept behind the player when the window moves
+
+// tile layer rendering defines
+#define TILE_LAYER_CACHE_SIZE	16									// chunk render textures kept (a screen shows at most 4)
+#define TILE_LAYER_COLOR		((Color) { 0, 200, 255, 48 })		// outline of static tiles
+#define TILE_GLOW_RADIUS		64.0f								// reach of the debug glow around the player, in pixels
+
+// render snapshot defines
+#define RENDER_SNAPSHOT_ENTITIES	2048	// entities a snapshot holds; any more in view aren't drawn
+#define RENDER_SNAPSHOT_CHUNK_PX	(TILEMAP_CHUNK_SIZE * LEVEL_MIN_TILE_SIZE)
+#define RENDER_SNAPSHOT_CHUNKS		((GAME_WIDTH / RENDER_SNAPSHOT_CHUNK_PX + 3) * (GAME_HEIGHT / RENDER_SNAPSHOT_CHUNK_PX + 3))	// tile chunks a snapshot holds: a screen & up to a chunk of movement, at the smallest tile size
+#define RENDER_SNAPSHOT_FRESH		4		// flags a snapshot buffer index as published but not yet read
+
+// hud defines
+#define HUD_TEXT_SIZE	64	// longest text a HUD element shows, including the terminator
 
 // array list defines
 #define ARRAYLIST_NULL -1
@@ -86,6 +183,9 @@ typedef struct game game_t;
 struct render_context;
 typedef struct render_context render_context_t;
 
+struct soft_renderer;
+typedef struct soft_renderer soft_renderer_t;
+
 struct entity;
 typedef struct entity entity_t;
 
@@ -103,13 +203,17 @@ typedef struct editor editor_t;
 struct level;
 typedef struct level level_t;
 void level_update(level_t*, game_t*);
-void level_draw(level_t*, render_context_t*);
+struct render_snapshot;
+typedef struct render_snapshot render_snapshot_t;
+void level_snapshot(const level_t*, render_snapshot_t*);
+void level_draw_prepare(level_t*, const render_snapshot_t*, render_context_t*);
+void level_draw(level_t*, const render_snapshot_t*, render_context_t*);
 
 struct player;
 typedef struct player player_t;
 void player_init(player_t*);
 void player_update(player_t*, level_t*, controller_state_t*);
-void player_draw(player_t*, level_t*, render_context_t*);
+void player_draw(const render_snapshot_t*, render_context_t*);
 
 #pragma endregion
 
@@ -120,7 +224,19 @@ void player_draw(player_t*, level_t*, render_context_t*);
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 #define CLAMP(v, a, b) (MAX(MIN(v, b), a))
-#define RAND_INT(min, max) (min + rand() / (RAND_MAX / (max - min + 1) + 1))
+#define RAND_INT(min, max) (min + rng_next() % (max - min + 1))
+
+float lerp(float a, float b, float t) {
+	return a + (b - a) * t;
+}
+
+/**
+ * Same as (int)floorf(v), without a libm call on targets lacking a rounding instruction
+ */
+static inline int floor_to_int(float v) {
+	int i = (int)v;
+	return i - (v < i);
+}
 
 double distance(double x1, double y1, double x2, double y2) {
     double square_difference_x = (x2 - x1) * (x2 - x1);
@@ -132,6 +248,67 @@ double distance(double x1, double y1, double x2, double y2) {
 
 #pragma endregion
 
+#pragma region Random & Hashing
+
+// game rng state. owned by the game rather than libc's rand(), so that it can be hashed and
+// produces the same sequence on every platform
+uint64_t rng_state;
+
+void rng_seed(uint64_t seed) {
+	rng_state = seed;
+}
+
+// splitmix64
+uint32_t rng_next(void) {
+	uint64_t z = (rng_state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return (uint32_t)((z ^ (z >> 31)) >> 32);
+}
+
+/**
+ * Folds a 64-bit value into a running hash
+ * @param h	Running hash
+ * @param v	Value to fold in
+ * @return New running hash
+ */
+static inline uint64_t hash_combine(uint64_t h, uint64_t v) {
+	h = (h ^ v) * 0x9e3779b97f4a7c15ull;
+	return h ^ (h >> 32);
+}
+
+/**
+ * Folds a block of bytes into a running hash
+ * @param h		Running hash
+ * @param data	Bytes to fold in
+ * @param size	Number of bytes
+ * @return New running hash
+ */
+uint64_t hash_bytes(uint64_t h, const void* data, size_t size) {
+	const uint8_t* bytes = data;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t v;
+		memcpy(&v, bytes + i, sizeof v);
+		h = hash_combine(h, v);
+	}
+	uint64_t tail = 0;
+	memcpy(&tail, bytes + i, size - i);
+	return hash_combine(h, tail ^ ((uint64_t)size << 56));
+}
+
+/**
+ * Packs two floats bit-for-bit into a single value for hashing
+ */
+static inline uint64_t hash_floats(float a, float b) {
+	uint32_t ua, ub;
+	memcpy(&ua, &a, sizeof ua);
+	memcpy(&ub, &b, sizeof ub);
+	return ((uint64_t)ua << 32) | ub;
+}
+
+#pragma endregion
+
 #pragma region IO
 
 /**
@@ -152,6 +329,372 @@ void path_index(const char* src_loc, char* dest_loc) {
 	dest_loc[fname_len] = '\0';
 }
 
+// a file's contents, either memory mapped (copy-on-write) or, where mmap isn't available, read into one allocation
+typedef struct mapped_file {
+	void* data;
+	size_t size;
+	bool mapped;
+} mapped_file_t;
+
+/**
+ * Maps a file into memory. Writes to the mapping are private to the process
+ * @param path	Path of the file to map
+ * @param file	Mapped file to initialize
+ * @return Whether the file could be mapped
+ */
+bool mapped_file_open(const char* path, mapped_file_t* file) {
+	*file = (mapped_file_t) { 0 };
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+	void* data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+	*file = (mapped_file_t) { .data = data, .size = (size_t)st.st_size, .mapped = true };
+	return true;
+#else
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) {
+		return false;
+	}
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	void* data = (size > 0) ? malloc((size_t)size) : NULL;
+	if (data == NULL || fread(data, 1, (size_t)size, f) != (size_t)size) {
+		free(data);
+		fclose(f);
+		return false;
+	}
+	fclose(f);
+	*file = (mapped_file_t) { .data = data, .size = (size_t)size };
+	return true;
+#endif
+}
+
+void mapped_file_close(mapped_file_t* file) {
+	if (file->data == NULL) {
+		return;
+	}
+#ifndef _WIN32
+	if (file->mapped) {
+		munmap(file->data, file->size);
+	}
+#endif
+	if (!file->mapped) {
+		free(file->data);
+	}
+	*file = (mapped_file_t) { 0 };
+}
+
+#pragma endregion
+
+#pragma region Bit Operations
+
+// count trailing zeros / index of the highest set bit. v must not be 0
+static inline int bit_ctz64(uint64_t v) {
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanForward64(&i, v);
+	return (int)i;
+#else
+	return __builtin_ctzll(v);
+#endif
+}
+
+static inline int bit_highest64(uint64_t v) {
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanReverse64(&i, v);
+	return (int)i;
+#else
+	return 63 - __builtin_clzll(v);
+#endif
+}
+
+/**
+ * Extracts a span of up to 64 bits from a line of packed bits. Bits outside of [begin, end) read as 0
+ * @param line		Packed bits, 64 per word
+ * @param begin		Index of the first valid bit of the line
+ * @param end		Index past the last valid bit of the line
+ * @param start		Index of the first bit of the span (may be negative)
+ * @param count		Number of bits in the span [1, 64]
+ * @param word_mask	Wraps word indices into the line (-1 for a line that isn't a ring)
+ * @return Bits of the span, with the bit at start in bit 0
+ */
+static inline uint64_t bit_span(const uint64_t* line, int begin, int end, int start, int count, int word_mask) {
+	int first = MAX(start, begin), last = MIN(start + count, end);
+	if (first >= last) {
+		return 0;
+	}
+	int word = first >> 6, bit = first & 63;
+	int n = last - first;
+	uint64_t v = line[word & word_mask] >> bit;
+	if (n > 64 - bit) {
+		v |= line[(word + 1) & word_mask] << (64 - bit);
+	}
+	if (n < 64) {
+		v &= (1ull << n) - 1;
+	}
+	return v << (first - start);
+}
+
+#pragma endregion
+
+#pragma region Timing
+
+/**
+ * Gets a monotonic-enough wall clock time, usable without a window (raylib's GetTime needs one)
+ * @return Time in seconds
+ */
+double time_now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#pragma endregion
+
+#pragma region Parallel For
+
+typedef void (*parallel_job_t)(void* context, int index);
+
+typedef struct parallel_for {
+	parallel_job_t job;
+	void* context;
+	int count;
+	atomic_int next;	// next index to be claimed
+} parallel_for_t;
+
+int parallel_for_worker(void* arg) {
+	parallel_for_t* work = arg;
+	for (int i; (i = atomic_fetch_add(&work->next, 1)) < work->count;) {
+		work->job(work->context, i);
+	}
+	return 0;
+}
+
+/**
+ * Runs a job for every index in [0, count) across a number of threads (including the calling one),
+ * returning once all of them are done. Indices are handed out one at a time, so uneven jobs balance out
+ * @param count			Number of indices
+ * @param thread_count	Maximum number of threads to use
+ * @param job			Job to run for each index
+ * @param context		Passed through to the job
+ */
+void parallel_for(int count, int thread_count, parallel_job_t job, void* context) {
+	parallel_for_t work = { .job = job, .context = context, .count = count };
+	atomic_init(&work.next, 0);
+
+	thrd_t threads[64];
+	int spawned = 0;
+	thread_count = CLAMP(MIN(thread_count, count), 1, 64);
+	for (int i = 1; i < thread_count; ++i) {
+		if (thrd_create(&threads[spawned], parallel_for_worker, &work) == thrd_success) {
+			++spawned;
+		}
+	}
+	parallel_for_worker(&work);
+	for (int i = 0; i < spawned; ++i) {
+		thrd_join(threads[i], NULL);
+	}
+}
+
+#pragma endregion
+
+#pragma region Job System
+
+/*
+ * A small pool of persistent worker threads for splitting a loop into batches. Each thread (the
+ * calling one included) has its own queue of batches: it works through its own queue from the back,
+ * and once that's empty, steals from the front of the others' queues. So uneven batches balance out
+ * without every batch going through one shared counter. Which thread runs a batch is up to timing,
+ * so jobs must not depend on it, nor on the order batches run in.
+ */
+
+typedef void (*job_batch_t)(void* context, int begin, int end);
+
+typedef struct job {
+	job_batch_t run;
+	void* context;
+	int begin, end;
+} job_t;
+
+typedef struct job_queue {
+	mtx_t lock;
+	job_t jobs[JOB_QUEUE_SIZE];
+	int head, tail;		// the owner takes from the tail, thieves from the head
+} job_queue_t;
+
+typedef struct job_system {
+	int thread_count;	// including the thread calling job_system_run
+	thrd_t threads[JOB_MAX_THREADS];
+	job_queue_t queues[JOB_MAX_THREADS];
+	mtx_t lock;
+	cnd_t wake, done;
+	unsigned long round;	// bumped whenever there's new work, under lock
+	atomic_int pending;		// batches not yet finished
+	bool quit;
+} job_system_t;
+
+/**
+ * Takes a batch for a thread: from the back of its own queue, or else from the front of another's
+ * @return False if every queue is empty
+ */
+bool job_take(job_system_t* jobs, int self, job_t* job) {
+	for (int i = 0; i < jobs->thread_count; ++i) {
+		job_queue_t* queue = &jobs->queues[(self + i) % jobs->thread_count];
+		mtx_lock(&queue->lock);
+		bool found = queue->head != queue->tail;
+		if (found) {
+			*job = (i == 0) ? queue->jobs[--queue->tail & (JOB_QUEUE_SIZE - 1)] : queue->jobs[queue->head++ & (JOB_QUEUE_SIZE - 1)];
+		}
+		mtx_unlock(&queue->lock);
+		if (found) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Runs batches until none are left to take
+ */
+void job_work(job_system_t* jobs, int self) {
+	job_t job;
+	while (job_take(jobs, self, &job)) {
+		job.run(job.context, job.begin, job.end);
+		if (atomic_fetch_sub(&jobs->pending, 1) == 1) {
+			mtx_lock(&jobs->lock);
+			cnd_broadcast(&jobs->done);
+			mtx_unlock(&jobs->lock);
+		}
+	}
+}
+
+typedef struct job_worker_arg {
+	job_system_t* jobs;
+	int self;
+} job_worker_arg_t;
+
+int job_worker(void* arg) {
+	job_worker_arg_t worker = *(job_worker_arg_t*)arg;
+	free(arg);
+	job_system_t* jobs = worker.jobs;
+	unsigned long seen = 0;
+	mtx_lock(&jobs->lock);
+	while (!jobs->quit) {
+		if (jobs->round == seen) {
+			cnd_wait(&jobs->wake, &jobs->lock);
+			continue;
+		}
+		// every batch of a round is queued before the round is bumped
+		seen = jobs->round;
+		mtx_unlock(&jobs->lock);
+		job_work(jobs, worker.self);
+		mtx_lock(&jobs->lock);
+	}
+	mtx_unlock(&jobs->lock);
+	return 0;
+}
+
+/**
+ * Starts a job system's worker threads
+ * @param jobs			Job system to start
+ * @param thread_count	Threads to run batches on, including the calling thread. Capped at JOB_MAX_THREADS
+ */
+void job_system_init(job_system_t* jobs, int thread_count) {
+	*jobs = (job_system_t) { .thread_count = 1 };
+	mtx_init(&jobs->lock, mtx_plain);
+	cnd_init(&jobs->wake);
+	cnd_init(&jobs->done);
+	atomic_init(&jobs->pending, 0);
+	for (int i = 0; i < JOB_MAX_THREADS; ++i) {
+		mtx_init(&jobs->queues[i].lock, mtx_plain);
+	}
+	thread_count = CLAMP(thread_count, 1, JOB_MAX_THREADS);
+	for (int i = 1; i < thread_count; ++i) {
+		job_worker_arg_t* arg = malloc(sizeof(job_worker_arg_t));
+		*arg = (job_worker_arg_t) { jobs, i };
+		if (thrd_create(&jobs->threads[i], job_worker, arg) != thrd_success) {
+			printd("Could only start [%d] of [%d] job threads\n", i, thread_count);
+			free(arg);
+			break;
+		}
+		jobs->thread_count = i + 1;
+	}
+}
+
+void job_system_free(job_system_t* jobs) {
+	mtx_lock(&jobs->lock);
+	jobs->quit = true;
+	cnd_broadcast(&jobs->wake);
+	mtx_unlock(&jobs->lock);
+	for (int i = 1; i < jobs->thread_count; ++i) {
+		thrd_join(jobs->threads[i], NULL);
+	}
+	for (int i = 0; i < JOB_MAX_THREADS; ++i) {
+		mtx_destroy(&jobs->queues[i].lock);
+	}
+	cnd_destroy(&jobs->wake);
+	cnd_destroy(&jobs->done);
+	mtx_destroy(&jobs->lock);
+}
+
+/**
+ * Runs a job over [0, count) in batches across a job system's threads, returning once all batches are done
+ * @param jobs			Job system to run on
+ * @param run			Called with the range of each batch
+ * @param context		Passed through to run
+ * @param count			Size of the range
+ * @param batch_size	Preferred batch size. Raised if needed to fit the queues
+ */
+void job_system_run(job_system_t* jobs, job_batch_t run, void* context, int count, int batch_size) {
+	int n = jobs->thread_count;
+	batch_size = MAX(batch_size, (count + JOB_QUEUE_SIZE * n - 1) / (JOB_QUEUE_SIZE * n));
+	int batch_count = (count + batch_size - 1) / batch_size;
+	if (n == 1 || batch_count <= 1) {
+		if (count > 0) {
+			run(context, 0, count);
+		}
+		return;
+	}
+
+	// deal out contiguous runs of batches, one run per thread
+	atomic_store(&jobs->pending, batch_count);
+	for (int t = 0; t < n; ++t) {
+		job_queue_t* queue = &jobs->queues[t];
+		mtx_lock(&queue->lock);
+		queue->head = queue->tail = 0;
+		for (int b = batch_count * t / n; b < batch_count * (t + 1) / n; ++b) {
+			queue->jobs[queue->tail++ & (JOB_QUEUE_SIZE - 1)] = (job_t) {
+				run, context, b * batch_size, MIN((b + 1) * batch_size, count)
+			};
+		}
+		mtx_unlock(&queue->lock);
+	}
+	mtx_lock(&jobs->lock);
+	++jobs->round;
+	cnd_broadcast(&jobs->wake);
+	mtx_unlock(&jobs->lock);
+
+	job_work(jobs, 0);
+	mtx_lock(&jobs->lock);
+	while (atomic_load(&jobs->pending) > 0) {
+		cnd_wait(&jobs->done, &jobs->lock);
+	}
+	mtx_unlock(&jobs->lock);
+}
+
 #pragma endregion
 
 #pragma region Rectangle bounds
@@ -165,6 +708,21 @@ bool rectangle_collision(Rectangle r1, Rectangle r2) {
 			(r1.y < (r2.y + r2.height) && (r1.y + r1.height) > r2.y));
 }
 
+/**
+ * Gets the smallest rectangle covering two others, ignoring either if it's empty
+ */
+Rectangle rectangle_union(Rectangle r1, Rectangle r2) {
+	if (r1.width <= 0 || r1.height <= 0) {
+		return r2;
+	}
+	if (r2.width <= 0 || r2.height <= 0) {
+		return r1;
+	}
+	float x1 = MIN(r1.x, r2.x), y1 = MIN(r1.y, r2.y);
+	float x2 = MAX(r1.x + r1.width, r2.x + r2.width), y2 = MAX(r1.y + r1.height, r2.y + r2.height);
+	return (Rectangle) { x1, y1, x2 - x1, y2 - y1 };
+}
+
 bool rectangle_collision_list(Rectangle base_rect, Rectangle* recs, int num_rects) {
 	for (int i = 0; i < num_rects; ++i) {
 		if (rectangle_collision(base_rect, recs[i])) {
@@ -630,1218 +1188,7261 @@ typedef struct tile {
 	collision_type_t collision;
 } tile_t;
 
+// tiles as stored in a tilemap: one byte each, collision in the low bits (TILE_COLLISION_MASK)
+typedef uint8_t packed_tile_t;
+
+struct tilemap_stream;
+
+/*
+ * Tiles are stored in a single allocation of TILEMAP_CHUNK_SIZE x TILEMAP_CHUNK_SIZE chunks. Chunks
+ * are laid out row-major, as are the tiles within each chunk, so a body's collision window or a
+ * screen's worth of tiles only touches a handful of cache lines.
+ *
+ * Alongside the tiles, collision is mirrored into bitplanes (one bit per tile) so that collision
+ * resolution can test a whole span of tiles with a few word operations. Solid & platform tiles are
+ * kept row-major, and solid tiles are also kept column-major for vertical spans.
+ *
+ * A streamed tilemap (see Tilemap Streaming) only keeps a ring of TILEMAP_STREAM_SEGMENTS segments
+ * of columns in memory. Column indices are wrapped into the ring with the masks below, which are
+ * all bits set for a tilemap that is fully resident. Tiles outside of the resident columns read as air.
+ */
 typedef struct tilemap {
-	tile_t** data;
+	packed_tile_t* data;
 	int width;
 	int height;
+	int chunks_x, chunks_y;
 	int tile_size;
+	uint64_t hash;	// xor of every non-air tile's hash, kept up to date by tilemap_set
+
+	int row_words, column_words;	// 64-bit words per bitplane row / column
+	uint64_t* solid_rows;
+	uint64_t* platform_rows;
+	uint64_t* solid_columns;
+
+	int resident_x, resident_width;	// columns that can be read & written
+	int chunk_stride;				// chunks per stored chunk row
+	int chunk_column_mask;			// wraps a chunk column into storage
+	int word_mask;					// wraps a bitplane row word into storage
+	int column_mask;				// wraps a column into the column-major bitplane
+	int stored_columns;				// columns held by the column-major bitplane
+	struct tilemap_stream* stream;	// NULL unless streamed
+	uint32_t* chunk_revisions;		// bumped whenever a stored chunk's tiles change, for render caches
+	uint8_t* chunk_occupancy;		// see tilemap_update_occupancy, allocated on first use
+	uint32_t* chunk_occupancy_revisions;
+
+	bool owns_data;	// false when the tiles & bitplanes live in a level file mapping
 } tilemap_t;
 
-void tilemap_init(tilemap_t* map, int width, int height, int tile_size) {
+/**
+ * Sets up a tilemap's dimensions, without allocating any tile data
+ */
+void tilemap_init_layout(tilemap_t* map, int width, int height, int tile_size) {
 	*map = (tilemap_t) {
 		.width = width,
 		.height = height,
+		.chunks_x = (width + TILEMAP_CHUNK_MASK) >> TILEMAP_CHUNK_SHIFT,
+		.chunks_y = (height + TILEMAP_CHUNK_MASK) >> TILEMAP_CHUNK_SHIFT,
 		.tile_size = tile_size,
-		.data = malloc(width * sizeof(tilemap_t*))
+		.row_words = (width + 63) >> 6,
+		.column_words = (height + 63) >> 6,
+		.resident_width = width,
+		.chunk_stride = (width + TILEMAP_CHUNK_MASK) >> TILEMAP_CHUNK_SHIFT,
+		.chunk_column_mask = -1,
+		.word_mask = -1,
+		.column_mask = -1,
+		.stored_columns = width
 	};
-	for (int x = 0; x < width; ++x) {
-		map->data[x] = calloc(height, sizeof(tilemap_t));
-	}
 }
 
-void tilemap_free(tilemap_t* map) {
-	for (int x = 0; x < map->width; ++x) {
-		free(map->data[x]);
-	}
-	free(map->data);
+/**
+ * Gets the total memory used by a tilemap's stored tiles
+ * @param map Tilemap to measure
+ * @return Size of tile data in bytes
+ */
+size_t tilemap_tiles_size(const tilemap_t* map) {
+	return (size_t)map->chunk_stride * map->chunks_y * TILEMAP_CHUNK_SIZE * TILEMAP_CHUNK_SIZE * sizeof(packed_tile_t);
 }
 
-tile_t tilemap_get(const tilemap_t* map, int x, int y) {
-	if (x < 0 || y < 0 || x >= map->width || y >= map->height) {
-		return (tile_t) { .collision = COLLISION_AIR };
-	}
-	return map->data[x][y];
+size_t tilemap_row_plane_size(const tilemap_t* map) {
+	return (size_t)map->row_words * map->height * sizeof(uint64_t);
 }
 
-Rectangle tilemap_get_rectangle(const tilemap_t* map, int x, int y) {
-	if (x < 0 || y < 0 || x >= map->width || y >= map->height) return (Rectangle) { 0, 0, 0, 0 };
-	return (Rectangle) { x * (float)map->tile_size, y * (float)map->tile_size, (float)map->tile_size, (float)map->tile_size };
+size_t tilemap_column_plane_size(const tilemap_t* map) {
+	return (size_t)map->column_words * map->stored_columns * sizeof(uint64_t);
 }
 
-void tilemap_set(tilemap_t* map, int x, int y, tile_t val) {
-	if (x < 0 || y < 0 || x >= map->width || y >= map->height) {
-		return;
-	}
-	map->data[x][y] = val;
+size_t tilemap_data_size(const tilemap_t* map) {
+	return tilemap_tiles_size(map) + tilemap_row_plane_size(map) * 2 + tilemap_column_plane_size(map);
 }
 
-#pragma endregion
-
-#pragma region Control States
-
-typedef struct controller_buttons {
-	int h, v;
-	bool a, b, x, y;
-	bool l, r;
-} controller_buttons_t;
-
-struct controller_state {
-	controller_buttons_t current;
-	controller_buttons_t previous;
-};
-
-void controller_state_update(controller_state_t* state) {
-	memcpy(&state->previous, &state->current, sizeof(controller_state_t));
-	state->current = (controller_buttons_t) {
-		.a = IsKeyDown(KEY_X),
-		.b = IsKeyDown(KEY_Z),
-		.x = IsKeyDown(KEY_C),
-		.y = IsKeyDown(KEY_V),
-		.h = IsKeyDown(KEY_RIGHT) - IsKeyDown(KEY_LEFT),
-		.v = IsKeyDown(KEY_DOWN) - IsKeyDown(KEY_UP)
-	};
+size_t tilemap_stored_chunk_count(const tilemap_t* map) {
+	return (size_t)map->chunk_stride * map->chunks_y;
 }
 
-#pragma endregion
-
-#pragma region Render Context
-
-struct render_context {
-	Texture sprite_atlas;
-	RenderTexture render_texture;
-};
-
-#pragma endregion
-
-#pragma region Backgrounds
-
-typedef struct background {
-	float x, y;
-	float parallax_x;
-	float parallax_y;
-	Texture tex;
-	bool clamp_x;
-	bool clamp_y;
-} background_t;
-
 /**
- * Initializes a background
- * @param res_loc		Local background resource name, ommitting path and file type (i.e. "glade" for "glade.png" inside of the backgrounds folder)
- * @param background	Background to initialize
- * @param tiled			Wrap texture at the ends
+ * Allocates (zeroed) storage for a tilemap whose layout has been set up
  */
-void background_init(const char* res_loc, background_t* background, bool tiled) {
-	*background = (background_t) { 0 };
+void tilemap_alloc(tilemap_t* map) {
+	map->owns_data = true;
+	map->data = calloc(tilemap_tiles_size(map), 1);
+	map->solid_rows = calloc(tilemap_row_plane_size(map), 1);
+	map->platform_rows = calloc(tilemap_row_plane_size(map), 1);
+	map->solid_columns = calloc(tilemap_column_plane_size(map), 1);
+	map->chunk_revisions = calloc(tilemap_stored_chunk_count(map), sizeof(uint32_t));
+}
 
-	// index path
-	char indexed_loc[MAX_PATH_LEN] = "";
-	path_index(res_loc, indexed_loc);
+void tilemap_init(tilemap_t* map, int width, int height, int tile_size) {
+	tilemap_init_layout(map, width, height, tile_size);
+	tilemap_alloc(map);
+}
 
-	// get full bg path
-	char img_path[MAX_PATH_LEN] = "";
-	snprintf(img_path, sizeof img_path, BACKGROUNDS_PATH "/%s.png", indexed_loc);
+void tilemap_stream_close(tilemap_t* map);
 
-	// open file for reading
-	FILE* f = fopen(img_path, "r");
-	if (f == NULL) {
-		printd("Background [%s] not found\n", res_loc);
-		return;
+void tilemap_free(tilemap_t* map) {
+	if (map->stream != NULL) {
+		tilemap_stream_close(map);
 	}
-
-	printd("Loading background res [%s]\n", img_path);
-	background->tex = LoadTexture(img_path);
-	
-	if (tiled) {
-		SetTextureWrap(background->tex, TEXTURE_WRAP_REPEAT);
+	free(map->chunk_revisions);
+	free(map->chunk_occupancy);
+	free(map->chunk_occupancy_revisions);
+	if (!map->owns_data) {
+		return;
 	}
-
-	fclose(f);
+	free(map->data);
+	free(map->solid_rows);
+	free(map->platform_rows);
+	free(map->solid_columns);
 }
 
 /**
- * Draw background to screen using position / offset / parallax data in background
- * @param background Pointer to background to draw
+ * Checks that a tile is within the map and resident
  */
-void background_draw(background_t* background) {
-	int bg_x = (int)(background->x * background->parallax_x) % background->tex.width;
-
-	Rectangle bg_rect = (Rectangle) { .width = background->tex.width, .height = background->tex.height };
-	Rectangle screen_rect = (Rectangle) { bg_x, background->y * background->parallax_y, bg_rect.width, bg_rect.height };
-	DrawTexturePro(background->tex, bg_rect, screen_rect, (Vector2) { 0, 0 }, 0, WHITE);
+static inline bool tilemap_in_bounds(const tilemap_t* map, int x, int y) {
+	return (unsigned)(x - map->resident_x) < (unsigned)map->resident_width && (unsigned)y < (unsigned)map->height;
 }
 
 /**
- * Free data inside of a background
- * @param background Pointer to background to free data from
+ * Gets the index of a chunk within tilemap storage. Does not bounds check
  */
-void background_free(background_t* background) {
-	UnloadTexture(background->tex);
+static inline size_t tilemap_chunk_index(const tilemap_t* map, int chunk_x, int chunk_y) {
+	return (size_t)chunk_y * map->chunk_stride + (chunk_x & map->chunk_column_mask);
 }
 
-#pragma endregion
-
-#pragma region Sprites
-
-struct sprite_frame {
-	int x, y;
-};
-
-typedef struct sprite {
-	int width, height;
-	int frame_count;
-	sprite_frame_t* frames;
-	int order_count;
-	int* order;
-} sprite_t;
+/**
+ * Gets the offset of a tile within tilemap data. Does not bounds check
+ */
+static inline size_t tilemap_offset(const tilemap_t* map, int x, int y) {
+	size_t chunk = tilemap_chunk_index(map, x >> TILEMAP_CHUNK_SHIFT, y >> TILEMAP_CHUNK_SHIFT);
+	return (chunk << (TILEMAP_CHUNK_SHIFT * 2)) | ((y & TILEMAP_CHUNK_MASK) << TILEMAP_CHUNK_SHIFT) | (x & TILEMAP_CHUNK_MASK);
+}
 
 /**
- * Frees the data inside of a sprite
- * @param sprite Pointer to sprite to free data from
+ * Gets a span of up to 64 tiles of a row as bits (set where the tile's collision is in the bitplane)
+ * @param map	Tilemap to query
+ * @param plane	Row-major bitplane of the tilemap (solid_rows or platform_rows)
+ * @param y		Row
+ * @param x		First column of the span
+ * @param count	Number of columns in the span [1, 64]
+ * @return Bit i is set for tile (x + i, y)
  */
-void sprite_free(sprite_t* sprite) {
-	if (sprite->frames) {
-		free(sprite->frames);
-	}
-	if (sprite->order) {
-		free(sprite->order);
+static inline uint64_t tilemap_row_span(const tilemap_t* map, const uint64_t* plane, int y, int x, int count) {
+	if ((unsigned)y >= (unsigned)map->height) {
+		return 0;
 	}
+	return bit_span(plane + (size_t)y * map->row_words, map->resident_x, map->resident_x + map->resident_width, x, count, map->word_mask);
 }
 
-const sprite_frame_t sprite_get_frame(const sprite_t* sprite, int image_index) {
-	return (sprite->order == NULL) ?
-		sprite->frames[image_index % sprite->frame_count] :					// no custom order; get frame from image index
-		sprite->frames[sprite->order[image_index % sprite->order_count]];	// custom order; get frame from order index
+/**
+ * Gets a span of up to 64 solid tiles of a column as bits
+ * @param map	Tilemap to query
+ * @param x		Column
+ * @param y		First row of the span
+ * @param count	Number of rows in the span [1, 64]
+ * @return Bit i is set if tile (x, y + i) is solid
+ */
+static inline uint64_t tilemap_solid_column_span(const tilemap_t* map, int x, int y, int count) {
+	if ((unsigned)(x - map->resident_x) >= (unsigned)map->resident_width) {
+		return 0;
+	}
+	return bit_span(map->solid_columns + (size_t)(x & map->column_mask) * map->column_words, 0, map->height, y, count, -1);
 }
 
-void sprite_draw_ex(sprite_t* sprite, int image_index, float x, float y, int origin_x, int origin_y, bool flip_x, bool flip_y, render_context_t* context) {
-	// frame to utilize from sprite frames
-	sprite_frame_t frame = sprite_get_frame(sprite, image_index);
-	Rectangle sprite_rect = (Rectangle) { floorf(frame.x), floorf(frame.y), sprite->width, sprite->height };
-	if (flip_x) {
-		sprite_rect.width = -sprite_rect.width;
+tile_t tilemap_get(const tilemap_t* map, int x, int y) {
+	if (!tilemap_in_bounds(map, x, y)) {
+		return (tile_t) { .collision = COLLISION_AIR };
 	}
-	Rectangle screen_rect = (Rectangle) { floorf(x), floorf(y), sprite_rect.width, sprite_rect.height };
-	DrawTexturePro(context->sprite_atlas, sprite_rect, screen_rect, (Vector2) { origin_x, origin_y }, 0, WHITE);
+	return (tile_t) { .collision = map->data[tilemap_offset(map, x, y)] & TILE_COLLISION_MASK };
 }
 
-void sprite_draw(sprite_t* sprite, int image_index, float x, float y, bool flip_x, bool flip_y, render_context_t* context) {
-	sprite_draw_ex(sprite, image_index, x, y, 0.0f, 0.0f, flip_x, flip_y, context);
+Rectangle tilemap_get_rectangle(const tilemap_t* map, int x, int y) {
+	if (x < 0 || y < 0 || x >= map->width || y >= map->height) return (Rectangle) { 0, 0, 0, 0 };
+	return (Rectangle) { x * (float)map->tile_size, y * (float)map->tile_size, (float)map->tile_size, (float)map->tile_size };
 }
 
-void sprite_init(const char* res_loc, sprite_t* sprite, Image* atlas_img, stbrp_context* rect_packer) {
-	// replace all instances of "." with "/" for local resources
-	char indexed_fname[MAX_PATH_LEN] = "";
-	path_index(res_loc, indexed_fname);
+// where a ray first hit a solid tile
+typedef struct tilemap_hit {
+	int x, y;					// tile hit
+	float t;					// how far along the ray the hit is [0, 1]
+	Vector2 point;				// where the ray entered the tile
+	int normal_x, normal_y;		// side of the tile that was entered, 0, 0 if the ray started inside of it
+} tilemap_hit_t;
 
-	*sprite = (sprite_t) { 0 };
-    
-    char image_path[MAX_PATH_LEN] = "", data_path[MAX_PATH_LEN] = "";
-	snprintf(image_path, sizeof image_path, SPRITES_PATH "/%s.png", indexed_fname);
-	snprintf(data_path, sizeof data_path, SPRITES_PATH "/%s.dat", indexed_fname);
+/**
+ * Casts a ray through a tilemap, stepping tile by tile through the ones it crosses (a DDA), so the
+ * cost grows with its length in tiles. Only solid tiles block it; platforms & unloaded tiles don't
+ * @param map	Tilemap to cast through
+ * @param from	Start of the ray, in world space
+ * @param to	End of the ray, in world space
+ * @param hit	Filled in with the first solid tile the ray crosses, if any. May be NULL
+ * @return Whether the ray hit a solid tile before reaching its end. So a line of sight between from & to is clear if false
+ */
+bool tilemap_raycast(const tilemap_t* map, Vector2 from, Vector2 to, tilemap_hit_t* hit) {
+	float tile_size = map->tile_size;
+	float dx = to.x - from.x, dy = to.y - from.y;
+	int x = floor_to_int(from.x / tile_size), y = floor_to_int(from.y / tile_size);
+	int steps = abs(floor_to_int(to.x / tile_size) - x) + abs(floor_to_int(to.y / tile_size) - y);
+	int step_x = (dx > 0.0f) ? 1 : -1, step_y = (dy > 0.0f) ? 1 : -1;
+
+	// how far along the ray the next column & row boundaries are, and how far apart they are
+	float next_x = (dx == 0.0f) ? INFINITY : ((x + (dx > 0.0f)) * tile_size - from.x) / dx;
+	float next_y = (dy == 0.0f) ? INFINITY : ((y + (dy > 0.0f)) * tile_size - from.y) / dy;
+	float delta_x = (dx == 0.0f) ? INFINITY : tile_size / fabsf(dx);
+	float delta_y = (dy == 0.0f) ? INFINITY : tile_size / fabsf(dy);
+
+	float t = 0.0f;
+	int normal_x = 0, normal_y = 0;
+	for (int i = 0; ; ++i) {
+		if (tilemap_row_span(map, map->solid_rows, y, x, 1)) {
+			if (hit != NULL) {
+				*hit = (tilemap_hit_t) {
+					.x = x, .y = y, .t = t,
+					.point = { from.x + dx * t, from.y + dy * t },
+					.normal_x = normal_x, .normal_y = normal_y
+				};
+			}
+			return true;
+		}
+		if (i == steps) {
+			return false;
+		}
+		if (next_x < next_y) {
+			x += step_x;
+			t = next_x;
+			next_x += delta_x;
+			normal_x = -step_x;
+			normal_y = 0;
+		}
+		else {
+			y += step_y;
+			t = next_y;
+			next_y += delta_y;
+			normal_x = 0;
+			normal_y = -step_y;
+		}
+	}
+}
 
-	FILE* file;
-	if ((file = fopen(image_path, "r")) == NULL) {
-		return;
+/**
+ * Gets the contribution of a single tile to the tilemap hash. Air contributes nothing, so that an empty map hashes to 0
+ */
+uint64_t tilemap_tile_hash(const tilemap_t* map, int x, int y, tile_t tile) {
+	if (tile.collision == COLLISION_AIR) {
+		return 0;
 	}
-	fclose(file);
+	return hash_combine(((uint64_t)y * map->width + x) << 2, tile.collision);
+}
 
-    Image img = LoadImage(image_path);
-	if (img.data == NULL) {
-		return;
+/**
+ * Rebuilds the bitplane bits of a tile from its stored collision. Does not bounds check
+ */
+static inline void tilemap_update_bits(tilemap_t* map, int x, int y, collision_type_t collision) {
+	uint64_t* solid_row = &map->solid_rows[(size_t)y * map->row_words + ((x >> 6) & map->word_mask)];
+	uint64_t* platform_row = &map->platform_rows[(size_t)y * map->row_words + ((x >> 6) & map->word_mask)];
+	uint64_t* solid_column = &map->solid_columns[(size_t)(x & map->column_mask) * map->column_words + (y >> 6)];
+	uint64_t row_bit = 1ull << (x & 63), column_bit = 1ull << (y & 63);
+	*solid_row &= ~row_bit;
+	*platform_row &= ~row_bit;
+	*solid_column &= ~column_bit;
+	if (collision == COLLISION_SOLID) {
+		*solid_row |= row_bit;
+		*solid_column |= column_bit;
 	}
-    int sprite_width = img.width, sprite_height = img.height;
+	else if (collision == COLLISION_PLATFORM) {
+		*platform_row |= row_bit;
+	}
+}
 
-    // load .dat file and initialize the animation frames and order
-	if ((file = fopen(data_path, "r")) == NULL) {
-		sprite->frame_count = ceilf(sprite_height / (float)sprite_width);
-		sprite->frames = malloc(sprite->frame_count * sizeof(sprite_frame_t));
-		int frame_height = sprite_width > sprite_height ? sprite_height : sprite_width;
-		sprite->width = sprite_width;
-		sprite->height = frame_height;
-		for (int i = 0; i < sprite->frame_count; ++i) {
-			stbrp_rect r = { 0, sprite_width, frame_height };
-			if (stbrp_pack_rects(rect_packer, &r, 1)) {
-				ImageDraw(atlas_img, img, (Rectangle) { 0, (i * frame_height), sprite_width, frame_height }, (Rectangle) { r.x, r.y, sprite_width, frame_height }, WHITE);
-				sprite->frames[i].x = r.x;
-				sprite->frames[i].y = r.y;
-			}
-		}
-		UnloadImage(img);
-		printd("Loaded sprite [%s] with [%d] frames\n", res_loc, sprite->frame_count);
+void tilemap_set(tilemap_t* map, int x, int y, tile_t val) {
+	if (!tilemap_in_bounds(map, x, y)) {
 		return;
 	}
-    
-    char order_buf[256] = "";
-    char line[256] = "";
+	packed_tile_t* tile = &map->data[tilemap_offset(map, x, y)];
+	map->hash ^= tilemap_tile_hash(map, x, y, (tile_t) { .collision = *tile & TILE_COLLISION_MASK }) ^ tilemap_tile_hash(map, x, y, val);
+	*tile = (*tile & ~TILE_COLLISION_MASK) | (val.collision & TILE_COLLISION_MASK);
+	tilemap_update_bits(map, x, y, val.collision);
+	++map->chunk_revisions[tilemap_chunk_index(map, x >> TILEMAP_CHUNK_SHIFT, y >> TILEMAP_CHUNK_SHIFT)];
+}
 
-    while (fgets(line, sizeof line, file)) {
-        if (sprite->frame_count == 0 && strncmp(line, "frames:", 7) == 0) {
-            if (sscanf(line, "frames: %d", &sprite->frame_count) != 1) {
-                goto close_file;
-            }
-			else {
-                sprite->frames = malloc(sprite->frame_count * sizeof(sprite_frame_t));
-                sprite_height = img.height / sprite->frame_count;
-                printd("Frame dimensions: [%d, %d]\n", sprite_width, sprite_height);
-
-				sprite->width = sprite_width;
-				sprite->height = sprite_height;
-				for (int i = 0; i < sprite->frame_count; ++i) {
-					stbrp_rect r = (stbrp_rect) { .w = sprite_width, .h = sprite_height };
-					if (stbrp_pack_rects(rect_packer, &r, 1)) {
-						ImageDraw(atlas_img, img, (Rectangle) { 0, (int)(i * sprite_height), sprite_width, sprite_height }, (Rectangle) { r.x, r.y, sprite_width, sprite_height }, WHITE);
-						sprite->frames[i].x = r.x;
-						sprite->frames[i].y = r.y;
-					}
-				}
-            }
-        }
-        if (sprite->order == NULL && strncmp(line, "order:", 6) == 0) {
-            if (sscanf(line, "order: %s", order_buf) != 1) {
-                goto close_file;
-            }
-			else {
-                size_t order_len = strlen(order_buf);
+/**
+ * Gets the revision of a chunk, which changes whenever what tilemap_get returns for any of its tiles does
+ */
+uint32_t tilemap_chunk_revision(const tilemap_t* map, int chunk_x, int chunk_y) {
+	return map->chunk_revisions[tilemap_chunk_index(map, chunk_x, chunk_y)];
+}
 
-                // fetch count of frames to allocate for order
-                for (int i = 0; i < order_len;) {
-                    int temp;
-                    if (sscanf(order_buf + i, "%d", &temp) == 1) {
-                        while (order_buf[i] != ',' && i < order_len) {
-                            i++;
-                        }
-                        while (order_buf[i] == ',' && i < order_len) {
-                            i++;
-                        }
-                        sprite->order_count++;
-                    }
-					else i++;
-                }
+/**
+ * Bumps the revision of every chunk overlapping a range of columns
+ */
+void tilemap_touch_columns(tilemap_t* map, int x1, int x2) {
+	for (int cx = x1 >> TILEMAP_CHUNK_SHIFT; cx <= (x2 - 1) >> TILEMAP_CHUNK_SHIFT && x1 < x2; ++cx) {
+		for (int cy = 0; cy < map->chunks_y; ++cy) {
+			++map->chunk_revisions[tilemap_chunk_index(map, cx, cy)];
+		}
+	}
+}
 
-                sprite->order = malloc(sprite->order_count * sizeof(int));
+/**
+ * Works out whether a stored chunk holds any solid or platform tiles, for tilemap_chunk_occupied
+ */
+void tilemap_chunk_occupancy_update(tilemap_t* map, int chunk_x, int chunk_y, size_t chunk) {
+	int x = chunk_x << TILEMAP_CHUNK_SHIFT, y = chunk_y << TILEMAP_CHUNK_SHIFT;
+	uint64_t bits = 0;
+	for (int row = y; row < MIN(y + TILEMAP_CHUNK_SIZE, map->height); ++row) {
+		bits |= tilemap_row_span(map, map->solid_rows, row, x, TILEMAP_CHUNK_SIZE);
+		bits |= tilemap_row_span(map, map->platform_rows, row, x, TILEMAP_CHUNK_SIZE);
+	}
+	map->chunk_occupancy[chunk] = 1 + (bits != 0);
+	map->chunk_occupancy_revisions[chunk] = map->chunk_revisions[chunk];
+}
 
-                // put animation frame order into the animation order array
-                for (int i = 0, num_count = 0; i < order_len;) {
-                    int temp;
-                    if (sscanf(order_buf + i, "%d", &temp) == 1) {
-                        while (order_buf[i] != ',' && i < order_len) {
-                            i++;
-                        }
-                        while (order_buf[i] == ',' && i < order_len) {
-                            i++;
-                        }
-                        sprite->order[num_count++] = temp;
-                    }
-					else i++;
-                }
-            }
-        }
-    }
+/**
+ * Brings the cached occupancy (see tilemap_chunk_occupied) of every chunk in a range of columns up to date
+ * @param map	Tilemap to update
+ * @param x1	First column
+ * @param x2	Column after the last
+ */
+void tilemap_update_occupancy(tilemap_t* map, int x1, int x2) {
+	x1 = MAX(x1, map->resident_x);
+	x2 = MIN(x2, map->resident_x + map->resident_width);
+	if (x1 >= x2) {
+		return;
+	}
+	if (map->chunk_occupancy == NULL) {
+		map->chunk_occupancy = calloc(tilemap_stored_chunk_count(map), sizeof(uint8_t));
+		map->chunk_occupancy_revisions = calloc(tilemap_stored_chunk_count(map), sizeof(uint32_t));
+	}
 
-close_file:
-#ifdef DEV
-	if (sprite->order) {
-		printd("Loaded sprite [%s] with [%d] frames and pre-defined order of [", res_loc, sprite->frame_count);
-		for (int i = 0; i < sprite->order_count; ++i) {
-			printd("%d", sprite->order[i]);
-			if (i < sprite->order_count - 1) {
-				printd(", ");
+	// 0 is unknown, otherwise 1 + whether the chunk is occupied
+	for (int cx = x1 >> TILEMAP_CHUNK_SHIFT; cx <= (x2 - 1) >> TILEMAP_CHUNK_SHIFT; ++cx) {
+		for (int cy = 0; cy < map->chunks_y; ++cy) {
+			size_t chunk = tilemap_chunk_index(map, cx, cy);
+			if (map->chunk_occupancy[chunk] == 0 || map->chunk_occupancy_revisions[chunk] != map->chunk_revisions[chunk]) {
+				tilemap_chunk_occupancy_update(map, cx, cy, chunk);
 			}
 		}
-		printd("]\n");
-	}
-	else {
-		printd("Loaded sprite [%s] with [%d] frames\n", res_loc, sprite->frame_count);
 	}
-#endif
-    fclose(file);
 }
 
-ARRAYLIST_DEFINE(sprite_t*, spriteptr)
+/**
+ * Checks whether a chunk may hold any solid or platform tiles, from the occupancy cached by
+ * tilemap_update_occupancy. Doesn't write anything, so it's safe to call from several threads
+ * @param map		Tilemap to check
+ * @param chunk_x	Chunk column
+ * @param chunk_y	Chunk row
+ * @return False if the chunk is known to be all air, or is outside of the map or resident columns
+ */
+static inline bool tilemap_chunk_occupied(const tilemap_t* map, int chunk_x, int chunk_y) {
+	if ((unsigned)chunk_y >= (unsigned)map->chunks_y || (unsigned)(chunk_x * TILEMAP_CHUNK_SIZE - map->resident_x) >= (unsigned)map->resident_width) {
+		return false;
+	}
+	if (map->chunk_occupancy == NULL) {
+		return true;
+	}
+	size_t chunk = tilemap_chunk_index(map, chunk_x, chunk_y);
+	return map->chunk_occupancy[chunk] != 1 || map->chunk_occupancy_revisions[chunk] != map->chunk_revisions[chunk];
+}
 
 #pragma endregion
 
-#pragma region Sounds // TODO: should be passed by context
+#pragma region Tilemap Streaming
+
+/*
+ * Streams a long level's tiles from its level file, so that memory use doesn't grow with level
+ * length. Columns are grouped into segments of TILEMAP_SEGMENT_WIDTH (one bitplane word wide), and
+ * a ring of TILEMAP_STREAM_SEGMENTS segments around the camera is kept in memory. A worker thread
+ * copies segments out of the memory mapped level file into free ring slots ahead of the player, in
+ * the direction they are moving, so only the pages it touches are ever read in.
+ *
+ * What the simulation can see only depends on the camera: the TILEMAP_STREAM_VISIBLE segments either
+ * side of it are always resident (waiting on the worker if it has fallen behind) and everything else
+ * reads as air, so replays stay deterministic. Tiles changed with tilemap_set revert once their
+ * segment has been evicted and streamed back in.
+ */
 
-struct sounds {
-	Sound bump;
-	Sound jump;
-} sounds;
+typedef struct tilemap_stream {
+	thrd_t worker;
+	mtx_t lock;
+	cnd_t changed;		// signaled when segments are requested, loaded, or the worker should quit
+	const packed_tile_t* tiles;	// packed tiles in the mapped level file, only read from the worker
+	int file_chunks_x;
+	int segment_count;
+
+	// protected by lock
+	int wanted[TILEMAP_STREAM_SEGMENTS];	// segment each ring slot should hold (-1 for none)
+	int loaded[TILEMAP_STREAM_SEGMENTS];	// segment each ring slot does hold (-1 while loading)
+	int center;								// segment the camera is in; nearest requests load first
+	bool quit;
+
+	// main thread only
+	int window;			// first segment of the ring window
+	long waits;			// ticks where the simulation had to wait on the worker
+	long loads;			// segments requested
+} tilemap_stream_t;
 
-#pragma endregion
+/**
+ * Reads a segment from the level file into its ring slot, and rebuilds the slot's bitplanes.
+ * Only ever touches memory of that slot, which isn't visible to the simulation while loading
+ */
+void tilemap_stream_load_segment(tilemap_t* map, int segment) {
+	tilemap_stream_t* stream = map->stream;
+	const int chunks_per_segment = TILEMAP_SEGMENT_WIDTH >> TILEMAP_CHUNK_SHIFT;
+	const size_t chunk_bytes = TILEMAP_CHUNK_SIZE * TILEMAP_CHUNK_SIZE * sizeof(packed_tile_t);
+	int first_chunk = segment * chunks_per_segment;
+	int chunk_count = MIN(chunks_per_segment, stream->file_chunks_x - first_chunk);
+
+	// a segment is one contiguous run of chunks per chunk row in the file
+	for (int cy = 0; cy < map->chunks_y; ++cy) {
+		packed_tile_t* dest = map->data + (((size_t)cy * map->chunk_stride + (first_chunk & map->chunk_column_mask)) * chunk_bytes);
+		const packed_tile_t* src = stream->tiles + (((size_t)cy * stream->file_chunks_x + first_chunk) * chunk_bytes);
+		memcpy(dest, src, chunk_bytes * chunk_count);
+	}
 
-#pragma region Text
+	int x1 = segment * TILEMAP_SEGMENT_WIDTH, x2 = MIN(x1 + TILEMAP_SEGMENT_WIDTH, map->width);
+	for (int y = 0; y < map->height; ++y) {
+		for (int x = x1; x < x2; ++x) {
+			tilemap_update_bits(map, x, y, map->data[tilemap_offset(map, x, y)] & TILE_COLLISION_MASK);
+		}
+	}
+}
 
-typedef struct font {
-	sprite_t sprite_data;
-	char order[256];
-	int spacing;
-} font_t;
+int tilemap_stream_worker(void* arg) {
+	tilemap_t* map = arg;
+	tilemap_stream_t* stream = map->stream;
+	mtx_lock(&stream->lock);
+	while (!stream->quit) {
+		// nearest outstanding request to the camera first
+		int slot = -1;
+		for (int i = 0; i < TILEMAP_STREAM_SEGMENTS; ++i) {
+			if (stream->wanted[i] != stream->loaded[i] && stream->wanted[i] >= 0 &&
+				(slot < 0 || abs(stream->wanted[i] - stream->center) < abs(stream->wanted[slot] - stream->center))) {
+				slot = i;
+			}
+		}
+		if (slot < 0) {
+			cnd_wait(&stream->changed, &stream->lock);
+			continue;
+		}
+		int segment = stream->wanted[slot];
+		stream->loaded[slot] = -1;
+		mtx_unlock(&stream->lock);
 
-font_t fnt_hud;
+		tilemap_stream_load_segment(map, segment);
 
-/**
- * Initializes a font
- * @param res_loc		Resource location
- * @param order			Order of the font (e.g. 'ABCDEFGHIJKLMNOPQRSTUVWXYZ')
- * @param font			Pointer to the font to initialize
- * @param atlas			Pointer to the atlas to add font sprites to
- * @param rect_packer	Pointer to current atlas packer
- */
-void font_init(const char* res_loc, const char* order, font_t* font, Image* atlas, stbrp_context* rect_packer) {
-	*font = (font_t) { 0 };
-	sprite_init(res_loc, &font->sprite_data, atlas, rect_packer);
-	int order_len = strlen(order);
-	memcpy((void*)font->order, order, (size_t)order_len + 1);
-#ifdef DEV
-	printd("Font [%s] order: [", res_loc);
-	for (int i = 0; i < order_len; ++i) {
-		printd("%c", font->order[i]);
-		if (i < order_len - 1) {
-			printd(", ");
-		}
+		mtx_lock(&stream->lock);
+		stream->loaded[slot] = segment;
+		cnd_broadcast(&stream->changed);
 	}
-	printd("]\n");
-#endif
+	mtx_unlock(&stream->lock);
+	return 0;
 }
 
 /**
- * Frees a fonts data
- * @param font Font to free internal data from
+ * Moves the streaming window to follow the camera, and makes the segments around it resident.
+ * Call once per tick, before anything reads the tilemap
+ * @param map		Streamed tilemap
+ * @param center_x	Column at the center of the camera
+ * @param direction	Direction of travel (sign of the player's x speed), for prefetching
  */
-void font_free(font_t* font) {
-	sprite_free(&font->sprite_data);
+void tilemap_stream_update(tilemap_t* map, int center_x, float direction) {
+	tilemap_stream_t* stream = map->stream;
+	int center = CLAMP(center_x, 0, map->width - 1) / TILEMAP_SEGMENT_WIDTH;
+	int visible_first = MAX(center - TILEMAP_STREAM_VISIBLE, 0);
+	int visible_last = MIN(center + TILEMAP_STREAM_VISIBLE, stream->segment_count - 1);
+
+	// keep the window where it is while it still covers what's visible, plus a segment of margin.
+	// otherwise move it so most of it lies ahead of the player
+	int margin_first = MAX(visible_first - 1, 0), margin_last = MIN(visible_last + 1, stream->segment_count - 1);
+	if (margin_first < stream->window || margin_last >= stream->window + TILEMAP_STREAM_SEGMENTS) {
+		int behind = (direction < 0) ? TILEMAP_STREAM_SEGMENTS - 1 - TILEMAP_STREAM_BEHIND : TILEMAP_STREAM_BEHIND;
+		stream->window = CLAMP(center - behind, 0, MAX(stream->segment_count - TILEMAP_STREAM_SEGMENTS, 0));
+	}
+
+	mtx_lock(&stream->lock);
+	stream->center = center;
+	bool requested = false;
+	for (int segment = stream->window; segment < MIN(stream->window + TILEMAP_STREAM_SEGMENTS, stream->segment_count); ++segment) {
+		int slot = segment & (TILEMAP_STREAM_SEGMENTS - 1);
+		if (stream->wanted[slot] != segment) {
+			stream->wanted[slot] = segment;
+			requested = true;
+			++stream->loads;
+		}
+	}
+	if (requested) {
+		cnd_broadcast(&stream->changed);
+	}
+
+	// the visible segments have to be in before the simulation can continue
+	bool waited = false;
+	for (int segment = visible_first; segment <= visible_last; ++segment) {
+		while (stream->loaded[segment & (TILEMAP_STREAM_SEGMENTS - 1)] != segment) {
+			waited = true;
+			cnd_wait(&stream->changed, &stream->lock);
+		}
+	}
+	mtx_unlock(&stream->lock);
+	stream->waits += waited;
+
+	// columns entering or leaving the resident range change what they read as
+	int resident_x1 = visible_first * TILEMAP_SEGMENT_WIDTH;
+	int resident_x2 = MIN((visible_last + 1) * TILEMAP_SEGMENT_WIDTH, map->width);
+	int old_x1 = map->resident_x, old_x2 = map->resident_x + map->resident_width;
+	if (old_x1 >= old_x2) {
+		old_x1 = old_x2 = resident_x1;
+	}
+	tilemap_touch_columns(map, MIN(old_x1, resident_x1), MAX(old_x1, resident_x1));
+	tilemap_touch_columns(map, MIN(old_x2, resident_x2), MAX(old_x2, resident_x2));
+	map->resident_x = resident_x1;
+	map->resident_width = resident_x2 - resident_x1;
 }
 
 /**
- * Draws text to the screen at a given position
- * @param text 		Text to draw
- * @param font 		Font to draw with
- * @param x			X position to draw to
- * @param y			Y position to draw to
- * @param context	Current rendering context
+ * Sets a tilemap up to stream from a level file
+ * @param map		Tilemap with its layout set up for the full level (tilemap_init_layout)
+ * @param tiles		Packed tiles of the full level, in the mapped level file. Must outlive the tilemap
+ * @param center_x	Column the camera starts at
+ * @return Whether the streaming worker could be started. If not, the tilemap is left as it was
  */
-void text_draw(const char* text, font_t* font, float x, float y, render_context_t* context) {
-	size_t string_len = strlen(text), order_len = strlen(font->order);
-	int _x = x, _y = y;
-	int font_width = font->sprite_data.width, font_height = font->sprite_data.height;
-	for (int i = 0; i < string_len; ++i) {
-		if (text[i] == ' ') {
-			_x += font->spacing + font_width;
-			continue;
-		}
-		if (text[i] == '\n') {
-			_x = 0;
-			_y += font_height;
-			continue;
-		}
-		for (int j = 0; j < order_len; ++j) {
-			if (font->order[j] == text[i]) {
-				sprite_draw(&font->sprite_data, j, _x, _y, false, false, context);
-				_x += font_width + font->spacing;
-				break;
-			}
-		}
+bool tilemap_stream_open(tilemap_t* map, const packed_tile_t* tiles, int center_x) {
+	tilemap_t layout = *map;
+	tilemap_stream_t* stream = calloc(1, sizeof(tilemap_stream_t));
+	*stream = (tilemap_stream_t) {
+		.tiles = tiles,
+		.file_chunks_x = map->chunks_x,
+		.segment_count = (map->width + TILEMAP_SEGMENT_WIDTH - 1) / TILEMAP_SEGMENT_WIDTH,
+		.window = INT_MIN / 2	// forces the first update to place the window
+	};
+	for (int i = 0; i < TILEMAP_STREAM_SEGMENTS; ++i) {
+		stream->wanted[i] = stream->loaded[i] = -1;
+	}
+	mtx_init(&stream->lock, mtx_plain);
+	cnd_init(&stream->changed);
+
+	// storage for the ring only
+	const int ring_columns = TILEMAP_STREAM_SEGMENTS * TILEMAP_SEGMENT_WIDTH;
+	map->chunk_stride = ring_columns >> TILEMAP_CHUNK_SHIFT;
+	map->chunk_column_mask = map->chunk_stride - 1;
+	map->row_words = TILEMAP_STREAM_SEGMENTS;
+	map->word_mask = TILEMAP_STREAM_SEGMENTS - 1;
+	map->stored_columns = ring_columns;
+	map->column_mask = ring_columns - 1;
+	map->resident_width = 0;
+	tilemap_alloc(map);
+	map->stream = stream;
+
+	if (thrd_create(&stream->worker, tilemap_stream_worker, map) != thrd_success) {
+		map->stream = NULL;
+		tilemap_free(map);
+		*map = layout;
+		mtx_destroy(&stream->lock);
+		cnd_destroy(&stream->changed);
+		free(stream);
+		return false;
 	}
+	tilemap_stream_update(map, center_x, 1.0f);
+	return true;
+}
+
+void tilemap_stream_close(tilemap_t* map) {
+	tilemap_stream_t* stream = map->stream;
+	mtx_lock(&stream->lock);
+	stream->quit = true;
+	cnd_broadcast(&stream->changed);
+	mtx_unlock(&stream->lock);
+	thrd_join(stream->worker, NULL);
+
+	mtx_destroy(&stream->lock);
+	cnd_destroy(&stream->changed);
+	free(stream);
+	map->stream = NULL;
 }
 
 #pragma endregion
 
-#pragma region Animations
+#pragma region Control States
 
-typedef enum powerup { POWERUP_SMALL = 0, POWERUP_BIG, POWERUP_FIRE } powerup_t;
+typedef struct controller_buttons {
+	int h, v;
+	bool a, b, x, y;
+	bool l, r;
+} controller_buttons_t;
 
-struct mario_sprites {
-	sprite_t idle[2];
-	sprite_t walk[2];
-	sprite_t run[2];
-	sprite_t skid[2];
-	sprite_t kick[2];
-	sprite_t jump[2];
-	sprite_t runjump[2];
-	sprite_t spin[2];
-	sprite_t crouch[2];
-	sprite_t hold_idle[2];
-	sprite_t hold_walk[2];
-	sprite_t hold_swim[2];
-	sprite_t swim[2];
-	sprite_t peace[2];
-	sprite_t ride[2];
-	sprite_t slide[2];
-} mario_sprites;
-
-#pragma endregion
-
-#pragma region Physics & Collision
-
-struct physics_body {
-	float x, y;
-	int width, height;
-	float origin_x, origin_y;
-	float xspd, yspd;
-	float xspd_max, yspd_max;
-	float grav;
-	bool grounded;
+struct controller_state {
+	controller_buttons_t current;
+	controller_buttons_t previous;
 };
 
 /**
- * Initializes a physics body with default values
- * @param body		Physics body to initialize
- * @param width		Width of the physics body
- * @param height	Height of the physics body
+ * Advances a controller state by one tick
+ * @param state		Controller state to update
+ * @param buttons	Buttons held down this tick
  */
-void physics_body_init(physics_body_t* body, int width, int height) {
-	*body = (physics_body_t) {
-		.width = width,
-		.height = height,
-		.origin_x = 0.5f,
-		.origin_y = 1.0f,
-		.xspd_max = 5.0f,
-		.yspd_max = 5.0f,
-		.grav = 0.2f,
-	};
+void controller_state_update(controller_state_t* state, controller_buttons_t buttons) {
+	state->previous = state->current;
+	state->current = buttons;
 }
 
 /**
- * Resolves x-axis collisions on a physics body given a tilemap
- * @param body 	Physics body to perform collisions on
- * @return Rectangle that contains world space collision bounds
+ * Polls the keyboard for the buttons currently held down
+ * @return Buttons held down
  */
-Rectangle physics_body_get_rectangle(const physics_body_t* body) {
-	return (Rectangle) {
-		.x = body->x - body->width * body->origin_x,
-		.y = body->y - (body->height * body->origin_y),
-		.width = body->width,
-		.height = body->height
+controller_buttons_t controller_poll_keyboard(void) {
+	return (controller_buttons_t) {
+		.a = IsKeyDown(KEY_X),
+		.b = IsKeyDown(KEY_Z),
+		.x = IsKeyDown(KEY_C),
+		.y = IsKeyDown(KEY_V),
+		.h = IsKeyDown(KEY_RIGHT) - IsKeyDown(KEY_LEFT),
+		.v = IsKeyDown(KEY_DOWN) - IsKeyDown(KEY_UP)
 	};
 }
 
 /**
- * Resolves x-axis collisions on a physics body given a tilemap
- * @param body	Physics body to perform collisions on
- * @param map	Tilemap to check for collisions from
+ * Packs controller buttons into CONTROLLER_PACKED_BITS bits
+ * @param buttons Buttons to pack
+ * @return Packed buttons. Bits 0-1 are h + 1, bits 2-3 are v + 1, and bits 4-9 are a, b, x, y, l, r
  */
-void resolve_collisions_x(physics_body_t* body, const tilemap_t* map) {
-	int tile_size = map->tile_size;
-
-	Rectangle body_rect = physics_body_get_rectangle(body);
-	Rectangle left_rect = { body_rect.x, body_rect.y, 0, body_rect.height };
-	Rectangle right_rect = { body_rect.x + body_rect.width, body_rect.y, 0, body_rect.height };
-
-	int left = body_rect.x / tile_size, right = (body_rect.x + body_rect.width) / tile_size;
-	int top = body_rect.y / tile_size, bottom = (body_rect.y + body_rect.height) / tile_size;
-
-	for (int y = top - 1; y <= bottom + 1; ++y) {
-		// left
-		for (int x = left - 1; x <= left; ++x) {
-			collision_type_t tile_type = tilemap_get(map, x, y).collision;
-			if (tile_type == COLLISION_SOLID) {
-				Rectangle tile_rect = tilemap_get_rectangle(map, x, y);
-				if (rectangle_collision(left_rect, tile_rect)) {
-					body->x = tile_rect.x + tile_size + (body->width * body->origin_x);
-					body->xspd = 0;
-				}
-			}
-		}
-		// right
-		for (int x = right; x <= right + 1; ++x) {
-			collision_type_t tile_type = tilemap_get(map, x, y).collision;
-			if (tile_type == COLLISION_SOLID) {
-				Rectangle tile_rect = tilemap_get_rectangle(map, x, y);
-				if (rectangle_collision(right_rect, tile_rect)) {
-					body->x = tile_rect.x - body_rect.width + (body->width * body->origin_x);
-					body->xspd = 0;
-				}
-			}
-		}
-	}
+uint32_t controller_buttons_pack(controller_buttons_t buttons) {
+	return (uint32_t)(CLAMP(buttons.h, -1, 1) + 1) | ((uint32_t)(CLAMP(buttons.v, -1, 1) + 1) << 2) |
+		(buttons.a << 4) | (buttons.b << 5) | (buttons.x << 6) | (buttons.y << 7) | (buttons.l << 8) | (buttons.r << 9);
 }
 
 /**
- * Resolves y-axis collisions on a physics body given a tilemap
- * @param body 	Physics body to perform collisions on
- * @param map	Tilemap to check for collisions from
+ * Unpacks controller buttons packed by controller_buttons_pack
+ * @param packed Packed buttons
+ * @return Unpacked buttons
  */
-void resolve_collisions_y(physics_body_t* body, const tilemap_t* map) {
-	body->grounded = false;
-	int tile_size = map->tile_size;
-
-	Rectangle body_rect = physics_body_get_rectangle(body);
-	Rectangle bottom_rect = { body_rect.x, body_rect.y + body_rect.height, body_rect.width, 0 };
-	Rectangle top_rect = { body_rect.x, body_rect.y, body_rect.width, 0 };
-
-	int left = body_rect.x / tile_size, right = (body_rect.x + body_rect.width) / tile_size;
-	int top = body_rect.y / tile_size, bottom = (body_rect.y + body_rect.height) / tile_size;
-
-	for (int x = left - 1; x <= right + 1; ++x) {
-		// up
-		for (int y = top - 1; y <= top; ++y) {
-			collision_type_t tile_type = tilemap_get(map, x, y).collision;
-			if (tile_type == COLLISION_SOLID) {
-				Rectangle tile_rect = tilemap_get_rectangle(map, x, y);
-				if (rectangle_collision(top_rect, tile_rect)) {
-					body->y = tile_rect.y + tile_size + (body->height * body->origin_y);
-					body->yspd = 0;
-					PlaySound(sounds.bump);
-					return;
-				}
-			}
-		}
-		// down
-		for (int y = bottom; y <= bottom + 1; ++y) {
-			// horizontal line on bottom of physbody
-			collision_type_t tile_type = tilemap_get(map, x, y).collision;
-			if (tile_type == COLLISION_SOLID || tile_type == COLLISION_PLATFORM) {
-				Rectangle tile_rect = tilemap_get_rectangle(map, x, y);
-				if (rectangle_collision(bottom_rect, tile_rect)) {
-					body->y = tile_rect.y;
-					body->yspd = 0;
-					body->grounded = true;
-					return;
-				}
-			}
-		}
-	}
-}
-
-void physics_body_update(physics_body_t* body, const tilemap_t* tilemap) {
-	// adjust speeds
-	body->yspd += body->grav;
-	body->yspd = MIN(body->yspd, body->yspd_max);
-	if (body->grounded) body->xspd = CLAMP(body->xspd, -body->xspd_max, body->xspd_max);
-	
-	// move & collide
-	body->x += body->xspd;
-	resolve_collisions_x(body, tilemap);
-	body->y += body->yspd;
-	resolve_collisions_y(body, tilemap);
+controller_buttons_t controller_buttons_unpack(uint32_t packed) {
+	return (controller_buttons_t) {
+		.h = (int)(packed & 3) - 1,
+		.v = (int)((packed >> 2) & 3) - 1,
+		.a = (packed >> 4) & 1,
+		.b = (packed >> 5) & 1,
+		.x = (packed >> 6) & 1,
+		.y = (packed >> 7) & 1,
+		.l = (packed >> 8) & 1,
+		.r = (packed >> 9) & 1
+	};
 }
 
 #pragma endregion
 
-#pragma region Entity
-
-typedef long long entity_id_t;
-
-typedef enum entity_type {
-	ENTITY_NONE = -1,
-	ENTITY_GOOMBA = 0,
-	ENTITY_KOOPA,
-	ENTITY_PIRANHA,
-	ENTITY_COUNT,
-} entity_type_t;
-
-struct entity {
-	entity_id_t id;
-	entity_type_t type;
-	physics_body_t body;
-	bool is_active;
-	void (*update)(struct entity*, struct level*);
-	void (*draw)(struct entity*, struct level*, render_context_t* context);
-};
-
-ARRAYLIST_DEFINE(entity_t*, entityptr)
-
-#pragma endregion
-
-#pragma region Player Struct
+#pragma region Input Recording
 
-struct player {
-	physics_body_t body;
-	sprite_t* sprites_index;
-	bool flip_x;
-	bool is_big;
-	bool is_crouching;
-	float image_index;
-};
+/*
+ * Input recordings store the buttons of every controller, every tick. Each tick's buttons are packed
+ * into a single frame value (CONTROLLER_PACKED_BITS per controller), and repeated frames are
+ * run-length encoded. The file is a header followed by (run length, frame) pairs, both as LEB128
+ * varints, so held or idle input costs a couple of bytes per run rather than per tick.
+ *
+ * header: "SFMI" magic, u8 version, u8 controller count
+ */
 
-#pragma endregion
+typedef struct input_recorder {
+	FILE* file;
+	int controller_count;
+	uint64_t frame;
+	uint64_t run_length;
+} input_recorder_t;
 
-#pragma region Level Struct, Init, & Free
+typedef struct input_playback {
+	FILE* file;
+	int controller_count;
+	uint64_t frame;
+	uint64_t run_remaining;
+	bool finished;
+} input_playback_t;
+
+void varint_write(FILE* file, uint64_t value) {
+	do {
+		uint8_t byte = value & 0x7f;
+		value >>= 7;
+		fputc(byte | (value ? 0x80 : 0), file);
+	} while (value);
+}
 
-typedef struct camera {
-	int x, y;
-	int offset_x, offset_y;
-	int width, height;
-} camera_t;
+bool varint_read(FILE* file, uint64_t* value) {
+	*value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int byte = fgetc(file);
+		if (byte == EOF) {
+			return false;
+		}
+		*value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
 
-struct level {
-	player_t player;
-	entityptr_arraylist_t entities;
-	Color background_color;
-	background_t background;
-	tilemap_t tilemap;
-	entity_id_t next_entity_id;
-	camera_t camera;
-};
+/**
+ * Packs the current buttons of a set of controllers into one input frame
+ * @param controllers		Controllers to pack
+ * @param controller_count	Number of controllers
+ * @return Packed input frame
+ */
+uint64_t input_frame_pack(const controller_state_t* controllers, int controller_count) {
+	uint64_t frame = 0;
+	for (int i = 0; i < controller_count; ++i) {
+		frame |= (uint64_t)controller_buttons_pack(controllers[i].current) << (i * CONTROLLER_PACKED_BITS);
+	}
+	return frame;
+}
 
-void level_init(level_t* level, const char* background_res, Color background_color, int width_in_tiles, int height_in_tiles, int tile_size) {
-	*level = (level_t) { 
-		.background_color = background_color,
-		.camera = (camera_t) {
-			.offset_x = (-GAME_WIDTH / 2.0f),
-			.offset_y = (-GAME_HEIGHT / 2.0f),
-			.width = GAME_WIDTH,
-			.height = GAME_HEIGHT
-		}
-	};
+/**
+ * Opens an input recording for writing
+ * @param recorder			Recorder to initialize
+ * @param path				Path of the recording to write
+ * @param controller_count	Number of controllers to record
+ * @return Whether the recording file could be opened
+ */
+bool input_recorder_open(input_recorder_t* recorder, const char* path, int controller_count) {
+	*recorder = (input_recorder_t) { .controller_count = controller_count };
+	if ((recorder->file = fopen(path, "wb")) == NULL) {
+		printd("Could not open input recording [%s] for writing\n", path);
+		return false;
+	}
+	fwrite(INPUT_RECORDING_MAGIC, 1, 4, recorder->file);
+	fputc(INPUT_RECORDING_VERSION, recorder->file);
+	fputc(controller_count, recorder->file);
+	printd("Recording input to [%s]\n", path);
+	return true;
+}
 
-	// entities
-	player_init(&level->player);
-	entityptr_arraylist_init(&level->entities, ENTITY_DEFAULT_ALLOCATION_SIZE);
-	
-	// bg
-	background_init(background_res, &level->background, true);
-	level->background.y = -level->background.tex.height + GAME_HEIGHT;
-	level->background.clamp_x = false;
-	level->background.clamp_y = true;
-	level->background.parallax_x = 0.5f;
-	level->background.parallax_y = 1.0f;
+/**
+ * Records one tick of input
+ * @param recorder		Recorder to write to
+ * @param controllers	Controllers, as updated for this tick
+ */
+void input_recorder_push(input_recorder_t* recorder, const controller_state_t* controllers) {
+	if (recorder->file == NULL) {
+		return;
+	}
+	uint64_t frame = input_frame_pack(controllers, recorder->controller_count);
+	if (recorder->run_length > 0 && frame != recorder->frame) {
+		varint_write(recorder->file, recorder->run_length);
+		varint_write(recorder->file, recorder->frame);
+		recorder->run_length = 0;
+	}
+	recorder->frame = frame;
+	++recorder->run_length;
+}
 
-	// tilemap (temporary. delegated to a file type eventually)
-	tilemap_init(&level->tilemap, width_in_tiles, height_in_tiles, tile_size);
-	for (int i = 0; i <= 7; ++i) {
-		tilemap_set(&level->tilemap, i, 14, (tile_t) { .collision = COLLISION_SOLID });
+/**
+ * Flushes the last run and closes an input recording
+ * @param recorder Recorder to close
+ */
+void input_recorder_close(input_recorder_t* recorder) {
+	if (recorder->file == NULL) {
+		return;
 	}
-	for (int i = 8; i <= 12; ++i) {
-		tilemap_set(&level->tilemap, i, 15, (tile_t) { .collision = COLLISION_SOLID });
+	if (recorder->run_length > 0) {
+		varint_write(recorder->file, recorder->run_length);
+		varint_write(recorder->file, recorder->frame);
 	}
-	for (int i = 13; i <= 14; ++i) {
-		tilemap_set(&level->tilemap, i, 14, (tile_t) { .collision = COLLISION_SOLID });
+	fclose(recorder->file);
+	recorder->file = NULL;
+}
+
+/**
+ * Reads the next run of an input recording, marking playback as finished once there are none left
+ * @param playback Playback to read from
+ */
+void input_playback_read_run(input_playback_t* playback) {
+	if (!varint_read(playback->file, &playback->run_remaining) || !varint_read(playback->file, &playback->frame) || playback->run_remaining == 0) {
+		playback->finished = true;
+		printd("Input playback finished\n");
 	}
-	tilemap_set(&level->tilemap, 15, 13, (tile_t) { .collision = COLLISION_SOLID });
-	tilemap_set(&level->tilemap, 15, 12, (tile_t) { .collision = COLLISION_SOLID });
-	for (int i = 17; i <= 19; ++i) {
-		tilemap_set(&level->tilemap, i, 11, (tile_t) { .collision = COLLISION_SOLID });
+}
+
+/**
+ * Opens an input recording for playback
+ * @param playback	Playback to initialize
+ * @param path		Path of the recording to read
+ * @return Whether the recording could be opened and has a valid header
+ */
+bool input_playback_open(input_playback_t* playback, const char* path) {
+	*playback = (input_playback_t) { 0 };
+	if ((playback->file = fopen(path, "rb")) == NULL) {
+		printd("Could not open input recording [%s]\n", path);
+		return false;
 	}
-	tilemap_set(&level->tilemap, 16, 12, (tile_t) { .collision = COLLISION_SOLID });
-	for (int i = 20; i <= level->tilemap.width; ++i) {
-		tilemap_set(&level->tilemap, i, 10, (tile_t) { .collision = COLLISION_SOLID });
+	char magic[4];
+	int version, controller_count;
+	if (fread(magic, 1, 4, playback->file) != 4 || memcmp(magic, INPUT_RECORDING_MAGIC, 4) != 0 ||
+		(version = fgetc(playback->file)) != INPUT_RECORDING_VERSION ||
+		(controller_count = fgetc(playback->file)) == EOF || controller_count > MAX_CONTROLLERS) {
+		printd("Input recording [%s] is invalid\n", path);
+		fclose(playback->file);
+		playback->file = NULL;
+		return false;
 	}
+	playback->controller_count = controller_count;
+	printd("Playing back input from [%s] for [%d] controllers\n", path, controller_count);
+	input_playback_read_run(playback);
+	return true;
+}
 
-	tilemap_set(&level->tilemap, 0, 10, (tile_t) { .collision = COLLISION_SOLID });
-	for (int i = 2; i <= 5; ++i) {
-		tilemap_set(&level->tilemap, i, 9, (tile_t) { .collision = COLLISION_SOLID });
+/**
+ * Reads the next tick of input from a recording
+ * @param playback			Playback to read from
+ * @param buttons			Buttons for each controller (MAX_CONTROLLERS in size). Controllers not in the recording are released
+ * @return Whether there was input left to read
+ */
+bool input_playback_next(input_playback_t* playback, controller_buttons_t* buttons) {
+	if (playback->file == NULL || playback->finished) {
+		return false;
 	}
-	for (int i = 6; i <= 10; ++i) {
-		tilemap_set(&level->tilemap, i, 8, (tile_t) { .collision = COLLISION_SOLID });
+	for (int i = 0; i < MAX_CONTROLLERS; ++i) {
+		buttons[i] = (i < playback->controller_count) ?
+			controller_buttons_unpack((playback->frame >> (i * CONTROLLER_PACKED_BITS)) & ((1u << CONTROLLER_PACKED_BITS) - 1)) :
+			(controller_buttons_t) { 0 };
 	}
-	for (int i = 5; i <= 7; ++i) {
-		tilemap_set(&level->tilemap, 10, i, (tile_t) { .collision = COLLISION_SOLID });
+	// read ahead, so that playback is known to be finished as soon as the last tick is consumed
+	if (--playback->run_remaining == 0) {
+		input_playback_read_run(playback);
 	}
+	return true;
 }
 
-void level_free(level_t* level) {
-	for (int i = 0; i < level->entities.count; ++i) {
-		entity_t* entity = entityptr_arraylist_get(&level->entities, i);
-		if (entity != NULL) {
-			free(entity);
-		}
+void input_playback_close(input_playback_t* playback) {
+	if (playback->file != NULL) {
+		fclose(playback->file);
+		playback->file = NULL;
 	}
-	entityptr_arraylist_free(&level->entities);
-	background_free(&level->background);
-	tilemap_free(&level->tilemap);
 }
 
 #pragma endregion
 
-#pragma region Entity Functions
-
-void entity_init(entity_t* entity, entity_type_t type, level_t* level, int width, int height) {
-	*entity = (entity_t) {
-		.id = level->next_entity_id++,
-		.type = type
-	};
-	physics_body_init(&entity->body, width, height);
-}
+#pragma region Render Context
 
-void entity_update(entity_t* entity, level_t* level) {
-	// foobuh barfew lorem ipsum sum checksum ugugghh
-}
+// textures a queued quad can be drawn with: a sprite atlas page, or the blank texture for solid shapes
+#define SPRITE_BATCH_SHAPES 	ATLAS_MAX_PAGES
+#define SPRITE_BATCH_TEXTURES 	(ATLAS_MAX_PAGES + 1)
+#define SPRITE_BATCH_BLENDS 	8
+#define SPRITE_BATCH_KEYS 		(SPRITE_BATCH_BLENDS * SPRITE_BATCH_TEXTURES)
+
+// a queued quad (see sprite_batch_flush)
+typedef struct sprite_draw_command {
+	Rectangle source;	// in texels of the texture; a negative width flips the quad horizontally
+	Rectangle dest;		// top left corner & size
+	Color tint;
+	uint16_t key;		// blend mode * SPRITE_BATCH_TEXTURES + texture, which the queue is sorted by
+} sprite_draw_command_t;
+
+// what the sprite batch drew over a frame
+typedef struct sprite_batch_stats {
+	int draw_calls;		// runs of quads handed to rlgl, each of which is its own draw
+	int quads;
+	int texture_binds;	// draws using a different texture from the draw before
+	int dropped;		// quads past SPRITE_BATCH_MAX_QUADS
+} sprite_batch_stats_t;
 
-int compare_entities(const void* a, const void* b) {
-	const entity_t* entity_a = (const entity_t*)a;
-	const entity_t* entity_b = (const entity_t*)b;
-	return entity_a->id - entity_b->id; // returns 0 if the ID matches
-}
+struct render_context {
+	Texture sprite_atlas[ATLAS_MAX_PAGES];	// sprite atlas pages
+	int sprite_atlas_pages;
+	sprite_draw_command_t* sprite_batch;	// quads queued since the last flush
+	sprite_draw_command_t* sprite_batch_sorted;
+	int sprite_batch_count, sprite_batch_capacity;
+	sprite_batch_stats_t sprite_batch_stats;	// so far this frame; reset by the caller at the start of each frame
+	RenderTexture render_texture;
+	RenderTexture hud_texture;
+	RenderTexture capture_texture;	// game and HUD composited for the frame capture; loaded on the first captured frame
+	float interpolation;	// how far between the previous and current tick the frame being drawn is [0, 1]
+	bool tile_glow;			// debug glow over the tiles around the player
+	bool batch_stats;		// debug readout of sprite_batch_stats
+	soft_renderer_t* soft;	// rasterizes on the CPU instead of through rlgl when set
+};
 
 #pragma endregion
 
-#pragma region Enemies
+#pragma region Software Rendering
 
-typedef struct entity_goomba {
-	entity_t base;
-} entity_goomba_t;
+/*
+ * An optional CPU rasterizer standing in for rlgl, for machines without a GPU (golden images of
+ * replays, render benchmarks). When a render context has one, everything the game draws (the sprite
+ * batch, tile layers, backgrounds & the HUD) is rasterized into RGBA images instead. Sampling is
+ * nearest-neighbour and blending integer-only, so the same replay always gives byte-identical frames.
+ */
 
-void goomba_init(entity_goomba_t* entity, level_t* level) {
-	*entity = (entity_goomba_t) { 0 };
-	entity_init(&entity->base, ENTITY_GOOMBA, level, 8, 6);
-}
+struct soft_renderer {
+	Image framebuffer;		// game image (GAME_WIDTH x GAME_HEIGHT RGBA)
+	Image hud;				// retained HUD layer, laid over the game image (see hud_update)
+	Image* target;			// image being drawn to, like the render texture of BeginTextureMode
+	Rectangle clip;			// area of the target drawn to, like BeginScissorMode
+	int offset_x, offset_y;	// added to every quad, like rlTranslatef (see render_translate_begin)
+	Image sprite_atlas[ATLAS_MAX_PAGES];	// copies of the atlas pages the render context has as textures
+};
 
-void goomba_update(entity_t* entity, level_t* level) {
-	entity_goomba_t* g = (entity_goomba_t*)entity;
+/**
+ * Initializes a software renderer with blank images, drawing to the framebuffer
+ * @param soft Software renderer to initialize
+ */
+void soft_renderer_init(soft_renderer_t* soft) {
+	*soft = (soft_renderer_t) {
+		.framebuffer = GenImageColor(GAME_WIDTH, GAME_HEIGHT, BLANK),
+		.hud = GenImageColor(GAME_WIDTH, GAME_HEIGHT, BLANK)
+	};
+	soft->target = &soft->framebuffer;
+	soft->clip = (Rectangle) { 0, 0, GAME_WIDTH, GAME_HEIGHT };
 }
 
-void goomba_draw(entity_t* entity, level_t* level, render_context_t* context) {
-	entity_goomba_t* g = (entity_goomba_t*)entity;
+/**
+ * Frees a software renderer's images
+ * @param soft Software renderer to free
+ */
+void soft_renderer_free(soft_renderer_t* soft) {
+	UnloadImage(soft->framebuffer);
+	UnloadImage(soft->hud);
+	for (int i = 0; i < ATLAS_MAX_PAGES; ++i) {
+		if (soft->sprite_atlas[i].data != NULL) {
+			UnloadImage(soft->sprite_atlas[i]);
+		}
+	}
+	*soft = (soft_renderer_t) { 0 };
 }
 
-#pragma endregion
-
-#pragma region Game Control
+/**
+ * Starts drawing to an image, over all of it (see soft_clip)
+ * @param soft		Software renderer
+ * @param target	RGBA image to draw to, no wider than GAME_WIDTH
+ */
+void soft_begin(soft_renderer_t* soft, Image* target) {
+	soft->target = target;
+	soft->clip = (Rectangle) { 0, 0, target->width, target->height };
+}
 
-struct game {
-	int controller_count;
-	render_context_t render_context;
-	controller_state_t* controllers;
-	level_t* level;
-};
+/**
+ * Limits drawing to an area of the target, until the next soft_begin
+ */
+void soft_clip(soft_renderer_t* soft, Rectangle area) {
+	soft->clip = area;
+}
 
-void game_update(game_t* game) {
-	for (int i = 0; i < game->controller_count; ++i) {
-		controller_state_update(&game->controllers[i]);
+/**
+ * Fills the clipped area of the target with a color, replacing what's there like ClearBackground
+ */
+void soft_clear(soft_renderer_t* soft, Color color) {
+	Image* target = soft->target;
+	int x1 = MAX((int)soft->clip.x, 0), x2 = MIN((int)(soft->clip.x + soft->clip.width), target->width);
+	int y1 = MAX((int)soft->clip.y, 0), y2 = MIN((int)(soft->clip.y + soft->clip.height), target->height);
+	Color* pixels = target->data;
+	for (int y = y1; y < y2; ++y) {
+		for (int x = x1; x < x2; ++x) {
+			pixels[y * target->width + x] = color;
+		}
 	}
-	if (game->level) {
-		level_update(game->level, game);
+}
+
+/**
+ * Blends one channel the way OpenGL does for raylib's blend mode
+ * @param s		Source channel (texel * tint)
+ * @param sa	Source alpha
+ * @param d		Destination channel
+ * @param blend	Blend mode (BLEND_ALPHA, BLEND_ADDITIVE...)
+ * @return Blended channel
+ */
+static inline int soft_blend_channel(int s, int sa, int d, int blend) {
+	int c;
+	switch (blend) {
+		case BLEND_ADDITIVE:			c = (s * sa + d * 255 + 127) / 255; break;			// GL_SRC_ALPHA, GL_ONE
+		case BLEND_MULTIPLIED:			c = (s * d + d * (255 - sa) + 127) / 255; break;	// GL_DST_COLOR, GL_ONE_MINUS_SRC_ALPHA
+		case BLEND_ADD_COLORS:			c = s + d; break;									// GL_ONE, GL_ONE
+		case BLEND_SUBTRACT_COLORS:		c = s - d; break;									// GL_ONE, GL_ONE, GL_FUNC_SUBTRACT
+		case BLEND_ALPHA_PREMULTIPLY:	c = (s * 255 + d * (255 - sa) + 127) / 255; break;	// GL_ONE, GL_ONE_MINUS_SRC_ALPHA
+		default:						c = (s * sa + d * (255 - sa) + 127) / 255; break;	// GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
 	}
+	return CLAMP(c, 0, 255);
 }
 
-void game_draw(game_t* game) {
-	if (game->level) {
-		level_draw(game->level, &game->render_context);
+/**
+ * Draws a textured quad into the target, in the clipped area
+ * @param soft		Software renderer
+ * @param texture	RGBA image to sample, or NULL for a solid quad of the tint
+ * @param source	Area of the texture, in texels; a negative width flips the quad horizontally, a negative height vertically
+ * @param dest		Top left corner & size, before the renderer's offset
+ * @param tint		Color the texels are multiplied by
+ * @param blend		Blend mode (BLEND_ALPHA, BLEND_ADDITIVE...)
+ */
+void soft_draw_quad(soft_renderer_t* soft, const Image* texture, Rectangle source, Rectangle dest, Color tint, int blend) {
+	if (dest.width <= 0 || dest.height <= 0) {
+		return;
 	}
+	Image* target = soft->target;
+	dest.x += soft->offset_x;
+	dest.y += soft->offset_y;
 
-	// MVP - model, view [ view * model ]
-	text_draw("HELLO WORLD", &fnt_hud, 0, 0, &game->render_context);
-}
+	// pixels whose centres are inside the quad & the clip area
+	int x1 = MAX((int)ceilf(dest.x - 0.5f), MAX((int)soft->clip.x, 0));
+	int y1 = MAX((int)ceilf(dest.y - 0.5f), MAX((int)soft->clip.y, 0));
+	int x2 = MIN((int)ceilf(dest.x + dest.width - 0.5f), MIN((int)(soft->clip.x + soft->clip.width), target->width));
+	int y2 = MIN((int)ceilf(dest.y + dest.height - 0.5f), MIN((int)(soft->clip.y + soft->clip.height), target->height));
 
-void game_init(const char* window_title, game_t* game) {
+	if (x2 <= x1 || y2 <= y1) {
+		return;
+	}
+
+	bool flip_x = source.width < 0, flip_y = source.height < 0;
+	float source_width = fabsf(source.width), source_height = fabsf(source.height);
+	float step_x = source_width / dest.width, step_y = source_height / dest.height;
+	Color* pixels = target->data;
+	const Color* texels = (texture != NULL) ? texture->data : NULL;
+	bool is_white = (tint.r & tint.g & tint.b & tint.a) == 255;
+
+	// texel column of each pixel column, which is the same for every row
+	int columns[GAME_WIDTH];
+	for (int x = x1; x < x2 && texels != NULL; ++x) {
+		float offset = (x + 0.5f - dest.x) * step_x;
+		int u = (int)floorf(source.x + (flip_x ? source_width - offset : offset));
+		columns[x - x1] = CLAMP(u, 0, texture->width - 1);
+	}
+
+	for (int y = y1; y < y2; ++y) {
+		const Color* row = NULL;
+		if (texels != NULL) {
+			float offset = (y + 0.5f - dest.y) * step_y;
+			int v = (int)floorf(source.y + (flip_y ? source_height - offset : offset));
+			row = &texels[CLAMP(v, 0, texture->height - 1) * texture->width];
+		}
+		Color* d = &pixels[y * target->width + x1];
+		for (int x = x1; x < x2; ++x, ++d) {
+			Color s = tint;
+			if (row != NULL) {
+				s = row[columns[x - x1]];
+				if (!is_white) {
+					s = (Color) { (s.r * tint.r + 127) / 255, (s.g * tint.g + 127) / 255, (s.b * tint.b + 127) / 255, (s.a * tint.a + 127) / 255 };
+				}
+			}
+			if (blend == BLEND_ALPHA || blend == BLEND_ADDITIVE) {
+				// transparent texels leave the pixel as it is, and opaque ones alpha blend to themselves
+				if (s.a == 0) {
+					continue;
+				}
+				if (s.a == 255 && blend == BLEND_ALPHA) {
+					*d = s;
+					continue;
+				}
+			}
+			*d = (Color) {
+				soft_blend_channel(s.r, s.a, d->r, blend),
+				soft_blend_channel(s.g, s.a, d->g, blend),
+				soft_blend_channel(s.b, s.a, d->b, blend),
+				soft_blend_channel(s.a, s.a, d->a, blend)
+			};
+		}
+	}
+}
+
+/**
+ * Offsets what's drawn after it, until render_translate_end (rlTranslatef, or the software renderer's offset).
+ * Doesn't nest
+ * @param context	Current rendering context
+ * @param x			Offset along x
+ * @param y			Offset along y
+ */
+void render_translate_begin(render_context_t* context, int x, int y) {
+	if (context->soft != NULL) {
+		context->soft->offset_x = x;
+		context->soft->offset_y = y;
+		return;
+	}
+	rlPushMatrix();
+	rlTranslatef(x, y, 0);
+}
+
+/**
+ * Undoes render_translate_begin
+ * @param context Current rendering context
+ */
+void render_translate_end(render_context_t* context) {
+	if (context->soft != NULL) {
+		context->soft->offset_x = 0;
+		context->soft->offset_y = 0;
+		return;
+	}
+	rlPopMatrix();
+}
+
+#pragma endregion
+
+#pragma region Frame Capture
+
+/*
+ * Captures frames for bug reports & performance reviews without holding up the game. Each frame is
+ * copied into one slot of a ring of preallocated buffers, and a worker thread encodes filled slots
+ * in order. If the worker falls behind and the ring is full, the frame is dropped (and counted)
+ * rather than waited on.
+ *
+ * raw stream: "SFMC" magic, u8 version, u16 width, u16 height, then per frame a u64 frame number and
+ * width * height RGBA pixels, top row first (all little endian)
+ */
+
+typedef enum capture_format {
+	CAPTURE_RAW,	// one raw stream file
+	CAPTURE_PNG		// a directory of frame_<number>.png images
+} capture_format_t;
+
+typedef struct frame_capture {
+	thrd_t encoder;
+	mtx_t lock;
+	cnd_t changed;		// signaled when a frame is filled, encoded, or the encoder should quit
+	capture_format_t format;
+	char path[MAX_PATH_LEN];
+	FILE* file;			// raw stream; only written from the encoder once open
+	int width, height;
+	Color* pixels;		// FRAME_CAPTURE_RING_SIZE frames of width * height
+	long numbers[FRAME_CAPTURE_RING_SIZE];	// frame number of each slot, counting dropped frames
+	bool active;
+
+	// protected by lock
+	int head;			// oldest filled slot
+	int filled;			// slots waiting for the encoder, from head
+	bool quit;
+
+	// main thread only
+	int reserved;		// slot handed out by frame_capture_begin (-1 for none)
+	long captured;
+	long dropped;		// frames that came while the ring was full
+
+	// encoder only
+	long written;
+	bool failed;
+} frame_capture_t;
+
+/**
+ * Writes a value little endian
+ */
+static void capture_write_le(FILE* file, uint64_t value, int bytes) {
+	for (int i = 0; i < bytes; ++i) {
+		fputc((value >> (i * 8)) & 0xff, file);
+	}
+}
+
+/**
+ * Encodes one frame, from the encoder
+ */
+static void frame_capture_encode(frame_capture_t* capture, int slot) {
+	Color* pixels = &capture->pixels[(size_t)slot * capture->width * capture->height];
+	if (capture->failed) {
+		return;
+	}
+	if (capture->format == CAPTURE_RAW) {
+		capture_write_le(capture->file, (uint64_t)capture->numbers[slot], 8);
+		capture->failed = fwrite(pixels, sizeof(Color), (size_t)capture->width * capture->height, capture->file) != (size_t)capture->width * capture->height;
+	}
+	else {
+		// straight through stb, as raylib's TextFormat & ExportImage share static buffers with the main thread
+		char path[MAX_PATH_LEN + 32];
+		snprintf(path, sizeof(path), "%s/frame_%06ld.png", capture->path, capture->numbers[slot]);
+		capture->failed = !stbi_write_png(path, capture->width, capture->height, 4, pixels, capture->width * (int)sizeof(Color));
+	}
+	capture->written += !capture->failed;
+}
+
+int frame_capture_worker(void* arg) {
+	frame_capture_t* capture = arg;
+	mtx_lock(&capture->lock);
+	while (true) {
+		if (capture->filled == 0) {
+			// frames still waiting are written out before quitting
+			if (capture->quit) {
+				break;
+			}
+			cnd_wait(&capture->changed, &capture->lock);
+			continue;
+		}
+		int slot = capture->head;
+		mtx_unlock(&capture->lock);
+
+		frame_capture_encode(capture, slot);
+
+		mtx_lock(&capture->lock);
+		capture->head = (capture->head + 1) % FRAME_CAPTURE_RING_SIZE;
+		--capture->filled;
+	}
+	mtx_unlock(&capture->lock);
+	return 0;
+}
+
+/**
+ * Starts capturing frames, allocating the ring and starting the encoder
+ * @param capture	Capture to initialize
+ * @param path		Raw stream file to write, or existing directory for a PNG sequence
+ * @param format	What to write
+ * @param width		Width of the frames
+ * @param height	Height of the frames
+ * @return Whether the capture started
+ */
+bool frame_capture_open(frame_capture_t* capture, const char* path, capture_format_t format, int width, int height) {
+	*capture = (frame_capture_t) { .format = format, .width = width, .height = height, .reserved = -1 };
+	snprintf(capture->path, sizeof(capture->path), "%s", path);
+	if (format == CAPTURE_RAW) {
+		if ((capture->file = fopen(path, "wb")) == NULL) {
+			printf("Could not open frame capture [%s] for writing\n", path);
+			return false;
+		}
+		fwrite(FRAME_CAPTURE_MAGIC, 1, 4, capture->file);
+		fputc(FRAME_CAPTURE_VERSION, capture->file);
+		capture_write_le(capture->file, width, 2);
+		capture_write_le(capture->file, height, 2);
+	}
+
+	capture->pixels = malloc((size_t)FRAME_CAPTURE_RING_SIZE * width * height * sizeof(Color));
+	mtx_init(&capture->lock, mtx_plain);
+	cnd_init(&capture->changed);
+	if (capture->pixels == NULL || thrd_create(&capture->encoder, frame_capture_worker, capture) != thrd_success) {
+		printf("Could not start frame capture [%s]\n", path);
+		mtx_destroy(&capture->lock);
+		cnd_destroy(&capture->changed);
+		free(capture->pixels);
+		if (capture->file != NULL) {
+			fclose(capture->file);
+		}
+		*capture = (frame_capture_t) { 0 };
+		return false;
+	}
+	capture->active = true;
+	return true;
+}
+
+/**
+ * Takes the next free slot of the ring, to copy a frame into (top row first), then hand over with
+ * frame_capture_end. Never waits on the encoder
+ * @param capture Capture to take from
+ * @return The slot's pixels, or NULL if the frame has to be dropped
+ */
+Color* frame_capture_begin(frame_capture_t* capture) {
+	mtx_lock(&capture->lock);
+	int filled = capture->filled, head = capture->head;
+	mtx_unlock(&capture->lock);
+
+	// only this thread fills slots, so one free now stays free until it's handed over
+	if (filled == FRAME_CAPTURE_RING_SIZE) {
+		++capture->dropped;
+		return NULL;
+	}
+	capture->reserved = (head + filled) % FRAME_CAPTURE_RING_SIZE;
+	capture->numbers[capture->reserved] = capture->captured + capture->dropped;
+	return &capture->pixels[(size_t)capture->reserved * capture->width * capture->height];
+}
+
+/**
+ * Hands the slot from frame_capture_begin over to the encoder
+ * @param capture Capture the slot is from
+ */
+void frame_capture_end(frame_capture_t* capture) {
+	capture->reserved = -1;
+	++capture->captured;
+	mtx_lock(&capture->lock);
+	++capture->filled;
+	cnd_broadcast(&capture->changed);
+	mtx_unlock(&capture->lock);
+}
+
+/**
+ * Copies pixels into a slot of the ring, top row first
+ * @param capture	Capture the slot is from
+ * @param dest		Slot from frame_capture_begin
+ * @param pixels	RGBA pixels, width * height
+ * @param flip_y	Whether the pixels are bottom row first (as read back from a render texture)
+ */
+void frame_capture_copy(const frame_capture_t* capture, Color* dest, const void* pixels, bool flip_y) {
+	size_t row = (size_t)capture->width * sizeof(Color);
+	for (int y = 0; y < capture->height; ++y) {
+		memcpy((uint8_t*)dest + y * row, (const uint8_t*)pixels + (flip_y ? capture->height - 1 - y : y) * row, row);
+	}
+}
+
+/**
+ * Finishes writing any frames waiting in the ring, then stops the encoder and frees the ring
+ * @param capture Capture to close
+ */
+void frame_capture_close(frame_capture_t* capture) {
+	if (!capture->active) {
+		return;
+	}
+	mtx_lock(&capture->lock);
+	capture->quit = true;
+	cnd_broadcast(&capture->changed);
+	mtx_unlock(&capture->lock);
+	thrd_join(capture->encoder, NULL);
+
+	// printed in every build, a capture that silently dropped frames is worse than none
+	printf("Captured [%ld] frames to [%s], [%ld] dropped while the encoder was behind%s\n", capture->written, capture->path, capture->dropped, capture->failed ? " (writing failed)" : "");
+	if (capture->file != NULL) {
+		fclose(capture->file);
+	}
+	mtx_destroy(&capture->lock);
+	cnd_destroy(&capture->changed);
+	free(capture->pixels);
+	*capture = (frame_capture_t) { 0 };
+}
+
+#pragma endregion
+
+#pragma region Backgrounds
+
+typedef struct background {
+	float x, y;
+	float parallax_x;
+	float parallax_y;
+	Texture tex;
+	Image img;						// CPU copy, only loaded for the software renderer (see background_draw)
+	char img_path[MAX_PATH_LEN];	// where the copy is loaded from
+	bool clamp_x;
+	bool clamp_y;
+} background_t;
+
+/**
+ * Initializes a background
+ * @param res_loc		Local background resource name, ommitting path and file type (i.e. "glade" for "glade.png" inside of the backgrounds folder)
+ * @param background	Background to initialize
+ * @param tiled			Wrap texture at the ends
+ */
+void background_init(const char* res_loc, background_t* background, bool tiled) {
+	*background = (background_t) { 0 };
+
+	// index path
+	char indexed_loc[MAX_PATH_LEN] = "";
+	path_index(res_loc, indexed_loc);
+
+	// get full bg path
+	char img_path[MAX_PATH_LEN] = "";
+	snprintf(img_path, sizeof img_path, BACKGROUNDS_PATH "/%s.png", indexed_loc);
+	memcpy(background->img_path, img_path, sizeof(img_path));
+#ifdef HEADLESS
+	return;
+#endif
+
+	// open file for reading
+	FILE* f = fopen(img_path, "r");
+	if (f == NULL) {
+		printd("Background [%s] not found\n", res_loc);
+		return;
+	}
+
+	printd("Loading background res [%s]\n", img_path);
+	background->tex = LoadTexture(img_path);
+	
+	if (tiled) {
+		SetTextureWrap(background->tex, TEXTURE_WRAP_REPEAT);
+	}
+
+	fclose(f);
+}
+
+/**
+ * Draw background to screen using position / offset / parallax data in background
+ * @param background	Pointer to background to draw
+ * @param context		Current rendering context
+ */
+void background_draw(background_t* background, render_context_t* context) {
+	if (context->soft != NULL) {
+		// loaded on first use, since only the software renderer needs it
+		if (background->img.data == NULL && background->img_path[0] != '\0') {
+			background->img = LoadImage(background->img_path);
+			if (background->img.data != NULL) {
+				ImageFormat(&background->img, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+			}
+			background->img_path[0] = '\0';
+		}
+		if (background->img.data == NULL) {
+			return;
+		}
+		int bg_x = (int)(background->x * background->parallax_x) % background->img.width;
+		Rectangle bg_rect = (Rectangle) { .width = background->img.width, .height = background->img.height };
+		Rectangle screen_rect = (Rectangle) { bg_x, background->y * background->parallax_y, bg_rect.width, bg_rect.height };
+		soft_draw_quad(context->soft, &background->img, bg_rect, screen_rect, WHITE, BLEND_ALPHA);
+		return;
+	}
+	int bg_x = (int)(background->x * background->parallax_x) % background->tex.width;
+
+	Rectangle bg_rect = (Rectangle) { .width = background->tex.width, .height = background->tex.height };
+	Rectangle screen_rect = (Rectangle) { bg_x, background->y * background->parallax_y, bg_rect.width, bg_rect.height };
+	DrawTexturePro(background->tex, bg_rect, screen_rect, (Vector2) { 0, 0 }, 0, WHITE);
+}
+
+/**
+ * Free data inside of a background
+ * @param background Pointer to background to free data from
+ */
+void background_free(background_t* background) {
+#ifndef HEADLESS
+	UnloadTexture(background->tex);
+#endif
+	if (background->img.data != NULL) {
+		UnloadImage(background->img);
+	}
+}
+
+#pragma endregion
+
+#pragma region Tile Layers
+
+/*
+ * Static tiles are drawn from a cache of render textures, each holding one pre-rendered tilemap
+ * chunk. A cached chunk is only redrawn when its revision in the tilemap changes (see tilemap_set),
+ * so a frame draws a handful of chunk quads rather than every visible tile. The chunks in view come
+ * copied in the render snapshot (see level_snapshot), so drawing never reads the live tilemap.
+ */
+
+// a tilemap chunk copied for drawing
+typedef struct render_chunk {
+	int chunk_x, chunk_y;
+	uint32_t revision;
+	uint8_t collision[TILEMAP_CHUNK_SIZE * TILEMAP_CHUNK_SIZE];	// collision_type_t of each tile, row by row
+} render_chunk_t;
+
+typedef struct tile_layer_chunk {
+	RenderTexture texture;
+	int chunk_x, chunk_y;
+	uint32_t revision;		// tilemap chunk revision the texture was drawn at
+	unsigned long last_used;	// frame the chunk was last needed, for eviction
+	bool valid;
+} tile_layer_chunk_t;
+
+typedef struct tile_layer {
+	tile_layer_chunk_t chunks[TILE_LAYER_CACHE_SIZE];
+	unsigned long frame;
+	long rebuilds;	// chunk textures redrawn, for profiling
+} tile_layer_t;
+
+/**
+ * Frees the chunk textures of a tile layer
+ * @param layer Tile layer to free
+ */
+void tile_layer_free(tile_layer_t* layer) {
+	for (int i = 0; i < TILE_LAYER_CACHE_SIZE; ++i) {
+		if (layer->chunks[i].valid) {
+			UnloadRenderTexture(layer->chunks[i].texture);
+		}
+	}
+	*layer = (tile_layer_t) { 0 };
+}
+
+/**
+ * Gets the range of chunks a view overlaps, clamped to the tilemap
+ */
+static void tile_layer_view_chunks(const tilemap_t* map, int view_x, int view_y, int* cx1, int* cy1, int* cx2, int* cy2) {
+	int chunk_pixels = map->tile_size * TILEMAP_CHUNK_SIZE;
+	*cx1 = MAX(view_x, 0) / chunk_pixels;
+	*cy1 = MAX(view_y, 0) / chunk_pixels;
+	*cx2 = MIN((MAX(view_x + GAME_WIDTH, 0)) / chunk_pixels, map->chunks_x - 1);
+	*cy2 = MIN((MAX(view_y + GAME_HEIGHT, 0)) / chunk_pixels, map->chunks_y - 1);
+}
+
+/**
+ * Finds the cached texture of a chunk
+ * @return Cached chunk, or NULL if it isn't cached
+ */
+static tile_layer_chunk_t* tile_layer_find(tile_layer_t* layer, int chunk_x, int chunk_y) {
+	for (int i = 0; i < TILE_LAYER_CACHE_SIZE; ++i) {
+		tile_layer_chunk_t* chunk = &layer->chunks[i];
+		if (chunk->valid && chunk->chunk_x == chunk_x && chunk->chunk_y == chunk_y) {
+			return chunk;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Redraws any chunks that aren't cached or have changed. Must be called outside of texture mode,
+ * since it draws to the chunk textures
+ * @param layer			Tile layer to update
+ * @param chunks		Chunks in view
+ * @param chunk_count	Number of chunks
+ * @param tile_size		Tile size of the tilemap, in pixels
+ */
+void tile_layer_update(tile_layer_t* layer, const render_chunk_t* chunks, int chunk_count, int tile_size) {
+	++layer->frame;
+	int chunk_pixels = tile_size * TILEMAP_CHUNK_SIZE;
+
+	for (int c = 0; c < chunk_count; ++c) {
+		const render_chunk_t* source = &chunks[c];
+		tile_layer_chunk_t* chunk = tile_layer_find(layer, source->chunk_x, source->chunk_y);
+		if (chunk == NULL) {
+			// take a free slot, or the least recently used one that isn't in view
+			chunk = &layer->chunks[0];
+			for (int i = 0; i < TILE_LAYER_CACHE_SIZE && chunk->valid; ++i) {
+				if (!layer->chunks[i].valid || layer->chunks[i].last_used < chunk->last_used) {
+					chunk = &layer->chunks[i];
+				}
+			}
+			if (!chunk->valid) {
+				chunk->texture = LoadRenderTexture(chunk_pixels, chunk_pixels);
+				chunk->valid = true;
+			}
+			chunk->chunk_x = source->chunk_x;
+			chunk->chunk_y = source->chunk_y;
+			chunk->revision = source->revision - 1;
+		}
+		chunk->last_used = layer->frame;
+		if (chunk->revision == source->revision) {
+			continue;
+		}
+
+		BeginTextureMode(chunk->texture);
+		ClearBackground(BLANK);
+		for (int y = 0; y < TILEMAP_CHUNK_SIZE; ++y) {
+			for (int x = 0; x < TILEMAP_CHUNK_SIZE; ++x) {
+				if (source->collision[y * TILEMAP_CHUNK_SIZE + x] != COLLISION_AIR) {
+					DrawRectangleLinesEx((Rectangle) { x * tile_size, y * tile_size, tile_size, tile_size }, 1, TILE_LAYER_COLOR);
+				}
+			}
+		}
+		EndTextureMode();
+		chunk->revision = source->revision;
+		++layer->rebuilds;
+	}
+}
+
+/**
+ * Draws the chunks in view, in world space. The chunks must match the last tile_layer_update.
+ * The software renderer has no chunk textures, so it rasterizes the tiles directly
+ * @param layer			Tile layer to draw
+ * @param chunks		Chunks in view
+ * @param chunk_count	Number of chunks
+ * @param tile_size		Tile size of the tilemap, in pixels
+ * @param view_x		Left of the view, in pixels
+ * @param view_y		Top of the view, in pixels
+ * @param context		Current rendering context
+ */
+void tile_layer_draw(tile_layer_t* layer, const render_chunk_t* chunks, int chunk_count, int tile_size, int view_x, int view_y, render_context_t* context) {
+	int chunk_pixels = tile_size * TILEMAP_CHUNK_SIZE;
+	Rectangle view = { view_x, view_y, GAME_WIDTH, GAME_HEIGHT };
+
+	for (int c = 0; c < chunk_count; ++c) {
+		const render_chunk_t* source = &chunks[c];
+		int left = source->chunk_x * chunk_pixels, top = source->chunk_y * chunk_pixels;
+		if (!rectangle_collision(view, (Rectangle) { left, top, chunk_pixels, chunk_pixels })) {
+			continue;
+		}
+
+		if (context->soft != NULL) {
+			for (int y = 0; y < TILEMAP_CHUNK_SIZE; ++y) {
+				for (int x = 0; x < TILEMAP_CHUNK_SIZE; ++x) {
+					if (source->collision[y * TILEMAP_CHUNK_SIZE + x] == COLLISION_AIR) {
+						continue;
+					}
+					// the same outline as DrawRectangleLinesEx
+					float tile_left = left + x * tile_size, tile_top = top + y * tile_size;
+					soft_draw_quad(context->soft, NULL, (Rectangle) { 0 }, (Rectangle) { tile_left, tile_top, tile_size, 1 }, TILE_LAYER_COLOR, BLEND_ALPHA);
+					soft_draw_quad(context->soft, NULL, (Rectangle) { 0 }, (Rectangle) { tile_left, tile_top + tile_size - 1, tile_size, 1 }, TILE_LAYER_COLOR, BLEND_ALPHA);
+					soft_draw_quad(context->soft, NULL, (Rectangle) { 0 }, (Rectangle) { tile_left, tile_top + 1, 1, tile_size - 2 }, TILE_LAYER_COLOR, BLEND_ALPHA);
+					soft_draw_quad(context->soft, NULL, (Rectangle) { 0 }, (Rectangle) { tile_left + tile_size - 1, tile_top + 1, 1, tile_size - 2 }, TILE_LAYER_COLOR, BLEND_ALPHA);
+				}
+			}
+			continue;
+		}
+
+		tile_layer_chunk_t* chunk = tile_layer_find(layer, source->chunk_x, source->chunk_y);
+		if (chunk != NULL) {
+			// render textures are stored upside down
+			Rectangle texture_source = { 0, 0, chunk_pixels, -chunk_pixels };
+			DrawTextureRec(chunk->texture.texture, texture_source, (Vector2) { left, top }, WHITE);
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region Sprites
+
+struct sprite_frame {
+	int x, y;
+	int page;	// sprite atlas page (-1 if the frame didn't fit in the atlas)
+};
+
+typedef struct sprite {
+	int width, height;
+	int frame_count;
+	sprite_frame_t* frames;
+	int order_count;
+	int* order;
+} sprite_t;
+
+/**
+ * Frees the data inside of a sprite
+ * @param sprite Pointer to sprite to free data from
+ */
+void sprite_free(sprite_t* sprite) {
+	if (sprite->frames) {
+		free(sprite->frames);
+	}
+	if (sprite->order) {
+		free(sprite->order);
+	}
+}
+
+const sprite_frame_t sprite_get_frame(const sprite_t* sprite, int image_index) {
+	return (sprite->order == NULL) ?
+		sprite->frames[image_index % sprite->frame_count] :					// no custom order; get frame from image index
+		sprite->frames[sprite->order[image_index % sprite->order_count]];	// custom order; get frame from order index
+}
+
+/**
+ * Takes the next slot of the sprite batch
+ * @return The slot, or NULL if this frame's quad cap has been reached
+ */
+static sprite_draw_command_t* sprite_batch_push(render_context_t* context) {
+	if (context->sprite_batch_stats.quads + context->sprite_batch_count >= SPRITE_BATCH_MAX_QUADS) {
+		++context->sprite_batch_stats.dropped;
+		return NULL;
+	}
+	if (context->sprite_batch_count == context->sprite_batch_capacity) {
+		context->sprite_batch_capacity = MAX(context->sprite_batch_capacity * 2, SPRITE_BATCH_SIZE);
+		context->sprite_batch = realloc(context->sprite_batch, context->sprite_batch_capacity * sizeof(sprite_draw_command_t));
+		context->sprite_batch_sorted = realloc(context->sprite_batch_sorted, context->sprite_batch_capacity * sizeof(sprite_draw_command_t));
+	}
+	return &context->sprite_batch[context->sprite_batch_count++];
+}
+
+/**
+ * Queues a solid rectangle with the sprites, so debug shapes don't break up the batch
+ * @param rect		Rectangle to fill
+ * @param color		Color to fill with
+ * @param blend		Blend mode (BLEND_ALPHA, BLEND_ADDITIVE...)
+ * @param context	Current rendering context
+ */
+void sprite_batch_rectangle(Rectangle rect, Color color, int blend, render_context_t* context) {
+	sprite_draw_command_t* command = sprite_batch_push(context);
+	if (command != NULL) {
+		*command = (sprite_draw_command_t) {
+			.source = { 0, 0, 1, 1 },
+			.dest = rect,
+			.tint = color,
+			.key = blend * SPRITE_BATCH_TEXTURES + SPRITE_BATCH_SHAPES
+		};
+	}
+}
+
+/**
+ * Queues the outline of a rectangle, the same as DrawRectangleLinesEx
+ */
+void sprite_batch_rectangle_lines(Rectangle rect, float thickness, Color color, render_context_t* context) {
+	sprite_batch_rectangle((Rectangle) { rect.x, rect.y, rect.width, thickness }, color, BLEND_ALPHA, context);
+	sprite_batch_rectangle((Rectangle) { rect.x, rect.y + rect.height - thickness, rect.width, thickness }, color, BLEND_ALPHA, context);
+	sprite_batch_rectangle((Rectangle) { rect.x, rect.y + thickness, thickness, rect.height - thickness * 2 }, color, BLEND_ALPHA, context);
+	sprite_batch_rectangle((Rectangle) { rect.x + rect.width - thickness, rect.y + thickness, thickness, rect.height - thickness * 2 }, color, BLEND_ALPHA, context);
+}
+
+/**
+ * Sorts the queued quads by key (blend mode, then texture) into sprite_batch_sorted. The sort is a
+ * stable counting sort, so quads with the same key keep the order they were queued in
+ * @param context		Current rendering context
+ * @param run_starts	Filled with the index of the first quad of each key, plus the end [SPRITE_BATCH_KEYS + 1]
+ */
+void sprite_batch_sort(render_context_t* context, int* run_starts) {
+	memset(run_starts, 0, (SPRITE_BATCH_KEYS + 1) * sizeof(int));
+	for (int i = 0; i < context->sprite_batch_count; ++i) {
+		++run_starts[context->sprite_batch[i].key + 1];
+	}
+	for (int key = 0; key < SPRITE_BATCH_KEYS; ++key) {
+		run_starts[key + 1] += run_starts[key];
+	}
+	int next[SPRITE_BATCH_KEYS];
+	memcpy(next, run_starts, sizeof(next));
+	for (int i = 0; i < context->sprite_batch_count; ++i) {
+		context->sprite_batch_sorted[next[context->sprite_batch[i].key]++] = context->sprite_batch[i];
+	}
+}
+
+/**
+ * Rasterizes the sorted sprite batch with the software renderer, counting draws the same as rlgl
+ */
+static void sprite_batch_rasterize(render_context_t* context, const int* run_starts) {
+	soft_renderer_t* soft = context->soft;
+	sprite_batch_stats_t* stats = &context->sprite_batch_stats;
+	int bound = -1;
+	for (int key = 0; key < SPRITE_BATCH_KEYS; ++key) {
+		int begin = run_starts[key], end = run_starts[key + 1];
+		if (begin == end) {
+			continue;
+		}
+		int texture = key % SPRITE_BATCH_TEXTURES, blend = key / SPRITE_BATCH_TEXTURES;
+		const Image* page = (texture == SPRITE_BATCH_SHAPES) ? NULL : &soft->sprite_atlas[texture];
+		stats->texture_binds += (texture != bound);
+		bound = texture;
+		++stats->draw_calls;
+		for (int i = begin; i < end; ++i) {
+			const sprite_draw_command_t* command = &context->sprite_batch_sorted[i];
+			soft_draw_quad(soft, page, command->source, command->dest, command->tint, blend);
+		}
+	}
+}
+
+/**
+ * Draws every queued quad, sorted into one run per blend mode & texture, each handed to rlgl as a
+ * single draw. Draws with the same blend mode & texture keep their order; otherwise later textures
+ * (with solid shapes last) land on top, and blend modes are drawn in enum order. Must be called before
+ * anything that should be drawn over the queued quads, and before the transform they were queued under
+ * is popped. Counts what it drew into the context's sprite_batch_stats
+ * @param context Current rendering context
+ */
+void sprite_batch_flush(render_context_t* context) {
+	if (context->sprite_batch_count == 0) {
+		return;
+	}
+	int run_starts[SPRITE_BATCH_KEYS + 1];
+	sprite_batch_sort(context, run_starts);
+
+	sprite_batch_stats_t* stats = &context->sprite_batch_stats;
+	if (context->soft != NULL) {
+		sprite_batch_rasterize(context, run_starts);
+		stats->quads += context->sprite_batch_count;
+		context->sprite_batch_count = 0;
+		return;
+	}
+	unsigned int bound = 0;
+	int blend = BLEND_ALPHA;
+	for (int key = 0; key < SPRITE_BATCH_KEYS; ++key) {
+		int begin = run_starts[key], end = run_starts[key + 1];
+		if (begin == end) {
+			continue;
+		}
+		int texture = key % SPRITE_BATCH_TEXTURES;
+		Texture page = (texture == SPRITE_BATCH_SHAPES) ? (Texture) { .id = rlGetTextureIdDefault(), .width = 1, .height = 1 } : context->sprite_atlas[texture];
+		if (key / SPRITE_BATCH_TEXTURES != blend) {
+			blend = key / SPRITE_BATCH_TEXTURES;
+			BeginBlendMode(blend);
+		}
+		stats->texture_binds += (page.id != bound);
+		bound = page.id;
+		++stats->draw_calls;
+
+		for (int chunk = begin; chunk < end; chunk += SPRITE_BATCH_CHUNK) {
+			int count = MIN(end - chunk, SPRITE_BATCH_CHUNK);
+			// rlgl draws what it has so far if the chunk doesn't fit, which splits this run's draw
+			if (rlCheckRenderBatchLimit(count * 4) && chunk > begin) {
+				++stats->draw_calls;
+			}
+			rlSetTexture(page.id);
+			rlBegin(RL_QUADS);
+			rlNormal3f(0.0f, 0.0f, 1.0f);
+			for (int i = chunk; i < chunk + count; ++i) {
+				const sprite_draw_command_t* command = &context->sprite_batch_sorted[i];
+				Rectangle source = command->source, dest = command->dest;
+				float u1 = source.x / page.width, u2 = (source.x + fabsf(source.width)) / page.width;
+				float v1 = source.y / page.height, v2 = (source.y + source.height) / page.height;
+				if (source.width < 0) {
+					float swap = u1;
+					u1 = u2;
+					u2 = swap;
+				}
+				rlColor4ub(command->tint.r, command->tint.g, command->tint.b, command->tint.a);
+				rlTexCoord2f(u1, v1);
+				rlVertex2f(dest.x, dest.y);
+				rlTexCoord2f(u1, v2);
+				rlVertex2f(dest.x, dest.y + dest.height);
+				rlTexCoord2f(u2, v2);
+				rlVertex2f(dest.x + dest.width, dest.y + dest.height);
+				rlTexCoord2f(u2, v1);
+				rlVertex2f(dest.x + dest.width, dest.y);
+			}
+			rlEnd();
+		}
+	}
+	rlSetTexture(0);
+	if (blend != BLEND_ALPHA) {
+		EndBlendMode();
+	}
+	stats->quads += context->sprite_batch_count;
+	context->sprite_batch_count = 0;
+}
+
+/**
+ * Queues quads built ahead of time (see text_run_draw)
+ * @param commands	Quads to queue
+ * @param count		Number of quads
+ * @param context	Current rendering context
+ */
+void sprite_batch_append(const sprite_draw_command_t* commands, int count, render_context_t* context) {
+	int room = SPRITE_BATCH_MAX_QUADS - context->sprite_batch_stats.quads - context->sprite_batch_count;
+	if (count > room) {
+		context->sprite_batch_stats.dropped += count - MAX(room, 0);
+		count = MAX(room, 0);
+	}
+	if (context->sprite_batch_count + count > context->sprite_batch_capacity) {
+		context->sprite_batch_capacity = MAX(MAX(context->sprite_batch_capacity * 2, SPRITE_BATCH_SIZE), context->sprite_batch_count + count);
+		context->sprite_batch = realloc(context->sprite_batch, context->sprite_batch_capacity * sizeof(sprite_draw_command_t));
+		context->sprite_batch_sorted = realloc(context->sprite_batch_sorted, context->sprite_batch_capacity * sizeof(sprite_draw_command_t));
+	}
+	if (count > 0) {
+		memcpy(&context->sprite_batch[context->sprite_batch_count], commands, count * sizeof(sprite_draw_command_t));
+		context->sprite_batch_count += count;
+	}
+}
+
+/**
+ * Builds the quad a sprite frame is drawn with, without queueing it
+ * @param command	Quad to fill in
+ * @return Whether the frame is in the atlas (nothing to draw otherwise)
+ */
+bool sprite_draw_command(const sprite_t* sprite, int image_index, float x, float y, int origin_x, int origin_y, bool flip_x, const render_context_t* context, sprite_draw_command_t* command) {
+	// frame to utilize from sprite frames
+	sprite_frame_t frame = sprite_get_frame(sprite, image_index);
+	if (frame.page < 0 || frame.page >= context->sprite_atlas_pages) {
+		return false;
+	}
+	Rectangle sprite_rect = (Rectangle) { floorf(frame.x), floorf(frame.y), sprite->width, sprite->height };
+	if (flip_x) {
+		sprite_rect.width = -sprite_rect.width;
+	}
+	*command = (sprite_draw_command_t) {
+		.source = sprite_rect,
+		.dest = { floorf(x) - origin_x, floorf(y) - origin_y, sprite->width, sprite->height },
+		.tint = WHITE,
+		.key = BLEND_ALPHA * SPRITE_BATCH_TEXTURES + frame.page
+	};
+	return true;
+}
+
+void sprite_draw_ex(sprite_t* sprite, int image_index, float x, float y, int origin_x, int origin_y, bool flip_x, bool flip_y, render_context_t* context) {
+	sprite_draw_command_t command;
+	if (sprite_draw_command(sprite, image_index, x, y, origin_x, origin_y, flip_x, context, &command)) {
+		sprite_draw_command_t* slot = sprite_batch_push(context);
+		if (slot != NULL) {
+			*slot = command;
+		}
+	}
+}
+
+void sprite_draw(sprite_t* sprite, int image_index, float x, float y, bool flip_x, bool flip_y, render_context_t* context) {
+	sprite_draw_ex(sprite, image_index, x, y, 0.0f, 0.0f, flip_x, flip_y, context);
+}
+
+// a sprite's decoded image & .dat data, before it's been packed into an atlas
+typedef struct sprite_source {
+	Image img;
+	bool has_dat;		// frames are auto-spliced when there's no .dat file
+	int frame_count;
+	int order_count;
+	int* order;
+} sprite_source_t;
+
+/**
+ * Decodes a sprite's image and .dat file. Touches no shared state, so sprites can be decoded in parallel
+ * @param res_loc	Resource location
+ * @param source	Decoded sprite (img.data is NULL if there is no image)
+ */
+void sprite_decode(const char* res_loc, sprite_source_t* source) {
+	// replace all instances of "." with "/" for local resources
+	char indexed_fname[MAX_PATH_LEN] = "";
+	path_index(res_loc, indexed_fname);
+
+	*source = (sprite_source_t) { 0 };
+    
+    char image_path[MAX_PATH_LEN] = "", data_path[MAX_PATH_LEN] = "";
+	snprintf(image_path, sizeof image_path, SPRITES_PATH "/%s.png", indexed_fname);
+	snprintf(data_path, sizeof data_path, SPRITES_PATH "/%s.dat", indexed_fname);
+
+	FILE* file;
+	if ((file = fopen(image_path, "r")) == NULL) {
+		return;
+	}
+	fclose(file);
+
+    source->img = LoadImage(image_path);
+	if (source->img.data == NULL) {
+		return;
+	}
+
+    // load .dat file for the animation frames and order
+	if ((file = fopen(data_path, "r")) == NULL) {
+		return;
+	}
+	source->has_dat = true;
+    
+    char order_buf[256] = "";
+    char line[256] = "";
+
+    while (fgets(line, sizeof line, file)) {
+        if (source->frame_count == 0 && strncmp(line, "frames:", 7) == 0) {
+            if (sscanf(line, "frames: %d", &source->frame_count) != 1) {
+                break;
+            }
+        }
+        if (source->order == NULL && strncmp(line, "order:", 6) == 0) {
+            if (sscanf(line, "order: %s", order_buf) != 1) {
+                break;
+            }
+			else {
+                size_t order_len = strlen(order_buf);
+
+                // fetch count of frames to allocate for order
+                for (int i = 0; i < order_len;) {
+                    int temp;
+                    if (sscanf(order_buf + i, "%d", &temp) == 1) {
+                        while (order_buf[i] != ',' && i < order_len) {
+                            i++;
+                        }
+                        while (order_buf[i] == ',' && i < order_len) {
+                            i++;
+                        }
+                        source->order_count++;
+                    }
+					else i++;
+                }
+
+                source->order = malloc(source->order_count * sizeof(int));
+
+                // put animation frame order into the animation order array
+                for (int i = 0, num_count = 0; i < order_len;) {
+                    int temp;
+                    if (sscanf(order_buf + i, "%d", &temp) == 1) {
+                        while (order_buf[i] != ',' && i < order_len) {
+                            i++;
+                        }
+                        while (order_buf[i] == ',' && i < order_len) {
+                            i++;
+                        }
+                        source->order[num_count++] = temp;
+                    }
+					else i++;
+                }
+            }
+        }
+    }
+    fclose(file);
+}
+
+/**
+ * Sets a sprite up from its decoded source: its frame size & count, and its order table. Frame
+ * positions are filled in once every sprite's frames have been packed (see atlas_build)
+ * @param res_loc		Resource location (for logging)
+ * @param sprite		Sprite to initialize
+ * @param source		Decoded sprite. Its order table is handed over to the sprite
+ * @return Number of frames to pack
+ */
+int sprite_layout(const char* res_loc, sprite_t* sprite, sprite_source_t* source) {
+	*sprite = (sprite_t) { 0 };
+	Image img = source->img;
+	if (img.data == NULL) {
+		return 0;
+	}
+    int sprite_width = img.width, sprite_height = img.height;
+
+	if (!source->has_dat) {
+		// auto-spliced, using the image width as the frame height
+		sprite->frame_count = ceilf(sprite_height / (float)sprite_width);
+		sprite->frames = malloc(sprite->frame_count * sizeof(sprite_frame_t));
+		sprite->width = sprite_width;
+		sprite->height = sprite_width > sprite_height ? sprite_height : sprite_width;
+		printd("Loaded sprite [%s] with [%d] frames\n", res_loc, sprite->frame_count);
+		return sprite->frame_count;
+	}
+
+	if (source->frame_count > 0) {
+		sprite->frame_count = source->frame_count;
+		sprite->frames = malloc(sprite->frame_count * sizeof(sprite_frame_t));
+		sprite_height = img.height / sprite->frame_count;
+		printd("Frame dimensions: [%d, %d]\n", sprite_width, sprite_height);
+
+		sprite->width = sprite_width;
+		sprite->height = sprite_height;
+	}
+	sprite->order = source->order;
+	sprite->order_count = source->order_count;
+	source->order = NULL;
+
+#ifdef DEV
+	if (sprite->order) {
+		printd("Loaded sprite [%s] with [%d] frames and pre-defined order of [", res_loc, sprite->frame_count);
+		for (int i = 0; i < sprite->order_count; ++i) {
+			printd("%d", sprite->order[i]);
+			if (i < sprite->order_count - 1) {
+				printd(", ");
+			}
+		}
+		printd("]\n");
+	}
+	else {
+		printd("Loaded sprite [%s] with [%d] frames\n", res_loc, sprite->frame_count);
+	}
+#endif
+	return sprite->frame_count;
+}
+
+ARRAYLIST_DEFINE(sprite_t*, spriteptr)
+
+#pragma endregion
+
+#pragma region Sounds // TODO: should be passed by context
+
+struct sounds {
+	Sound bump;
+	Sound jump;
+} sounds;
+
+typedef enum sound_id {
+	SOUND_BUMP,
+	SOUND_JUMP
+} sound_id_t;
+
+// sounds asked for since the main thread last played them, one bit per sound_id_t
+atomic_uint sounds_queued;
+
+/**
+ * Queues a sound to be played by the main thread (see sound_play_queued), as the simulation may be on
+ * a thread of its own and raylib's audio isn't safe to call from one
+ * @param sound Sound to play
+ */
+void sound_play(sound_id_t sound) {
+	atomic_fetch_or(&sounds_queued, 1u << sound);
+}
+
+/**
+ * Plays every sound queued since the last call, unless there is no audio device (headless). Main thread only
+ */
+void sound_play_queued(void) {
+	unsigned int queued = atomic_exchange(&sounds_queued, 0);
+#ifndef HEADLESS
+	if (queued & (1u << SOUND_BUMP)) {
+		PlaySound(sounds.bump);
+	}
+	if (queued & (1u << SOUND_JUMP)) {
+		PlaySound(sounds.jump);
+	}
+#else
+	(void)queued;
+#endif
+}
+
+#pragma endregion
+
+#pragma region Text
+
+typedef struct font {
+	sprite_t sprite_data;
+	char order[256];
+	int16_t glyphs[256];	// frame of each character, by byte (-1 if the font doesn't have it)
+	int spacing;
+} font_t;
+
+// a string laid out once and kept as quads, so drawing it again is a copy into the sprite batch
+typedef struct text_run {
+	char* text;			// text the quads were laid out for
+	size_t text_capacity;
+	const font_t* font;
+	float x, y;
+	sprite_draw_command_t* quads;
+	int quad_count, quad_capacity;
+	int atlas_pages;	// atlas pages there were when laid out, since frames past them are skipped
+} text_run_t;
+
+font_t fnt_hud;
+
+/**
+ * Initializes a font whose sprite has been loaded with the atlases (see atlas_sprites)
+ * @param order			Order of the font (e.g. 'ABCDEFGHIJKLMNOPQRSTUVWXYZ')
+ * @param font			Pointer to the font to initialize
+ */
+void font_init(const char* order, font_t* font) {
+	font->spacing = 0;
+	int order_len = MIN(strlen(order), sizeof(font->order) - 1);
+	memcpy((void*)font->order, order, (size_t)order_len);
+	font->order[order_len] = '\0';
+	for (int i = 0; i < 256; ++i) {
+		font->glyphs[i] = -1;
+	}
+	// backwards, so a character listed twice keeps its first frame like the old linear search did
+	for (int i = order_len - 1; i >= 0; --i) {
+		font->glyphs[(unsigned char)order[i]] = i;
+	}
+	// spaces & newlines only move the pen
+	font->glyphs[' '] = -1;
+	font->glyphs['\n'] = -1;
+#ifdef DEV
+	printd("Font order: [");
+	for (int i = 0; i < order_len; ++i) {
+		printd("%c", font->order[i]);
+		if (i < order_len - 1) {
+			printd(", ");
+		}
+	}
+	printd("]\n");
+#endif
+}
+
+/**
+ * Frees a fonts data
+ * @param font Font to free internal data from
+ */
+void font_free(font_t* font) {
+	sprite_free(&font->sprite_data);
+}
+
+/**
+ * Finds the next character of a string the font can draw, moving the pen past it
+ * @param font		Font to draw with
+ * @param text		Position in the string; left just after the character found
+ * @param line_x	X position lines start at
+ * @param pen_x		Where the next character goes
+ * @param pen_y		Where the current line is
+ * @param glyph_x	Set to where the character found goes
+ * @return Frame of the character found, or -1 at the end of the string
+ */
+static int text_next_glyph(const font_t* font, const char** text, float line_x, float* pen_x, float* pen_y, float* glyph_x) {
+	int advance = font->sprite_data.width + font->spacing;
+	for (unsigned char c; (c = (unsigned char)**text) != '\0';) {
+		++*text;
+		if (c == ' ') {
+			*pen_x += advance;
+			continue;
+		}
+		if (c == '\n') {
+			*pen_x = line_x;
+			*pen_y += font->sprite_data.height;
+			continue;
+		}
+		int glyph = font->glyphs[c];
+		if (glyph >= 0) {
+			*glyph_x = *pen_x;
+			*pen_x += advance;
+			return glyph;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Draws text to the screen at a given position
+ * @param text 		Text to draw
+ * @param font 		Font to draw with
+ * @param x			X position to draw to
+ * @param y			Y position to draw to
+ * @param context	Current rendering context
+ */
+void text_draw(const char* text, font_t* font, float x, float y, render_context_t* context) {
+	float line_x = (int)x, pen_x = line_x, pen_y = (int)y, glyph_x;
+	for (int glyph; (glyph = text_next_glyph(font, &text, line_x, &pen_x, &pen_y, &glyph_x)) >= 0;) {
+		sprite_draw(&font->sprite_data, glyph, glyph_x, pen_y, false, false, context);
+	}
+}
+
+/**
+ * Lays a string out into a text run's quads
+ * @param run		Text run to lay out into
+ * @param text		Text to lay out
+ * @param font		Font to draw with
+ * @param x			X position to draw to
+ * @param y			Y position to draw to
+ * @param context	Current rendering context
+ */
+void text_run_layout(text_run_t* run, const char* text, const font_t* font, float x, float y, const render_context_t* context) {
+	size_t text_len = strlen(text);
+	if (text_len + 1 > run->text_capacity) {
+		run->text_capacity = MAX(text_len + 1, run->text_capacity * 2);
+		run->text = realloc(run->text, run->text_capacity);
+	}
+	memcpy(run->text, text, text_len + 1);
+	if ((int)text_len > run->quad_capacity) {
+		run->quad_capacity = MAX((int)text_len, run->quad_capacity * 2);
+		run->quads = realloc(run->quads, run->quad_capacity * sizeof(sprite_draw_command_t));
+	}
+	run->font = font;
+	run->x = x;
+	run->y = y;
+	run->atlas_pages = context->sprite_atlas_pages;
+	run->quad_count = 0;
+
+	float line_x = (int)x, pen_x = line_x, pen_y = (int)y, glyph_x;
+	for (int glyph; (glyph = text_next_glyph(font, &text, line_x, &pen_x, &pen_y, &glyph_x)) >= 0;) {
+		run->quad_count += sprite_draw_command(&font->sprite_data, glyph, glyph_x, pen_y, 0, 0, false, context, &run->quads[run->quad_count]);
+	}
+}
+
+/**
+ * Draws text through a text run, only laying it out again when the text, font or position changed since the last draw.
+ * Meant for strings drawn every frame that rarely change (labels, scores, timers...)
+ * @param run		Text run kept between frames for this string
+ * @param text		Text to draw
+ * @param font		Font to draw with
+ * @param x			X position to draw to
+ * @param y			Y position to draw to
+ * @param context	Current rendering context
+ */
+void text_run_draw(text_run_t* run, const char* text, const font_t* font, float x, float y, render_context_t* context) {
+	if (run->text == NULL || run->font != font || run->x != x || run->y != y || run->atlas_pages != context->sprite_atlas_pages || strcmp(run->text, text) != 0) {
+		text_run_layout(run, text, font, x, y, context);
+	}
+	sprite_batch_append(run->quads, run->quad_count, context);
+}
+
+/**
+ * Frees a text run's data
+ * @param run Text run to free
+ */
+void text_run_free(text_run_t* run) {
+	free(run->text);
+	free(run->quads);
+	*run = (text_run_t) { 0 };
+}
+
+#pragma endregion
+
+#pragma region HUD
+
+/*
+ * The HUD is retained: elements are registered once, and only drawn into the HUD texture when one
+ * of them changes, and then only over the area that changed. Each frame the HUD texture is laid over
+ * the scaled game image as a single quad.
+ */
+
+typedef enum hud_element_type {
+	HUD_TEXT,		// fixed text (a label)
+	HUD_COUNTER,	// a number shown through a format (a score, timer...)
+	HUD_ICON		// a sprite frame
+} hud_element_type_t;
+
+typedef struct hud_element {
+	hud_element_type_t type;
+	float x, y;
+	const font_t* font;		// text & counters
+	const char* format;		// counters; printf format of the value, which must outlive the HUD
+	int value;
+	char text[HUD_TEXT_SIZE];
+	text_run_t run;
+	const sprite_t* sprite;	// icons
+	int image_index;
+	Rectangle bounds;		// area last drawn over, which needs clearing when the element changes
+	bool changed;
+} hud_element_t;
+
+typedef struct hud {
+	hud_element_t* elements;
+	int element_count, element_capacity;
+	Rectangle dirty;		// area of the HUD texture out of date
+	long redraws;			// times the HUD texture was redrawn, for profiling
+} hud_t;
+
+/**
+ * Initializes a HUD with no elements. The whole HUD texture is cleared on the first update
+ * @param hud HUD to initialize
+ */
+void hud_init(hud_t* hud) {
+	*hud = (hud_t) { .dirty = { 0, 0, GAME_WIDTH, GAME_HEIGHT } };
+}
+
+/**
+ * Frees a HUD's elements
+ * @param hud HUD to free
+ */
+void hud_free(hud_t* hud) {
+	for (int i = 0; i < hud->element_count; ++i) {
+		text_run_free(&hud->elements[i].run);
+	}
+	free(hud->elements);
+	*hud = (hud_t) { 0 };
+}
+
+/**
+ * Registers an element with a HUD
+ * @return Handle of the element
+ */
+static int hud_add(hud_t* hud, hud_element_t element) {
+	if (hud->element_count == hud->element_capacity) {
+		hud->element_capacity = MAX(hud->element_capacity * 2, 8);
+		hud->elements = realloc(hud->elements, hud->element_capacity * sizeof(hud_element_t));
+	}
+	element.changed = true;
+	hud->elements[hud->element_count] = element;
+	return hud->element_count++;
+}
+
+/**
+ * Registers text with a HUD
+ * @param hud	HUD to add to
+ * @param text	Text to show (cut off at HUD_TEXT_SIZE)
+ * @param font	Font to draw with
+ * @param x		X position on the HUD
+ * @param y		Y position on the HUD
+ * @return Handle of the element (see hud_set_text)
+ */
+int hud_add_text(hud_t* hud, const char* text, const font_t* font, float x, float y) {
+	hud_element_t element = { .type = HUD_TEXT, .x = x, .y = y, .font = font };
+	snprintf(element.text, sizeof(element.text), "%s", text);
+	return hud_add(hud, element);
+}
+
+/**
+ * Registers a counter with a HUD
+ * @param hud		HUD to add to
+ * @param format	printf format the value is shown with (e.g. "SCORE %06d"); not copied
+ * @param value		Value to start with
+ * @param font		Font to draw with
+ * @param x			X position on the HUD
+ * @param y			Y position on the HUD
+ * @return Handle of the element (see hud_set_value)
+ */
+int hud_add_counter(hud_t* hud, const char* format, int value, const font_t* font, float x, float y) {
+	hud_element_t element = { .type = HUD_COUNTER, .x = x, .y = y, .font = font, .format = format, .value = value };
+	snprintf(element.text, sizeof(element.text), format, value);
+	return hud_add(hud, element);
+}
+
+/**
+ * Registers an icon with a HUD
+ * @param hud			HUD to add to
+ * @param sprite		Sprite to draw
+ * @param image_index	Frame of the sprite to draw
+ * @param x				X position on the HUD
+ * @param y				Y position on the HUD
+ * @return Handle of the element (see hud_set_frame)
+ */
+int hud_add_icon(hud_t* hud, const sprite_t* sprite, int image_index, float x, float y) {
+	return hud_add(hud, (hud_element_t) { .type = HUD_ICON, .x = x, .y = y, .sprite = sprite, .image_index = image_index });
+}
+
+/**
+ * Changes the text of a text element. Nothing is redrawn if it's the same
+ */
+void hud_set_text(hud_t* hud, int element_id, const char* text) {
+	hud_element_t* element = &hud->elements[element_id];
+	if (strncmp(element->text, text, sizeof(element->text) - 1) != 0) {
+		snprintf(element->text, sizeof(element->text), "%s", text);
+		element->changed = true;
+	}
+}
+
+/**
+ * Changes the value of a counter. Nothing is redrawn if it's the same
+ */
+void hud_set_value(hud_t* hud, int element_id, int value) {
+	hud_element_t* element = &hud->elements[element_id];
+	if (element->value != value) {
+		element->value = value;
+		snprintf(element->text, sizeof(element->text), element->format, value);
+		element->changed = true;
+	}
+}
+
+/**
+ * Changes the frame of an icon. Nothing is redrawn if it's the same
+ */
+void hud_set_frame(hud_t* hud, int element_id, int image_index) {
+	hud_element_t* element = &hud->elements[element_id];
+	if (element->image_index != image_index) {
+		element->image_index = image_index;
+		element->changed = true;
+	}
+}
+
+/**
+ * Lays out the elements that changed, and takes the area of the HUD texture that needs redrawing
+ * @param hud		HUD to lay out
+ * @param context	Current rendering context
+ * @param area		Set to the area to redraw, in whole pixels
+ * @return Whether anything needs redrawing
+ */
+bool hud_layout(hud_t* hud, const render_context_t* context, Rectangle* area) {
+	for (int i = 0; i < hud->element_count; ++i) {
+		hud_element_t* element = &hud->elements[i];
+		if (!element->changed) {
+			continue;
+		}
+		Rectangle bounds = { element->x, element->y, 0, 0 };
+		if (element->type == HUD_ICON) {
+			bounds.width = element->sprite->width;
+			bounds.height = element->sprite->height;
+		}
+		else {
+			text_run_layout(&element->run, element->text, element->font, element->x, element->y, context);
+			for (int j = 0; j < element->run.quad_count; ++j) {
+				bounds = (j == 0) ? element->run.quads[j].dest : rectangle_union(bounds, element->run.quads[j].dest);
+			}
+		}
+		// the old area is cleared as well, in case the element shrank
+		hud->dirty = rectangle_union(hud->dirty, rectangle_union(element->bounds, bounds));
+		element->bounds = bounds;
+		element->changed = false;
+	}
+
+	float x1 = MAX(floorf(hud->dirty.x), 0), y1 = MAX(floorf(hud->dirty.y), 0);
+	float x2 = MIN(ceilf(hud->dirty.x + hud->dirty.width), GAME_WIDTH), y2 = MIN(ceilf(hud->dirty.y + hud->dirty.height), GAME_HEIGHT);
+	hud->dirty = (Rectangle) { 0 };
+	if (x2 <= x1 || y2 <= y1) {
+		return false;
+	}
+	*area = (Rectangle) { x1, y1, x2 - x1, y2 - y1 };
+	return true;
+}
+
+/**
+ * Queues the elements overlapping an area of the HUD with the sprites
+ * @param hud		HUD to draw
+ * @param area		Area being redrawn
+ * @param context	Current rendering context
+ */
+void hud_queue(hud_t* hud, Rectangle area, render_context_t* context) {
+	for (int i = 0; i < hud->element_count; ++i) {
+		hud_element_t* element = &hud->elements[i];
+		if (!rectangle_collision(element->bounds, area)) {
+			continue;
+		}
+		if (element->type == HUD_ICON) {
+			sprite_draw((sprite_t*)element->sprite, element->image_index, element->x, element->y, false, false, context);
+		}
+		else {
+			sprite_batch_append(element->run.quads, element->run.quad_count, context);
+		}
+	}
+}
+
+/**
+ * Redraws the part of the HUD texture that changed, if any. Must be called outside of texture mode,
+ * since it draws to the HUD texture
+ * @param hud		HUD to update
+ * @param context	Current rendering context
+ */
+void hud_update(hud_t* hud, render_context_t* context) {
+	Rectangle area;
+	if (!hud_layout(hud, context, &area)) {
+		return;
+	}
+	if (context->soft != NULL) {
+		Image* target = context->soft->target;
+		soft_begin(context->soft, &context->soft->hud);
+		soft_clip(context->soft, area);
+		soft_clear(context->soft, BLANK);
+		hud_queue(hud, area, context);
+		sprite_batch_flush(context);
+		soft_begin(context->soft, target);
+		++hud->redraws;
+		return;
+	}
+	BeginTextureMode(context->hud_texture);
+	BeginScissorMode(area.x, area.y, area.width, area.height);
+	ClearBackground(BLANK);
+	hud_queue(hud, area, context);
+	sprite_batch_flush(context);
+	EndScissorMode();
+	EndTextureMode();
+	++hud->redraws;
+}
+
+#pragma endregion
+
+#pragma region Animations
+
+typedef enum powerup { POWERUP_SMALL = 0, POWERUP_BIG, POWERUP_FIRE } powerup_t;
+
+struct mario_sprites {
+	sprite_t idle[2];
+	sprite_t walk[2];
+	sprite_t run[2];
+	sprite_t skid[2];
+	sprite_t kick[2];
+	sprite_t jump[2];
+	sprite_t runjump[2];
+	sprite_t spin[2];
+	sprite_t crouch[2];
+	sprite_t hold_idle[2];
+	sprite_t hold_walk[2];
+	sprite_t hold_swim[2];
+	sprite_t swim[2];
+	sprite_t peace[2];
+	sprite_t ride[2];
+	sprite_t slide[2];
+} mario_sprites;
+
+#pragma endregion
+
+#pragma region Atlases
+
+/*
+ * Sprites & tiles are packed into atlases at startup. Decoding and packing every source image is the
+ * bulk of startup time, so the packed atlases are cooked into a cache file along with each sprite's
+ * frame & order tables, keyed by a hash of every source file. On a cache hit startup maps that one
+ * file and uploads it as is; the atlases are only rebuilt when a source changes.
+ */
+
+typedef struct atlas_sprite {
+	const char* res_loc;
+	sprite_t* sprite;
+} atlas_sprite_t;
+
+// todo: asset loading automation!
+atlas_sprite_t atlas_sprites[] = {
+	{ "mario.idle_small",	&mario_sprites.idle[POWERUP_SMALL] },
+	{ "mario.walk_small",	&mario_sprites.walk[POWERUP_SMALL] },
+	{ "mario.run_small",	&mario_sprites.run[POWERUP_SMALL] },
+	{ "mario.jump_small",	&mario_sprites.jump[POWERUP_SMALL] },
+	{ "mario.skid_small",	&mario_sprites.skid[POWERUP_SMALL] },
+
+	{ "mario.idle_big",		&mario_sprites.idle[POWERUP_BIG] },
+	{ "mario.crouch_big",	&mario_sprites.crouch[POWERUP_BIG] },
+	{ "mario.walk_big",		&mario_sprites.walk[POWERUP_BIG] },
+	{ "mario.run_big",		&mario_sprites.run[POWERUP_BIG] },
+	{ "mario.jump_big",		&mario_sprites.jump[POWERUP_BIG] },
+	{ "mario.skid_big",		&mario_sprites.skid[POWERUP_BIG] },
+
+	{ "font.hud",			&fnt_hud.sprite_data },
+};
+
+const char* atlas_tilesets[] = { "glade", "ice" };
+
+// where a tile was packed in the tile atlas
+typedef struct tile_slot {
+	int x, y;
+	int page;	// tile atlas page (-1 if the tile didn't fit in the atlas)
+} tile_slot_t;
+
+typedef struct tileset {
+	int columns, rows;
+	int* slots;		// tile atlas slot of each tile, row-major (-1 for empty tiles)
+} tileset_t;
+
+// lookup from tilesets into the tile atlas. identical tiles share a slot. tiles only carry collision so
+// far, so nothing draws from it yet and its pages are never uploaded
+struct tile_atlas {
+	tileset_t tilesets[sizeof(atlas_tilesets) / sizeof(atlas_tilesets[0])];
+	tile_slot_t* slots;
+	int slot_count;
+} tile_atlas;
+
+void tile_atlas_free(void) {
+	for (int i = 0; i < sizeof(atlas_tilesets) / sizeof(atlas_tilesets[0]); ++i) {
+		free(tile_atlas.tilesets[i].slots);
+	}
+	free(tile_atlas.slots);
+	tile_atlas = (struct tile_atlas) { 0 };
+}
+
+// a distinct tile found while building the tile atlas
+typedef struct tile_source {
+	const uint8_t* pixels;	// top left pixel, in its decoded tileset
+	size_t stride;			// bytes per row of the tileset
+	uint64_t hash;
+	int tileset, column, row;
+} tile_source_t;
+
+/**
+ * Checks whether a block of rgba8 pixels is fully transparent, scanning rows 16 bytes (or 8 without
+ * SSE2) at a time & stopping at the first opaque pixel
+ * @param pixels	Top left pixel
+ * @param stride	Bytes per row
+ * @param width		Width in pixels (even)
+ * @param height	Height in pixels
+ */
+bool pixels_transparent(const uint8_t* pixels, size_t stride, int width, int height) {
+	const size_t row_bytes = (size_t)width * 4;
+	for (int y = 0; y < height; ++y, pixels += stride) {
+		size_t i = 0;
+#ifdef HAS_SSE2
+		const __m128i alpha_mask = _mm_set1_epi32((int)0xff000000u);
+		__m128i alpha = _mm_setzero_si128();
+		for (; i + 16 <= row_bytes; i += 16) {
+			alpha = _mm_or_si128(alpha, _mm_and_si128(_mm_loadu_si128((const __m128i*)(pixels + i)), alpha_mask));
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(alpha, _mm_setzero_si128())) != 0xffff) {
+			return false;
+		}
+#endif
+		uint64_t alpha_bits = 0;
+		for (; i + 8 <= row_bytes; i += 8) {
+			uint64_t v;
+			memcpy(&v, pixels + i, sizeof v);
+			alpha_bits |= v;
+		}
+		// alpha is the last byte of each little-endian pixel
+		if (alpha_bits & 0xff000000ff000000ull) {
+			return false;
+		}
+	}
+	return true;
+}
+
+uint64_t pixels_hash(const uint8_t* pixels, size_t stride, int width, int height) {
+	uint64_t h = 0;
+	for (int y = 0; y < height; ++y, pixels += stride) {
+		h = hash_bytes(h, pixels, (size_t)width * 4);
+	}
+	return h;
+}
+
+bool pixels_equal(const uint8_t* a, size_t a_stride, const uint8_t* b, size_t b_stride, int width, int height) {
+	for (int y = 0; y < height; ++y, a += a_stride, b += b_stride) {
+		if (memcmp(a, b, (size_t)width * 4) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+typedef enum atlas_kind {
+	ATLAS_SPRITES = 0,
+	ATLAS_TILES,
+	ATLAS_KIND_COUNT
+} atlas_kind_t;
+
+// an atlas, split over as many equally sized pages as its contents need
+typedef struct atlas_pages {
+	Image pages[ATLAS_MAX_PAGES];
+	int page_count;
+} atlas_pages_t;
+
+typedef struct atlas_set {
+	atlas_pages_t atlases[ATLAS_KIND_COUNT];
+	mapped_file_t cache;	// holds the atlas pixels when loaded from the cache
+} atlas_set_t;
+
+// startup time spent on each stage of getting the atlases ready, in seconds
+typedef struct atlas_timings {
+	double hash;	// hashing the sources
+	double cache;	// loading the cache (on a hit) or writing it (on a miss)
+	double decode;	// decoding images & .dat files
+	double pack;	// packing rectangles & copying pixels into the atlases
+	double upload;	// uploading the atlases to the gpu
+	bool cache_hit;
+} atlas_timings_t;
+
+// decoded atlas sources, filled in by the decode workers
+typedef struct atlas_sources {
+	sprite_source_t sprites[sizeof(atlas_sprites) / sizeof(atlas_sprites[0])];
+	Image tilesets[sizeof(atlas_tilesets) / sizeof(atlas_tilesets[0])];
+} atlas_sources_t;
+
+typedef struct atlas_cache_header {
+	char magic[4];
+	uint32_t version;
+	uint64_t source_hash;
+	uint32_t sprite_count;
+	uint32_t tile_slot_count;
+	struct {
+		uint32_t width, height;
+		uint32_t page_count;
+		uint32_t reserved;
+		uint64_t offsets[ATLAS_MAX_PAGES];	// rgba8 pixels of each page, LEVEL_FILE_ALIGNMENT aligned
+	} atlases[ATLAS_KIND_COUNT];
+} atlas_cache_header_t;
+
+// followed by frame_count frames ({ x, y, page }) & order_count order indices, all int32
+typedef struct atlas_cache_sprite {
+	int32_t width, height;
+	int32_t frame_count, order_count;
+} atlas_cache_sprite_t;
+
+// after the sprites come the tilesets, each followed by columns * rows slot indices, and then
+// tile_slot_count tile slots ({ x, y, page }), all int32
+typedef struct atlas_cache_tileset {
+	int32_t columns, rows;
+} atlas_cache_tileset_t;
+
+/**
+ * Folds a file's contents into a running hash. Missing files hash differently from empty ones
+ */
+uint64_t atlas_hash_file(uint64_t h, const char* path) {
+	h = hash_bytes(h, path, strlen(path));
+	mapped_file_t file;
+	if (!mapped_file_open(path, &file)) {
+		return hash_combine(h, 0);
+	}
+	h = hash_bytes(hash_combine(h, 1), file.data, file.size);
+	mapped_file_close(&file);
+	return h;
+}
+
+/**
+ * Hashes every source the atlases are built from, along with the layout they're built to
+ * @return Hash of the atlas sources
+ */
+uint64_t atlas_source_hash(void) {
+	uint64_t h = hash_combine(ATLAS_CACHE_VERSION, ((uint64_t)TEXTURE_ATLAS_WIDTH << 48) | ((uint64_t)TEXTURE_ATLAS_HEIGHT << 32) | (TILE_ATLAS_WIDTH << 16) | TILE_ATLAS_HEIGHT);
+	char indexed_loc[MAX_PATH_LEN], path[MAX_PATH_LEN + sizeof(SPRITES_PATH "/.png")];	// room for the longest indexed location
+	for (int i = 0; i < sizeof(atlas_sprites) / sizeof(atlas_sprites[0]); ++i) {
+		path_index(atlas_sprites[i].res_loc, indexed_loc);
+		snprintf(path, sizeof path, SPRITES_PATH "/%s.png", indexed_loc);
+		h = atlas_hash_file(h, path);
+		snprintf(path, sizeof path, SPRITES_PATH "/%s.dat", indexed_loc);
+		h = atlas_hash_file(h, path);
+	}
+	for (int i = 0; i < sizeof(atlas_tilesets) / sizeof(atlas_tilesets[0]); ++i) {
+		snprintf(path, sizeof path, TILES_PATH "/%s.png", atlas_tilesets[i]);
+		h = atlas_hash_file(h, path);
+	}
+	return h;
+}
+
+/**
+ * Decodes a single atlas source; sprites first, then tilesets
+ */
+void atlas_decode_job(void* context, int index) {
+	atlas_sources_t* sources = context;
+	const int sprite_count = sizeof(atlas_sprites) / sizeof(atlas_sprites[0]);
+	if (index < sprite_count) {
+		sprite_decode(atlas_sprites[index].res_loc, &sources->sprites[index]);
+	}
+	else {
+		char path[MAX_PATH_LEN];
+		snprintf(path, sizeof path, TILES_PATH "/%s.png", atlas_tilesets[index - sprite_count]);
+		Image* tileset = &sources->tilesets[index - sprite_count];
+		*tileset = LoadImage(path);
+		if (tileset->data != NULL && tileset->format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) {
+			ImageFormat(tileset, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+		}
+	}
+}
+
+/**
+ * Packs rectangles onto atlas pages. All of the rectangles go to the packer at once, so it can sort
+ * them by size, and whatever doesn't fit spills onto a new page
+ * @param atlas		Atlas to add the pages to (empty, transparent pages are created as needed)
+ * @param rects		Rectangles to pack. Their positions are filled in
+ * @param pages		Filled in with the page of each rectangle (-1 if it can't fit on any page)
+ * @param count		Number of rectangles
+ * @param width		Width of a page
+ * @param height	Height of a page
+ * @return Number of rectangles that couldn't be packed
+ */
+int atlas_pack_pages(atlas_pages_t* atlas, stbrp_rect* rects, int* pages, int count, int width, int height) {
+	// nodes >= width keeps the packer exact
+	stbrp_node* nodes = malloc(sizeof(stbrp_node) * width);
+	stbrp_rect* remaining = malloc(sizeof(stbrp_rect) * MAX(count, 1));
+	for (int i = 0; i < count; ++i) {
+		rects[i].id = i;
+		rects[i].was_packed = 0;
+		pages[i] = -1;
+	}
+
+	int remaining_count = count;
+	memcpy(remaining, rects, sizeof(stbrp_rect) * count);
+	while (remaining_count > 0 && atlas->page_count < ATLAS_MAX_PAGES) {
+		stbrp_context rect_packer;
+		stbrp_init_target(&rect_packer, width, height, nodes, width);
+		stbrp_pack_rects(&rect_packer, remaining, remaining_count);
+
+		int page = atlas->page_count, still_remaining = 0;
+		for (int i = 0; i < remaining_count; ++i) {
+			if (remaining[i].was_packed) {
+				rects[remaining[i].id] = remaining[i];
+				pages[remaining[i].id] = page;
+			}
+			else {
+				remaining[still_remaining++] = remaining[i];
+			}
+		}
+		if (still_remaining == remaining_count) {
+			break;	// nothing left fits on an empty page
+		}
+		atlas->pages[atlas->page_count++] = GenImageColor(width, height, (Color) { 255, 255, 255, 0 });
+		remaining_count = still_remaining;
+	}
+
+	free(remaining);
+	free(nodes);
+	return remaining_count;
+}
+
+/**
+ * Builds the atlases from their sources. Every sprite & tileset is decoded in parallel first. Then all
+ * frame & tile rectangles are collected and packed together on the calling thread, so the layout
+ * doesn't depend on the thread count
+ * @param atlases		Atlases to build
+ * @param thread_count	Threads to decode with
+ * @param timings		Timings to fill in the decode & pack times of
+ */
+void atlas_build(atlas_set_t* atlases, int thread_count, atlas_timings_t* timings) {
+	*atlases = (atlas_set_t) { 0 };
+	tile_atlas_free();
+	double start = time_now();
+	atlas_sources_t* sources = calloc(1, sizeof(atlas_sources_t));
+	parallel_for(sizeof(atlas_sprites) / sizeof(atlas_sprites[0]) + sizeof(atlas_tilesets) / sizeof(atlas_tilesets[0]), thread_count, atlas_decode_job, sources);
+	timings->decode = time_now() - start;
+
+	start = time_now();
+	{
+		// collect every frame of every sprite
+		const int sprite_count = sizeof(atlas_sprites) / sizeof(atlas_sprites[0]);
+		int rect_count = 0;
+		for (int i = 0; i < sprite_count; ++i) {
+			rect_count += sprite_layout(atlas_sprites[i].res_loc, atlas_sprites[i].sprite, &sources->sprites[i]);
+		}
+		stbrp_rect* rects = malloc(sizeof(stbrp_rect) * MAX(rect_count, 1));
+		int* pages = malloc(sizeof(int) * MAX(rect_count, 1));
+		for (int i = 0, r = 0; i < sprite_count; ++i) {
+			const sprite_t* sprite = atlas_sprites[i].sprite;
+			for (int j = 0; j < sprite->frame_count; ++j, ++r) {
+				rects[r] = (stbrp_rect) { .w = sprite->width, .h = sprite->height };
+			}
+		}
+
+		atlas_pages_t* atlas = &atlases->atlases[ATLAS_SPRITES];
+		int failed = atlas_pack_pages(atlas, rects, pages, rect_count, TEXTURE_ATLAS_WIDTH, TEXTURE_ATLAS_HEIGHT);
+		if (failed > 0) {
+			printd("[%d] sprite frames don't fit in the sprite atlas, and won't be drawn\n", failed);
+		}
+
+		for (int i = 0, r = 0; i < sprite_count; ++i) {
+			sprite_t* sprite = atlas_sprites[i].sprite;
+			Image img = sources->sprites[i].img;
+			for (int j = 0; j < sprite->frame_count; ++j, ++r) {
+				sprite->frames[j] = (sprite_frame_t) { rects[r].x, rects[r].y, pages[r] };
+				if (pages[r] >= 0) {
+					ImageDraw(&atlas->pages[pages[r]], img, (Rectangle) { 0, j * sprite->height, sprite->width, sprite->height }, (Rectangle) { rects[r].x, rects[r].y, sprite->width, sprite->height }, WHITE);
+				}
+			}
+			UnloadImage(img);
+		}
+		free(rects);
+		free(pages);
+	}
+	{
+		// collect every distinct non-empty tile of every tileset. a tile's slot is the index of the
+		// first tile with the same pixels
+		const int tile_size = DEFAULT_TILE_SIZE;
+		const int tileset_count = sizeof(atlas_tilesets) / sizeof(atlas_tilesets[0]);
+		int max_tiles = 0;
+		for (int t = 0; t < tileset_count; ++t) {
+			max_tiles += (sources->tilesets[t].width / tile_size) * (sources->tilesets[t].height / tile_size);
+		}
+		stbrp_rect* rects = malloc(sizeof(stbrp_rect) * MAX(max_tiles, 1));
+		int* pages = malloc(sizeof(int) * MAX(max_tiles, 1));
+		tile_source_t* tile_sources = malloc(sizeof(tile_source_t) * MAX(max_tiles, 1));
+
+		// open addressed table of slot + 1, keyed by pixel hash
+		int table_size = 64;
+		while (table_size < max_tiles * 2) {
+			table_size *= 2;
+		}
+		int* table = calloc(table_size, sizeof(int));
+
+		int slot_count = 0, tile_count = 0;
+		for (int t = 0; t < tileset_count; ++t) {
+			Image tls = sources->tilesets[t];
+			tileset_t* tileset = &tile_atlas.tilesets[t];
+			*tileset = (tileset_t) { .columns = tls.width / tile_size, .rows = tls.height / tile_size };
+			tileset->slots = malloc(sizeof(int) * MAX(tileset->columns * tileset->rows, 1));
+			const size_t stride = (size_t)tls.width * 4;
+			for (int j = 0; j < tileset->rows; ++j) {
+				for (int i = 0; i < tileset->columns; ++i) {
+					const uint8_t* pixels = (const uint8_t*)tls.data + (size_t)j * tile_size * stride + (size_t)i * tile_size * 4;
+					int* slot = &tileset->slots[j * tileset->columns + i];
+					*slot = -1;
+					if (pixels_transparent(pixels, stride, tile_size, tile_size)) {
+						continue;
+					}
+					++tile_count;
+
+					tile_source_t tile = { pixels, stride, pixels_hash(pixels, stride, tile_size, tile_size), t, i, j };
+					int bucket = tile.hash & (table_size - 1);
+					for (; table[bucket] != 0; bucket = (bucket + 1) & (table_size - 1)) {
+						const tile_source_t* other = &tile_sources[table[bucket] - 1];
+						if (other->hash == tile.hash && pixels_equal(other->pixels, other->stride, pixels, stride, tile_size, tile_size)) {
+							*slot = table[bucket] - 1;
+							break;
+						}
+					}
+					if (*slot < 0) {
+						*slot = slot_count;
+						tile_sources[slot_count] = tile;
+						rects[slot_count++] = (stbrp_rect) { .w = tile_size, .h = tile_size };
+						table[bucket] = slot_count;
+					}
+				}
+			}
+		}
+		free(table);
+
+		atlas_pages_t* atlas = &atlases->atlases[ATLAS_TILES];
+		int failed = atlas_pack_pages(atlas, rects, pages, slot_count, TILE_ATLAS_WIDTH, TILE_ATLAS_HEIGHT);
+		if (failed > 0) {
+			printd("[%d] tiles don't fit in the tile atlas, and won't be drawn\n", failed);
+		}
+		tile_atlas.slots = malloc(sizeof(tile_slot_t) * MAX(slot_count, 1));
+		tile_atlas.slot_count = slot_count;
+		for (int s = 0; s < slot_count; ++s) {
+			const tile_source_t* tile = &tile_sources[s];
+			tile_atlas.slots[s] = (tile_slot_t) { rects[s].x, rects[s].y, pages[s] };
+			if (pages[s] >= 0) {
+				ImageDraw(&atlas->pages[pages[s]], sources->tilesets[tile->tileset], (Rectangle) { tile->column * tile_size, tile->row * tile_size, tile_size, tile_size }, (Rectangle) { rects[s].x, rects[s].y, tile_size, tile_size }, WHITE);
+			}
+		}
+		printd("Packed [%d] distinct tiles out of [%d] non-empty tiles\n", slot_count, tile_count);
+
+		for (int t = 0; t < tileset_count; ++t) {
+			UnloadImage(sources->tilesets[t]);
+		}
+		free(rects);
+		free(pages);
+		free(tile_sources);
+	}
+	free(sources);
+	timings->pack = time_now() - start;
+}
+
+/**
+ * Writes built atlases & the sprite tables to the atlas cache
+ * @param path			Path of the cache file
+ * @param source_hash	Hash of the sources the atlases were built from
+ * @param atlases		Atlases to write
+ * @return Whether the cache could be written
+ */
+bool atlas_cache_save(const char* path, uint64_t source_hash, const atlas_set_t* atlases) {
+	FILE* file = fopen(path, "wb");
+	if (file == NULL) {
+		printd("Could not open atlas cache [%s] for writing\n", path);
+		return false;
+	}
+
+	atlas_cache_header_t header = {
+		.magic = ATLAS_CACHE_MAGIC,
+		.version = ATLAS_CACHE_VERSION,
+		.source_hash = source_hash,
+		.sprite_count = sizeof(atlas_sprites) / sizeof(atlas_sprites[0]),
+		.tile_slot_count = tile_atlas.slot_count
+	};
+	const int atlas_sizes[ATLAS_KIND_COUNT][2] = {
+		{ TEXTURE_ATLAS_WIDTH, TEXTURE_ATLAS_HEIGHT },
+		{ TILE_ATLAS_WIDTH, TILE_ATLAS_HEIGHT }
+	};
+	for (int k = 0; k < ATLAS_KIND_COUNT; ++k) {
+		header.atlases[k].width = atlas_sizes[k][0];
+		header.atlases[k].height = atlas_sizes[k][1];
+		header.atlases[k].page_count = atlases->atlases[k].page_count;
+	}
+	bool ok = fwrite(&header, sizeof header, 1, file) == 1;
+	for (int i = 0; i < header.sprite_count && ok; ++i) {
+		const sprite_t* sprite = atlas_sprites[i].sprite;
+		atlas_cache_sprite_t record = { sprite->width, sprite->height, sprite->frame_count, sprite->order_count };
+		ok = fwrite(&record, sizeof record, 1, file) == 1;
+		for (int j = 0; j < sprite->frame_count && ok; ++j) {
+			int32_t frame[3] = { sprite->frames[j].x, sprite->frames[j].y, sprite->frames[j].page };
+			ok = fwrite(frame, sizeof frame, 1, file) == 1;
+		}
+		for (int j = 0; j < sprite->order_count && ok; ++j) {
+			int32_t order = sprite->order[j];
+			ok = fwrite(&order, sizeof order, 1, file) == 1;
+		}
+	}
+	for (int i = 0; i < sizeof(atlas_tilesets) / sizeof(atlas_tilesets[0]) && ok; ++i) {
+		const tileset_t* tileset = &tile_atlas.tilesets[i];
+		atlas_cache_tileset_t record = { tileset->columns, tileset->rows };
+		ok = fwrite(&record, sizeof record, 1, file) == 1;
+		for (int j = 0; j < tileset->columns * tileset->rows && ok; ++j) {
+			int32_t slot = tileset->slots[j];
+			ok = fwrite(&slot, sizeof slot, 1, file) == 1;
+		}
+	}
+	for (int i = 0; i < tile_atlas.slot_count && ok; ++i) {
+		int32_t slot[3] = { tile_atlas.slots[i].x, tile_atlas.slots[i].y, tile_atlas.slots[i].page };
+		ok = fwrite(slot, sizeof slot, 1, file) == 1;
+	}
+
+	// pixels go last, aligned, so they can be uploaded straight from the mapping
+	static const uint8_t padding[LEVEL_FILE_ALIGNMENT] = { 0 };
+	for (int k = 0; k < ATLAS_KIND_COUNT && ok; ++k) {
+		for (int p = 0; p < header.atlases[k].page_count && ok; ++p) {
+			const Image* page = &atlases->atlases[k].pages[p];
+			uint64_t offset = ftell(file);
+			uint64_t aligned = (offset + LEVEL_FILE_ALIGNMENT - 1) & ~(uint64_t)(LEVEL_FILE_ALIGNMENT - 1);
+			size_t size = (size_t)page->width * page->height * 4;
+			ok = fwrite(padding, 1, aligned - offset, file) == aligned - offset && fwrite(page->data, 1, size, file) == size;
+			header.atlases[k].offsets[p] = aligned;
+		}
+	}
+
+	// the header is only complete once the pixel offsets are known
+	ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof header, 1, file) == 1;
+	fclose(file);
+	if (!ok) {
+		remove(path);
+	}
+	return ok;
+}
+
+/**
+ * Loads the atlases & sprite tables from the atlas cache, if it was built from the current sources
+ * @param path			Path of the cache file
+ * @param source_hash	Hash of the current atlas sources
+ * @param atlases		Atlases to load. Their pixels point into the cache file's mapping
+ * @return Whether the cache could be used
+ */
+bool atlas_cache_load(const char* path, uint64_t source_hash, atlas_set_t* atlases) {
+	*atlases = (atlas_set_t) { 0 };
+	mapped_file_t file;
+	if (!mapped_file_open(path, &file)) {
+		return false;
+	}
+	const atlas_cache_header_t* header = file.data;
+	const int sprite_count = sizeof(atlas_sprites) / sizeof(atlas_sprites[0]);
+	bool valid = file.size >= sizeof *header && memcmp(header->magic, ATLAS_CACHE_MAGIC, 4) == 0 && header->version == ATLAS_CACHE_VERSION &&
+		header->source_hash == source_hash && header->sprite_count == sprite_count;
+
+	// the sprite tables end where the first page starts
+	size_t end = file.size;
+	for (int k = 0; k < ATLAS_KIND_COUNT && valid; ++k) {
+		// page sizes are checked against the file first, so the byte count can't wrap
+		uint64_t page_pixels = (uint64_t)header->atlases[k].width * header->atlases[k].height;
+		valid = header->atlases[k].page_count <= ATLAS_MAX_PAGES && header->atlases[k].width <= INT_MAX && header->atlases[k].height <= INT_MAX &&
+			page_pixels <= file.size / 4;
+		for (int p = 0; p < header->atlases[k].page_count && valid; ++p) {
+			valid = header->atlases[k].offsets[p] <= file.size && page_pixels * 4 <= file.size - header->atlases[k].offsets[p];
+			end = MIN(end, header->atlases[k].offsets[p]);
+		}
+	}
+	if (!valid) {
+		mapped_file_close(&file);
+		return false;
+	}
+
+	// sprite tables, checked against the end of the tables so a truncated cache can't be read past
+	const uint8_t* base = file.data;
+	size_t offset = sizeof *header;
+	sprite_t* sprites = calloc(sprite_count, sizeof(sprite_t));
+	for (int i = 0; i < sprite_count && valid; ++i) {
+		atlas_cache_sprite_t record;
+		valid = offset + sizeof record <= end;
+		if (!valid) {
+			break;
+		}
+		memcpy(&record, base + offset, sizeof record);
+		offset += sizeof record;
+		size_t tables_size = ((size_t)record.frame_count * 3 + record.order_count) * sizeof(int32_t);
+		valid = record.frame_count >= 0 && record.order_count >= 0 && offset + tables_size <= end;
+		if (!valid) {
+			break;
+		}
+
+		sprite_t* sprite = &sprites[i];
+		*sprite = (sprite_t) { .width = record.width, .height = record.height, .frame_count = record.frame_count, .order_count = record.order_count };
+		if (record.frame_count > 0) {
+			sprite->frames = malloc(record.frame_count * sizeof(sprite_frame_t));
+			for (int j = 0; j < record.frame_count; ++j, offset += 3 * sizeof(int32_t)) {
+				int32_t frame[3];
+				memcpy(frame, base + offset, sizeof frame);
+				sprite->frames[j] = (sprite_frame_t) { frame[0], frame[1], frame[2] };
+			}
+		}
+		if (record.order_count > 0) {
+			sprite->order = malloc(record.order_count * sizeof(int));
+			for (int j = 0; j < record.order_count; ++j, offset += sizeof(int32_t)) {
+				int32_t order;
+				memcpy(&order, base + offset, sizeof order);
+				sprite->order[j] = order;
+			}
+		}
+	}
+
+	// tilesets & tile slots
+	const int tileset_count = sizeof(atlas_tilesets) / sizeof(atlas_tilesets[0]);
+	struct tile_atlas tiles = { .slot_count = valid ? header->tile_slot_count : 0 };
+	for (int i = 0; i < tileset_count && valid; ++i) {
+		atlas_cache_tileset_t record;
+		valid = offset + sizeof record <= end;
+		if (!valid) {
+			break;
+		}
+		memcpy(&record, base + offset, sizeof record);
+		offset += sizeof record;
+		valid = record.columns >= 0 && record.rows >= 0 && offset + (size_t)record.columns * record.rows * sizeof(int32_t) <= end;
+		if (!valid) {
+			break;
+		}
+		tileset_t* tileset = &tiles.tilesets[i];
+		*tileset = (tileset_t) { .columns = record.columns, .rows = record.rows };
+		tileset->slots = malloc(sizeof(int) * MAX(record.columns * record.rows, 1));
+		for (int j = 0; j < record.columns * record.rows; ++j, offset += sizeof(int32_t)) {
+			int32_t slot;
+			memcpy(&slot, base + offset, sizeof slot);
+			tileset->slots[j] = slot;
+			valid = valid && slot >= -1 && slot < (int32_t)tiles.slot_count;
+		}
+	}
+	if (valid) {
+		valid = offset + (size_t)tiles.slot_count * 3 * sizeof(int32_t) <= end;
+	}
+	if (valid) {
+		tiles.slots = malloc(sizeof(tile_slot_t) * MAX(tiles.slot_count, 1));
+		for (int i = 0; i < tiles.slot_count; ++i, offset += 3 * sizeof(int32_t)) {
+			int32_t slot[3];
+			memcpy(slot, base + offset, sizeof slot);
+			tiles.slots[i] = (tile_slot_t) { slot[0], slot[1], slot[2] };
+		}
+	}
+
+	if (!valid) {
+		for (int i = 0; i < sprite_count; ++i) {
+			sprite_free(&sprites[i]);
+		}
+		free(sprites);
+		for (int i = 0; i < tileset_count; ++i) {
+			free(tiles.tilesets[i].slots);
+		}
+		free(tiles.slots);
+		mapped_file_close(&file);
+		return false;
+	}
+	for (int i = 0; i < sprite_count; ++i) {
+		*atlas_sprites[i].sprite = sprites[i];
+	}
+	free(sprites);
+	tile_atlas_free();
+	tile_atlas = tiles;
+
+	for (int k = 0; k < ATLAS_KIND_COUNT; ++k) {
+		atlas_pages_t* atlas = &atlases->atlases[k];
+		atlas->page_count = header->atlases[k].page_count;
+		for (int p = 0; p < atlas->page_count; ++p) {
+			atlas->pages[p] = (Image) {
+				.data = (uint8_t*)file.data + header->atlases[k].offsets[p],
+				.width = header->atlases[k].width,
+				.height = header->atlases[k].height,
+				.mipmaps = 1,
+				.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8
+			};
+		}
+	}
+	atlases->cache = file;
+	return true;
+}
+
+/**
+ * Gets the atlases, from the atlas cache when it is up to date, otherwise by building them (and then
+ * updating the cache)
+ * @param atlases Atlases to load
+ * @param timings Timings to fill in (all but upload)
+ * @return Whether the atlases came from the cache
+ */
+bool atlas_load(atlas_set_t* atlases, atlas_timings_t* timings) {
+	*timings = (atlas_timings_t) { 0 };
+	double start = time_now();
+	uint64_t source_hash = atlas_source_hash();
+	timings->hash = time_now() - start;
+
+	start = time_now();
+	timings->cache_hit = atlas_cache_load(ATLAS_CACHE_PATH, source_hash, atlases);
+	timings->cache = time_now() - start;
+	if (timings->cache_hit) {
+		return true;
+	}
+
+	atlas_build(atlases, ASSET_DECODE_THREADS, timings);
+	start = time_now();
+	atlas_cache_save(ATLAS_CACHE_PATH, source_hash, atlases);
+	timings->cache = time_now() - start;
+	return false;
+}
+
+/**
+ * Frees atlas pixels, once they've been uploaded. Sprite tables are kept
+ * @param atlases Atlases to free
+ */
+void atlas_free(atlas_set_t* atlases) {
+	if (atlases->cache.data != NULL) {
+		mapped_file_close(&atlases->cache);
+	}
+	else {
+		for (int k = 0; k < ATLAS_KIND_COUNT; ++k) {
+			for (int p = 0; p < atlases->atlases[k].page_count; ++p) {
+				UnloadImage(atlases->atlases[k].pages[p]);
+			}
+		}
+	}
+	*atlases = (atlas_set_t) { 0 };
+}
+
+#pragma endregion
+
+#pragma region Physics & Collision
+
+struct physics_body {
+	float x, y;
+	float x_prev, y_prev;
+	int width, height;
+	float origin_x, origin_y;
+	float xspd, yspd;
+	float xspd_max, yspd_max;
+	float grav;
+	bool grounded;
+};
+
+/**
+ * Initializes a physics body with default values
+ * @param body		Physics body to initialize
+ * @param width		Width of the physics body
+ * @param height	Height of the physics body
+ */
+void physics_body_init(physics_body_t* body, int width, int height) {
+	*body = (physics_body_t) {
+		.width = width,
+		.height = height,
+		.origin_x = 0.5f,
+		.origin_y = 1.0f,
+		.xspd_max = 5.0f,
+		.yspd_max = 5.0f,
+		.grav = 0.2f,
+	};
+}
+
+/**
+ * Resolves x-axis collisions on a physics body given a tilemap
+ * @param body 	Physics body to perform collisions on
+ * @return Rectangle that contains world space collision bounds
+ */
+Rectangle physics_body_get_rectangle(const physics_body_t* body) {
+	return (Rectangle) {
+		.x = body->x - body->width * body->origin_x,
+		.y = body->y - (body->height * body->origin_y),
+		.width = body->width,
+		.height = body->height
+	};
+}
+
+/**
+ * Gets the range of tiles that a span of world space strictly overlaps (touching edges don't count)
+ * @param begin		Start of the span
+ * @param length	Length of the span
+ * @param tile_size	Tile size
+ * @param first		First overlapped tile
+ * @param count		Number of overlapped tiles
+ */
+static inline void tile_span(float begin, float length, int tile_size, int* first, int* count) {
+	*first = (int)floorf(begin / tile_size);
+	*count = (int)ceilf((begin + length) / tile_size) - *first;
+}
+
+/**
+ * Gets the tile that a world space edge lies strictly inside of
+ * @param edge		Edge position
+ * @param tile_size	Tile size
+ * @param tile		Tile containing the edge
+ * @return False if the edge lies exactly on a tile boundary (so is inside of no tile)
+ */
+static inline bool tile_edge(float edge, int tile_size, int* tile) {
+	*tile = (int)floorf(edge / tile_size);
+	return *tile * (float)tile_size < edge;
+}
+
+/**
+ * Resolves x-axis collisions on a physics body given a tilemap
+ * @param body	Physics body to perform collisions on
+ * @param map	Tilemap to check for collisions from
+ */
+void resolve_collisions_x(physics_body_t* body, const tilemap_t* map) {
+	int tile_size = map->tile_size;
+	Rectangle body_rect = physics_body_get_rectangle(body);
+
+	// columns the left & right edges lie inside of, and the rows the body spans
+	int left, right, top, rows;
+	bool has_left = tile_edge(body_rect.x, tile_size, &left);
+	bool has_right = tile_edge(body_rect.x + body_rect.width, tile_size, &right);
+	tile_span(body_rect.y, body_rect.height, tile_size, &top, &rows);
+	if ((!has_left && !has_right) || rows <= 0) {
+		return;
+	}
+
+	// test each edge's column span 64 rows at a time, from the bottom up. the lowest row with a
+	// hit decides the push, with the right edge winning if both edges hit in that row
+	for (int piece = ((rows - 1) >> 6) << 6; piece >= 0; piece -= 64) {
+		int count = MIN(rows - piece, 64);
+		uint64_t left_hits = has_left ? tilemap_solid_column_span(map, left, top + piece, count) : 0;
+		uint64_t right_hits = has_right ? tilemap_solid_column_span(map, right, top + piece, count) : 0;
+		if ((left_hits | right_hits) == 0) {
+			continue;
+		}
+		int row_bit = bit_highest64(left_hits | right_hits);
+		if ((right_hits >> row_bit) & 1) {
+			body->x = right * (float)tile_size - body_rect.width + (body->width * body->origin_x);
+		}
+		else {
+			body->x = left * (float)tile_size + tile_size + (body->width * body->origin_x);
+		}
+		body->xspd = 0;
+		return;
+	}
+}
+
+/**
+ * Resolves y-axis collisions on a physics body given a tilemap
+ * @param body 	Physics body to perform collisions on
+ * @param map	Tilemap to check for collisions from
+ * @return Whether the body bumped into a ceiling
+ */
+bool resolve_collisions_y(physics_body_t* body, const tilemap_t* map) {
+	body->grounded = false;
+	int tile_size = map->tile_size;
+	Rectangle body_rect = physics_body_get_rectangle(body);
+
+	// rows the top & bottom edges lie inside of, and the columns the body spans
+	int top, bottom, left, columns;
+	bool has_top = tile_edge(body_rect.y, tile_size, &top);
+	bool has_bottom = tile_edge(body_rect.y + body_rect.height, tile_size, &bottom);
+	tile_span(body_rect.x, body_rect.width, tile_size, &left, &columns);
+	if ((!has_top && !has_bottom) || columns <= 0) {
+		return false;
+	}
+
+	// test each edge's row span 64 columns at a time, from the left. the leftmost column with a
+	// hit decides, with ceilings winning over floors in the same column
+	for (int piece = 0; piece < columns; piece += 64) {
+		int count = MIN(columns - piece, 64);
+		uint64_t ceiling_hits = has_top ? tilemap_row_span(map, map->solid_rows, top, left + piece, count) : 0;
+		uint64_t floor_hits = has_bottom ?
+			tilemap_row_span(map, map->solid_rows, bottom, left + piece, count) | tilemap_row_span(map, map->platform_rows, bottom, left + piece, count) : 0;
+		if ((ceiling_hits | floor_hits) == 0) {
+			continue;
+		}
+		int column_bit = bit_ctz64(ceiling_hits | floor_hits);
+		if ((ceiling_hits >> column_bit) & 1) {
+			body->y = top * (float)tile_size + tile_size + (body->height * body->origin_y);
+			body->yspd = 0;
+			return true;
+		}
+		body->y = bottom * (float)tile_size;
+		body->yspd = 0;
+		body->grounded = true;
+		return false;
+	}
+	return false;
+}
+
+/**
+ * Checks whether any tile of a column span is solid, however many rows it spans
+ */
+static inline bool tilemap_column_blocked(const tilemap_t* map, int x, int y, int count) {
+	for (int piece = 0; piece < count; piece += 64) {
+		if (tilemap_solid_column_span(map, x, y + piece, MIN(count - piece, 64))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Checks whether any tile of a row span is set in a bitplane, however many columns it spans
+ */
+static inline bool tilemap_row_blocked(const tilemap_t* map, const uint64_t* plane, int y, int x, int count) {
+	for (int piece = 0; piece < count; piece += 64) {
+		if (tilemap_row_span(map, plane, y, x + piece, MIN(count - piece, 64))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Sweeps the leading edge of a body that moved along x (from x_prev) across the columns it entered,
+ * stopping it against the first solid one, so that fast bodies can't tunnel through walls (or end up
+ * inside of one and get pushed out the far side). Whatever else the body overlaps is left to
+ * resolve_collisions_x. Bodies that moved less than a tile and less than their own width can do
+ * neither, so they're left to resolve_collisions_x entirely. Otherwise one column is tested per tile
+ * boundary crossed, so the cost grows with speed
+ * @param body	Physics body that has moved
+ * @param map	Tilemap to check for collisions from
+ * @return Whether the body was stopped
+ */
+bool sweep_collisions_x(physics_body_t* body, const tilemap_t* map) {
+	int tile_size = map->tile_size;
+	float moved = body->x - body->x_prev;
+	if (fabsf(moved) < MIN(body->width, tile_size)) {
+		return false;
+	}
+	Rectangle body_rect = physics_body_get_rectangle(body);
+	float left_prev = body->x_prev - body->width * body->origin_x;
+
+	// columns entered by the right edge going right, or by the left edge going left
+	int step = (moved > 0.0f) ? 1 : -1;
+	int first = (step > 0) ? -floor_to_int(-(left_prev + body_rect.width) / tile_size) : floor_to_int(left_prev / tile_size) - 1;
+	int last = (step > 0) ? -floor_to_int(-(body_rect.x + body_rect.width) / tile_size) - 1 : floor_to_int(body_rect.x / tile_size);
+	int top, rows;
+	if ((last - first) * step < 0 || (tile_span(body_rect.y, body_rect.height, tile_size, &top, &rows), rows <= 0)) {
+		return false;
+	}
+	for (int column = first; (last - column) * step >= 0; column += step) {
+		if (tilemap_column_blocked(map, column, top, rows)) {
+			body->x = (step > 0) ?
+				column * (float)tile_size - body_rect.width + (body->width * body->origin_x) :
+				column * (float)tile_size + tile_size + (body->width * body->origin_x);
+			body->xspd = 0;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Same as sweep_collisions_x, along y (from y_prev): the top edge is stopped by solid rows going up,
+ * and the bottom edge by solid or platform rows going down, grounding the body
+ * @param body		Physics body that has moved
+ * @param map		Tilemap to check for collisions from
+ * @param bumped	Set to whether the body bumped into a ceiling
+ * @return Whether the body was stopped
+ */
+bool sweep_collisions_y(physics_body_t* body, const tilemap_t* map, bool* bumped) {
+	*bumped = false;
+	int tile_size = map->tile_size;
+	float moved = body->y - body->y_prev;
+	if (fabsf(moved) < MIN(body->height, tile_size)) {
+		return false;
+	}
+	Rectangle body_rect = physics_body_get_rectangle(body);
+	float top_prev = body->y_prev - (body->height * body->origin_y);
+
+	int step = (moved > 0.0f) ? 1 : -1;
+	int first = (step > 0) ? -floor_to_int(-(top_prev + body_rect.height) / tile_size) : floor_to_int(top_prev / tile_size) - 1;
+	int last = (step > 0) ? -floor_to_int(-(body_rect.y + body_rect.height) / tile_size) - 1 : floor_to_int(body_rect.y / tile_size);
+	int left, columns;
+	if ((last - first) * step < 0 || (tile_span(body_rect.x, body_rect.width, tile_size, &left, &columns), columns <= 0)) {
+		return false;
+	}
+	for (int row = first; (last - row) * step >= 0; row += step) {
+		if (step < 0 && tilemap_row_blocked(map, map->solid_rows, row, left, columns)) {
+			body->y = row * (float)tile_size + tile_size + (body->height * body->origin_y);
+			body->yspd = 0;
+			body->grounded = false;
+			*bumped = true;
+			return true;
+		}
+		if (step > 0 && (tilemap_row_blocked(map, map->solid_rows, row, left, columns) || tilemap_row_blocked(map, map->platform_rows, row, left, columns))) {
+			body->y = row * (float)tile_size;
+			body->yspd = 0;
+			body->grounded = true;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Moves a body along x by its speed, colliding with the tiles on the way
+ */
+void physics_body_move_x(physics_body_t* body, const tilemap_t* map) {
+	body->x += body->xspd;
+	if (!sweep_collisions_x(body, map)) {
+		resolve_collisions_x(body, map);
+	}
+}
+
+/**
+ * Moves a body along y by its speed, colliding with the tiles on the way
+ * @return Whether the body bumped into a ceiling
+ */
+bool physics_body_move_y(physics_body_t* body, const tilemap_t* map) {
+	body->y += body->yspd;
+	bool bumped;
+	if (sweep_collisions_y(body, map, &bumped)) {
+		return bumped;
+	}
+	return resolve_collisions_y(body, map);
+}
+
+void physics_body_update(physics_body_t* body, const tilemap_t* tilemap) {
+	// last tick's position, for render interpolation
+	body->x_prev = body->x;
+	body->y_prev = body->y;
+
+	// adjust speeds
+	body->yspd += body->grav;
+	body->yspd = MIN(body->yspd, body->yspd_max);
+	if (body->grounded) body->xspd = CLAMP(body->xspd, -body->xspd_max, body->xspd_max);
+	
+	// move & collide
+	physics_body_move_x(body, tilemap);
+	if (physics_body_move_y(body, tilemap)) {
+		sound_play(SOUND_BUMP);
+	}
+}
+
+/*
+ * Bodies that are updated in bulk (entities, see Entity) are kept as parallel arrays instead. Their
+ * integration steps four bodies at a time with SSE2 intrinsics where HAS_SSE2 is set, with a scalar
+ * loop for the remainder (and for everything without SSE2), and only bodies overlapping a chunk that
+ * holds any collision go on to tile collision resolution. The results are identical to running
+ * physics_body_update on each body.
+ */
+#define PHYSICS_BODY_FIELDS(X) \
+	X(float, x) X(float, y) X(float, x_prev) X(float, y_prev) X(int, width) X(int, height) \
+	X(float, origin_x) X(float, origin_y) X(float, xspd) X(float, yspd) X(float, xspd_max) X(float, yspd_max) \
+	X(float, grav) X(int32_t, grounded)	// grounded is as wide as the floats, so it can be used as a lane mask
+
+typedef struct physics_bodies {
+#define PHYSICS_BODY_ARRAY(type, name) type* name;
+	PHYSICS_BODY_FIELDS(PHYSICS_BODY_ARRAY)
+#undef PHYSICS_BODY_ARRAY
+	bool* bumped;	// set by physics_bodies_update for the bodies that hit a ceiling
+	int capacity;
+} physics_bodies_t;
+
+bool physics_bodies_reserve(physics_bodies_t* bodies, int capacity) {
+	if (capacity <= bodies->capacity) {
+		return true;
+	}
+#define PHYSICS_BODY_GROW(type, name) { \
+		type* grown = realloc(bodies->name, capacity * sizeof(type)); \
+		if (grown == NULL) return false; \
+		bodies->name = grown; \
+	}
+	PHYSICS_BODY_FIELDS(PHYSICS_BODY_GROW)
+	PHYSICS_BODY_GROW(bool, bumped)
+#undef PHYSICS_BODY_GROW
+	bodies->capacity = capacity;
+	return true;
+}
+
+void physics_bodies_free(physics_bodies_t* bodies) {
+#define PHYSICS_BODY_FREE(type, name) free(bodies->name);
+	PHYSICS_BODY_FIELDS(PHYSICS_BODY_FREE)
+	free(bodies->bumped);
+#undef PHYSICS_BODY_FREE
+	*bodies = (physics_bodies_t) { 0 };
+}
+
+physics_body_t physics_bodies_get(const physics_bodies_t* bodies, int i) {
+	physics_body_t body;
+#define PHYSICS_BODY_GET(type, name) body.name = bodies->name[i];
+	PHYSICS_BODY_FIELDS(PHYSICS_BODY_GET)
+#undef PHYSICS_BODY_GET
+	return body;
+}
+
+void physics_bodies_set(physics_bodies_t* bodies, int i, const physics_body_t* body) {
+#define PHYSICS_BODY_SET(type, name) bodies->name[i] = body->name;
+	PHYSICS_BODY_FIELDS(PHYSICS_BODY_SET)
+#undef PHYSICS_BODY_SET
+}
+
+/**
+ * Same as physics_body_get_rectangle, for one of a set of bodies
+ */
+Rectangle physics_bodies_get_rectangle(const physics_bodies_t* bodies, int i) {
+	return (Rectangle) {
+		.x = bodies->x[i] - bodies->width[i] * bodies->origin_x[i],
+		.y = bodies->y[i] - (bodies->height[i] * bodies->origin_y[i]),
+		.width = bodies->width[i],
+		.height = bodies->height[i]
+	};
+}
+
+void physics_bodies_move(physics_bodies_t* bodies, int to, int from) {
+#define PHYSICS_BODY_MOVE(type, name) bodies->name[to] = bodies->name[from];
+	PHYSICS_BODY_FIELDS(PHYSICS_BODY_MOVE)
+#undef PHYSICS_BODY_MOVE
+}
+
+/**
+ * Copies a range of bodies from one set to another
+ */
+void physics_bodies_copy(physics_bodies_t* to, const physics_bodies_t* from, int begin, int end) {
+#define PHYSICS_BODY_COPY(type, name) memcpy(to->name + begin, from->name + begin, (end - begin) * sizeof(type));
+	PHYSICS_BODY_FIELDS(PHYSICS_BODY_COPY)
+#undef PHYSICS_BODY_COPY
+}
+
+/**
+ * Gets a view of a set of bodies starting at an offset, for working on part of the set
+ */
+physics_bodies_t physics_bodies_offset(const physics_bodies_t* bodies, int offset) {
+	physics_bodies_t view = { .bumped = bodies->bumped + offset, .capacity = bodies->capacity - offset };
+#define PHYSICS_BODY_OFFSET(type, name) view.name = bodies->name + offset;
+	PHYSICS_BODY_FIELDS(PHYSICS_BODY_OFFSET)
+#undef PHYSICS_BODY_OFFSET
+	return view;
+}
+
+void physics_bodies_swap(physics_bodies_t* bodies, int a, int b) {
+#define PHYSICS_BODY_SWAP(type, name) { type swap = bodies->name[a]; bodies->name[a] = bodies->name[b]; bodies->name[b] = swap; }
+	PHYSICS_BODY_FIELDS(PHYSICS_BODY_SWAP)
+#undef PHYSICS_BODY_SWAP
+}
+
+/**
+ * Checks whether a body could touch any tile this update: whether any chunk under its rectangle,
+ * swept from before to after both moves, holds collision. Expects both moves to have been made
+ */
+static inline bool physics_bodies_near_tiles(const physics_bodies_t* bodies, int i, const tilemap_t* map, float chunks_per_px) {
+	float left = bodies->x_prev[i] - bodies->width[i] * bodies->origin_x[i];
+	float left_moved = bodies->x[i] - bodies->width[i] * bodies->origin_x[i];
+	float top = bodies->y_prev[i] - bodies->height[i] * bodies->origin_y[i];
+	float top_moved = bodies->y[i] - bodies->height[i] * bodies->origin_y[i];
+	int cx1 = floor_to_int(MIN(left, left_moved) * chunks_per_px);
+	int cx2 = floor_to_int((MAX(left, left_moved) + bodies->width[i]) * chunks_per_px);
+	int cy1 = floor_to_int(MIN(top, top_moved) * chunks_per_px);
+	int cy2 = floor_to_int((MAX(top, top_moved) + bodies->height[i]) * chunks_per_px);
+	for (int cy = cy1; cy <= cy2; ++cy) {
+		for (int cx = cx1; cx <= cx2; ++cx) {
+			if (tilemap_chunk_occupied(map, cx, cy)) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/**
+ * Steps a set of bodies by one tick. Same as physics_body_update on each body, in batches, except
+ * that ceiling bumps are flagged in bumped rather than played. Only skips collision resolution
+ * around chunks known to be empty, so update the tilemap's occupancy around the bodies beforehand
+ * @param bodies	Bodies to update
+ * @param count		Number of bodies
+ * @param map		Tilemap to collide with
+ */
+void physics_bodies_update(physics_bodies_t* bodies, int count, const tilemap_t* map) {
+	float* restrict x = bodies->x, * restrict y = bodies->y;
+	float* restrict x_prev = bodies->x_prev, * restrict y_prev = bodies->y_prev;
+	float* restrict xspd = bodies->xspd, * restrict yspd = bodies->yspd;
+	const float* restrict xspd_max = bodies->xspd_max, * restrict yspd_max = bodies->yspd_max;
+	const float* restrict grav = bodies->grav;
+	int32_t* restrict grounded = bodies->grounded;
+
+	// adjust speeds & move, as if nothing will be hit. min/max match MIN/MAX exactly (including
+	// their operand order), so this gives the same results as physics_body_update
+	int i = 0;
+#ifdef HAS_SSE2
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	for (; i + 4 <= count; i += 4) {
+		__m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i);
+		_mm_storeu_ps(x_prev + i, vx);
+		_mm_storeu_ps(y_prev + i, vy);
+		__m128 vyspd = _mm_min_ps(_mm_add_ps(_mm_loadu_ps(yspd + i), _mm_loadu_ps(grav + i)), _mm_loadu_ps(yspd_max + i));
+		__m128 vxspd = _mm_loadu_ps(xspd + i), vmax = _mm_loadu_ps(xspd_max + i);
+		__m128 clamped = _mm_max_ps(_mm_min_ps(vxspd, vmax), _mm_xor_ps(vmax, sign));
+		__m128 airborne = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(grounded + i)), _mm_setzero_si128()));
+		vxspd = _mm_or_ps(_mm_and_ps(airborne, vxspd), _mm_andnot_ps(airborne, clamped));
+		_mm_storeu_ps(yspd + i, vyspd);
+		_mm_storeu_ps(xspd + i, vxspd);
+		_mm_storeu_ps(x + i, _mm_add_ps(vx, vxspd));
+		_mm_storeu_ps(y + i, _mm_add_ps(vy, vyspd));
+		_mm_storeu_si128((__m128i*)(grounded + i), _mm_setzero_si128());
+	}
+#endif
+	for (; i < count; ++i) {
+		x_prev[i] = x[i];
+		y_prev[i] = y[i];
+		yspd[i] = MIN(yspd[i] + grav[i], yspd_max[i]);
+		float clamped = CLAMP(xspd[i], -xspd_max[i], xspd_max[i]);
+		xspd[i] = grounded[i] ? clamped : xspd[i];
+		x[i] += xspd[i];
+		y[i] += yspd[i];
+		grounded[i] = false;
+	}
+	memset(bodies->bumped, 0, (size_t)MAX(count, 0) * sizeof(bool));
+
+	// redo the moves with collisions, for the bodies that could have any. tile sizes are powers of
+	// two, so the scale to chunks is exact, and the chunks are the same as dividing would give
+	float chunks_per_px = 1.0f / (map->tile_size << TILEMAP_CHUNK_SHIFT);
+	for (i = 0; i < count; ++i) {
+		if (!physics_bodies_near_tiles(bodies, i, map, chunks_per_px)) {
+			continue;
+		}
+		physics_body_t body = {
+			.x = x_prev[i], .y = y_prev[i],
+			.x_prev = x_prev[i], .y_prev = y_prev[i],
+			.width = bodies->width[i], .height = bodies->height[i],
+			.origin_x = bodies->origin_x[i], .origin_y = bodies->origin_y[i],
+			.xspd = xspd[i], .yspd = yspd[i]
+		};
+		physics_body_move_x(&body, map);
+		bodies->bumped[i] = physics_body_move_y(&body, map);
+		x[i] = body.x;
+		y[i] = body.y;
+		xspd[i] = body.xspd;
+		yspd[i] = body.yspd;
+		grounded[i] = body.grounded;
+	}
+}
+
+#pragma endregion
+
+#pragma region Entity
+
+/*
+ * Entities live in one pool per type. A pool keeps its live entities packed contiguously in
+ * fixed-size blocks (the size of that type's struct), so spawning appends a block and despawning
+ * moves the last block into the hole. Active entities are kept ahead of sleeping ones (see
+ * Entity Activation), so everything that only cares about active entities walks [0, active_count).
+ * Since entities move around, they're referred to by handles:
+ * the type, a slot that follows the entity wherever its block goes, and the slot's generation,
+ * which is bumped on despawn so old handles to a reused slot stop resolving.
+ * Pointers from entity_get are only valid until the next spawn or despawn of that type.
+ */
+typedef uint64_t entity_handle_t;
+
+#define ENTITY_HANDLE_NONE 				0
+#define ENTITY_HANDLE(type, slot, gen)	(((uint64_t)(gen) << 32) | ((uint64_t)(slot) << 8) | (uint64_t)(type))
+#define ENTITY_HANDLE_TYPE(handle)		((int)((handle) & 0xFF))
+#define ENTITY_HANDLE_SLOT(handle)		((int)(((handle) >> 8) & 0xFFFFFF))
+#define ENTITY_HANDLE_GEN(handle)		((uint32_t)((handle) >> 32))
+#define ENTITY_POOL_MAX_SLOTS			0x1000000
+
+typedef enum entity_type {
+	ENTITY_NONE = -1,
+	ENTITY_GOOMBA = 0,
+	ENTITY_KOOPA,
+	ENTITY_PIRANHA,
+	ENTITY_COUNT,
+} entity_type_t;
+
+const char* entity_type_names[ENTITY_COUNT] = { "goomba", "koopa", "piranha" };
+
+// what an entity asks for when it thinks, carried out when the level commits (see Entity Think & Commit)
+typedef enum entity_event {
+	ENTITY_EVENT_BUMP		= 1 << 0,	// hit a ceiling
+	ENTITY_EVENT_DESPAWN	= 1 << 1,	// remove the entity
+	ENTITY_EVENT_SPAWN		= 1 << 2,	// spawn spawn_type at spawn_x, spawn_y
+} entity_event_t;
+
+typedef struct entity_request {
+	uint32_t events;
+	entity_type_t spawn_type;
+	float spawn_x, spawn_y;
+} entity_request_t;
+
+// an entity's physics body is kept by its pool (bodies), at the same index as the entity
+struct entity {
+	entity_handle_t handle;
+	entity_type_t type;
+	bool is_active;
+};
+
+typedef struct entity_pool {
+	uint8_t* blocks;			// live entities, packed
+	physics_bodies_t bodies;	// physics body of each live entity
+	int* block_slots;			// slot of each live entity
+	int count, capacity;
+	int active_count;			// blocks [0, active_count) are active, the rest asleep
+	size_t block_size;
+	uint32_t* generations;		// per slot, never 0 so that no handle is 0
+	int* slot_blocks;			// block index of each slot, -1 if the slot is free
+	int* next_free;				// free slot list, reused last-in first-out
+	int free_slot;
+	int slot_count;				// slots handed out so far
+	uint8_t* next_blocks;		// what blocks & bodies become once the level commits, written while thinking
+	physics_bodies_t next_bodies;
+	entity_request_t* requests;	// per block, written while thinking
+} entity_pool_t;
+
+/**
+ * Gets a live entity from a pool by its position in it, for iteration over [0, count)
+ */
+static inline entity_t* entity_pool_at(const entity_pool_t* pool, int i) {
+	return (entity_t*)(pool->blocks + (size_t)i * pool->block_size);
+}
+
+void entity_pool_free(entity_pool_t* pool) {
+	free(pool->blocks);
+	free(pool->block_slots);
+	free(pool->generations);
+	free(pool->slot_blocks);
+	free(pool->next_free);
+	free(pool->next_blocks);
+	free(pool->requests);
+	physics_bodies_free(&pool->bodies);
+	physics_bodies_free(&pool->next_bodies);
+	*pool = (entity_pool_t) { 0 };
+}
+
+bool entity_pool_grow(entity_pool_t* pool) {
+	int capacity = (pool->capacity == 0) ? ENTITY_DEFAULT_ALLOCATION_SIZE : pool->capacity * 2;
+	if (capacity > ENTITY_POOL_MAX_SLOTS) {
+		return false;
+	}
+	uint8_t* blocks = realloc(pool->blocks, (size_t)capacity * pool->block_size);
+	if (blocks == NULL) return false;
+	pool->blocks = blocks;
+	int* block_slots = realloc(pool->block_slots, capacity * sizeof(int));
+	if (block_slots == NULL) return false;
+	pool->block_slots = block_slots;
+	uint32_t* generations = realloc(pool->generations, capacity * sizeof(uint32_t));
+	if (generations == NULL) return false;
+	pool->generations = generations;
+	int* slot_blocks = realloc(pool->slot_blocks, capacity * sizeof(int));
+	if (slot_blocks == NULL) return false;
+	pool->slot_blocks = slot_blocks;
+	int* next_free = realloc(pool->next_free, capacity * sizeof(int));
+	if (next_free == NULL) return false;
+	pool->next_free = next_free;
+	uint8_t* next_blocks = realloc(pool->next_blocks, (size_t)capacity * pool->block_size);
+	if (next_blocks == NULL) return false;
+	pool->next_blocks = next_blocks;
+	entity_request_t* requests = realloc(pool->requests, capacity * sizeof(entity_request_t));
+	if (requests == NULL) return false;
+	pool->requests = requests;
+	if (!physics_bodies_reserve(&pool->bodies, capacity)) return false;
+	if (!physics_bodies_reserve(&pool->next_bodies, capacity)) return false;
+	pool->capacity = capacity;
+	return true;
+}
+
+/**
+ * Moves a block over another, which is lost
+ */
+static void entity_pool_move(entity_pool_t* pool, int to, int from) {
+	memcpy(pool->blocks + (size_t)to * pool->block_size, pool->blocks + (size_t)from * pool->block_size, pool->block_size);
+	pool->block_slots[to] = pool->block_slots[from];
+	pool->slot_blocks[pool->block_slots[to]] = to;
+	physics_bodies_move(&pool->bodies, to, from);
+}
+
+static void entity_pool_swap(entity_pool_t* pool, int a, int b) {
+	if (a == b) {
+		return;
+	}
+	uint8_t* block_a = pool->blocks + (size_t)a * pool->block_size;
+	uint8_t* block_b = pool->blocks + (size_t)b * pool->block_size;
+	for (size_t i = 0; i < pool->block_size; ++i) {
+		uint8_t swap = block_a[i];
+		block_a[i] = block_b[i];
+		block_b[i] = swap;
+	}
+	int slot = pool->block_slots[a];
+	pool->block_slots[a] = pool->block_slots[b];
+	pool->block_slots[b] = slot;
+	pool->slot_blocks[pool->block_slots[a]] = a;
+	pool->slot_blocks[pool->block_slots[b]] = b;
+	physics_bodies_swap(&pool->bodies, a, b);
+}
+
+/**
+ * Takes a zeroed, active block from a pool
+ * @param pool 			Pool to spawn into
+ * @param type 			Entity type the pool holds, for the handle
+ * @param block_size 	Size of that type's struct; the pool is set up with it on first use
+ * @return Handle of the new block, or ENTITY_HANDLE_NONE if the pool is full
+ */
+entity_handle_t entity_pool_spawn(entity_pool_t* pool, entity_type_t type, size_t block_size) {
+	if (pool->block_size == 0) {
+		*pool = (entity_pool_t) { .block_size = block_size, .free_slot = -1 };
+	}
+	if (pool->count == pool->capacity && !entity_pool_grow(pool)) {
+		printd("Entity pool for [%s] is full at [%d] entities\n", entity_type_names[type], pool->count);
+		return ENTITY_HANDLE_NONE;
+	}
+
+	// slots are only added when none are free, so there are never more slots than blocks
+	int slot = pool->free_slot;
+	if (slot >= 0) {
+		pool->free_slot = pool->next_free[slot];
+	} else {
+		slot = pool->slot_count++;
+		pool->generations[slot] = 1;
+	}
+	int block = pool->count++;
+	pool->slot_blocks[slot] = block;
+	pool->block_slots[block] = slot;
+	memset(pool->blocks + (size_t)block * pool->block_size, 0, pool->block_size);
+	entity_pool_swap(pool, block, pool->active_count++);
+	return ENTITY_HANDLE(type, slot, pool->generations[slot]);
+}
+
+/**
+ * Looks up the block of a handle
+ * @return Block index, or -1 if the handle is stale or doesn't belong to this pool
+ */
+static inline int entity_pool_find(const entity_pool_t* pool, entity_handle_t handle) {
+	int slot = ENTITY_HANDLE_SLOT(handle);
+	if (slot >= pool->slot_count || pool->generations[slot] != ENTITY_HANDLE_GEN(handle)) {
+		return -1;
+	}
+	return pool->slot_blocks[slot];
+}
+
+/**
+ * Returns a block to its pool. The last active block fills its place if it was active, and the
+ * pool's last block fills whichever hole is left
+ * @return Whether the handle was live
+ */
+bool entity_pool_despawn(entity_pool_t* pool, entity_handle_t handle) {
+	int block = entity_pool_find(pool, handle);
+	if (block < 0) {
+		return false;
+	}
+	int slot = ENTITY_HANDLE_SLOT(handle);
+	if (block < pool->active_count) {
+		int last_active = --pool->active_count;
+		if (block != last_active) {
+			entity_pool_move(pool, block, last_active);
+		}
+		block = last_active;
+	}
+	int last = --pool->count;
+	if (block != last) {
+		entity_pool_move(pool, block, last);
+	}
+	pool->slot_blocks[slot] = -1;
+	if (++pool->generations[slot] == 0) {
+		pool->generations[slot] = 1;
+	}
+	pool->next_free[slot] = pool->free_slot;
+	pool->free_slot = slot;
+	return true;
+}
+
+/**
+ * Wakes or puts to sleep a block, moving it across the active boundary
+ * @return New index of the block
+ */
+int entity_pool_set_active(entity_pool_t* pool, int block, bool active) {
+	entity_t* entity = entity_pool_at(pool, block);
+	if (entity->is_active == active) {
+		return block;
+	}
+	entity->is_active = active;
+	int boundary = active ? pool->active_count++ : --pool->active_count;
+	entity_pool_swap(pool, block, boundary);
+	return boundary;
+}
+
+#pragma endregion
+
+#pragma region Broadphase
+
+/*
+ * Entity-vs-entity (and anything-vs-entity) overlap tests go through a spatial hash of grid cells,
+ * BROADPHASE_CELL_TILES tiles square, rebuilt from the entity pools each tick. Every entity is entered
+ * into each cell its rectangle overlaps. Cells hash into a power of two number of buckets, sized to
+ * the number of entries, and the entries are counting sorted by bucket into one array, so a rebuild
+ * is a few passes over the bodies without touching anything proportional to the level's size.
+ *
+ * An overlap is only reported from the cell holding the top-left corner of the overlapping area,
+ * which both rectangles share, so pairs and query results come out once each, in a fixed order.
+ */
+
+typedef struct broadphase_entry {
+	Rectangle rect;
+	entity_handle_t handle;
+	int index;				// in its pool, until the next spawn or despawn
+	int cell_x, cell_y;
+} broadphase_entry_t;
+
+typedef struct broadphase {
+	float cell_size;				// in pixels
+	int* bucket_start;				// bucket_count + 1 offsets into entries
+	int bucket_count;
+	broadphase_entry_t* entries;	// sorted by bucket
+	broadphase_entry_t* unsorted;
+	int entry_count, entry_capacity;
+} broadphase_t;
+
+void broadphase_free(broadphase_t* broadphase) {
+	free(broadphase->bucket_start);
+	free(broadphase->entries);
+	free(broadphase->unsorted);
+	*broadphase = (broadphase_t) { 0 };
+}
+
+static inline int broadphase_bucket(const broadphase_t* broadphase, int cell_x, int cell_y) {
+	return (int)(((uint32_t)cell_x * 73856093u ^ (uint32_t)cell_y * 19349663u) & (broadphase->bucket_count - 1));
+}
+
+static inline int broadphase_cell(const broadphase_t* broadphase, float v) {
+	return floor_to_int(v / broadphase->cell_size);
+}
+
+/**
+ * Rebuilds a broadphase from the active entities of a set of pools
+ * @param broadphase	Broadphase to rebuild
+ * @param pools			Entity pool of each type
+ * @param cell_size		Cell size in pixels
+ * @return False if out of memory, leaving the broadphase empty
+ */
+bool broadphase_build(broadphase_t* broadphase, const entity_pool_t* pools, float cell_size) {
+	broadphase->cell_size = cell_size;
+	broadphase->entry_count = 0;
+
+	// one entry per cell each entity overlaps
+	for (int type = 0; type < ENTITY_COUNT; ++type) {
+		const entity_pool_t* pool = &pools[type];
+		for (int i = 0; i < pool->active_count; ++i) {
+			const entity_t* e = entity_pool_at(pool, i);
+			Rectangle rect = physics_bodies_get_rectangle(&pool->bodies, i);
+			int x1 = broadphase_cell(broadphase, rect.x), x2 = broadphase_cell(broadphase, rect.x + rect.width);
+			int y1 = broadphase_cell(broadphase, rect.y), y2 = broadphase_cell(broadphase, rect.y + rect.height);
+			for (int cy = y1; cy <= y2; ++cy) {
+				for (int cx = x1; cx <= x2; ++cx) {
+					if (broadphase->entry_count == broadphase->entry_capacity) {
+						int capacity = MAX(broadphase->entry_capacity * 2, ENTITY_DEFAULT_ALLOCATION_SIZE);
+						broadphase_entry_t* entries = realloc(broadphase->entries, capacity * sizeof(broadphase_entry_t));
+						broadphase_entry_t* unsorted = realloc(broadphase->unsorted, capacity * sizeof(broadphase_entry_t));
+						if (entries != NULL) broadphase->entries = entries;
+						if (unsorted != NULL) broadphase->unsorted = unsorted;
+						if (entries == NULL || unsorted == NULL) {
+							broadphase->entry_count = 0;
+							return false;
+						}
+						broadphase->entry_capacity = capacity;
+					}
+					broadphase->unsorted[broadphase->entry_count++] = (broadphase_entry_t) {
+						.rect = rect, .handle = e->handle, .index = i, .cell_x = cx, .cell_y = cy
+					};
+				}
+			}
+		}
+	}
+
+	// at least twice as many buckets as entries, to keep unrelated cells sharing a bucket rare
+	int bucket_count = 64;
+	while (bucket_count < broadphase->entry_count * 2) {
+		bucket_count <<= 1;
+	}
+	if (bucket_count != broadphase->bucket_count) {
+		int* bucket_start = realloc(broadphase->bucket_start, (bucket_count + 1) * sizeof(int));
+		if (bucket_start == NULL) {
+			broadphase->entry_count = 0;
+			return false;
+		}
+		broadphase->bucket_start = bucket_start;
+		broadphase->bucket_count = bucket_count;
+	}
+
+	// counting sort by bucket, keeping the order entries were made in within each bucket
+	int* start = broadphase->bucket_start;
+	memset(start, 0, (bucket_count + 1) * sizeof(int));
+	for (int i = 0; i < broadphase->entry_count; ++i) {
+		const broadphase_entry_t* entry = &broadphase->unsorted[i];
+		++start[broadphase_bucket(broadphase, entry->cell_x, entry->cell_y) + 1];
+	}
+	for (int b = 0; b < bucket_count; ++b) {
+		start[b + 1] += start[b];
+	}
+	for (int i = 0; i < broadphase->entry_count; ++i) {
+		const broadphase_entry_t* entry = &broadphase->unsorted[i];
+		broadphase->entries[start[broadphase_bucket(broadphase, entry->cell_x, entry->cell_y)]++] = *entry;
+	}
+	// the fill pass moved each start to the next bucket's start
+	for (int b = bucket_count; b > 0; --b) {
+		start[b] = start[b - 1];
+	}
+	start[0] = 0;
+	return true;
+}
+
+/**
+ * Checks whether an overlap between two rectangles should be reported from a cell
+ */
+static inline bool broadphase_owns_overlap(const broadphase_t* broadphase, Rectangle a, Rectangle b, int cell_x, int cell_y) {
+	return broadphase_cell(broadphase, MAX(a.x, b.x)) == cell_x && broadphase_cell(broadphase, MAX(a.y, b.y)) == cell_y;
+}
+
+/**
+ * Finds every entity overlapping a rectangle, each once
+ * @param broadphase	Broadphase to search
+ * @param rect			World space rectangle, such as from physics_body_get_rectangle
+ * @param visit			Called for each overlapping entity
+ * @param context		Passed to visit
+ * @return Number of overlapping entities
+ */
+int broadphase_query(const broadphase_t* broadphase, Rectangle rect, void (*visit)(const broadphase_entry_t*, void*), void* context) {
+	if (broadphase->entry_count == 0) {
+		return 0;
+	}
+	int found = 0;
+	int x1 = broadphase_cell(broadphase, rect.x), x2 = broadphase_cell(broadphase, rect.x + rect.width);
+	int y1 = broadphase_cell(broadphase, rect.y), y2 = broadphase_cell(broadphase, rect.y + rect.height);
+	for (int cy = y1; cy <= y2; ++cy) {
+		for (int cx = x1; cx <= x2; ++cx) {
+			int bucket = broadphase_bucket(broadphase, cx, cy);
+			for (int i = broadphase->bucket_start[bucket]; i < broadphase->bucket_start[bucket + 1]; ++i) {
+				const broadphase_entry_t* entry = &broadphase->entries[i];
+				if (entry->cell_x == cx && entry->cell_y == cy && rectangle_collision(rect, entry->rect) &&
+					broadphase_owns_overlap(broadphase, rect, entry->rect, cx, cy)) {
+					if (visit != NULL) {
+						visit(entry, context);
+					}
+					++found;
+				}
+			}
+		}
+	}
+	return found;
+}
+
+/**
+ * Finds every pair of overlapping entities, each pair once
+ * @param broadphase	Broadphase to search
+ * @param visit			Called for each overlapping pair, in the order the pair was entered
+ * @param context		Passed to visit
+ * @return Number of overlapping pairs
+ */
+int broadphase_pairs(const broadphase_t* broadphase, void (*visit)(const broadphase_entry_t*, const broadphase_entry_t*, void*), void* context) {
+	int found = 0;
+	for (int bucket = 0; bucket < broadphase->bucket_count && broadphase->entry_count > 0; ++bucket) {
+		int end = broadphase->bucket_start[bucket + 1];
+		for (int i = broadphase->bucket_start[bucket]; i < end; ++i) {
+			const broadphase_entry_t* a = &broadphase->entries[i];
+			for (int j = i + 1; j < end; ++j) {
+				const broadphase_entry_t* b = &broadphase->entries[j];
+				if (a->cell_x == b->cell_x && a->cell_y == b->cell_y && rectangle_collision(a->rect, b->rect) &&
+					broadphase_owns_overlap(broadphase, a->rect, b->rect, a->cell_x, a->cell_y)) {
+					if (visit != NULL) {
+						visit(a, b, context);
+					}
+					++found;
+				}
+			}
+		}
+	}
+	return found;
+}
+
+#pragma endregion
+
+#pragma region Player Struct
+
+struct player {
+	physics_body_t body;
+	sprite_t* sprites_index;
+	bool flip_x;
+	bool is_big;
+	bool is_crouching;
+	float image_index;
+};
+
+#pragma endregion
+
+#pragma region Level Struct, Init, & Free
+
+typedef struct camera {
+	int x, y;
+	int x_prev, y_prev;
+	int offset_x, offset_y;
+	int width, height;
+	int bounds_x1, bounds_y1, bounds_x2, bounds_y2;	// world area the camera may show
+} camera_t;
+
+// an entity to be spawned into a level, in tile coordinates
+typedef struct level_spawn {
+	int32_t x, y;
+	int32_t type;
+} level_spawn_t;
+
+struct level {
+	player_t player;
+	entity_pool_t entities[ENTITY_COUNT];
+	broadphase_t broadphase;	// of the entities, as of after this tick's physics
+	Color background_color;
+	background_t background;
+	tilemap_t tilemap;
+	tile_layer_t tile_layer;
+	camera_t camera;
+	const level_spawn_t* spawns;	// sorted by x
+	int spawn_count;
+	int* spawn_columns;				// first spawn at or after each column, and spawn_count at the end
+	entity_handle_t* spawn_handles;	// entity each spawn last spawned
+	int spawn_window_x1, spawn_window_x2;	// columns whose spawns have been triggered
+	mapped_file_t file;		// level file the tilemap & spawns point into, if loaded from one
+};
+
+/**
+ * Sets up everything in a level other than its tilemap
+ */
+void level_init_base(level_t* level, const char* background_res, Color background_color) {
+	*level = (level_t) { 
+		.background_color = background_color,
+		.camera = (camera_t) {
+			.offset_x = (-GAME_WIDTH / 2.0f),
+			.offset_y = (-GAME_HEIGHT / 2.0f),
+			.width = GAME_WIDTH,
+			.height = GAME_HEIGHT
+		}
+	};
+
+	// entities (their pools are set up on first spawn)
+	player_init(&level->player);
+	
+	// bg
+	background_init(background_res, &level->background, true);
+	level->background.y = -level->background.tex.height + GAME_HEIGHT;
+	level->background.clamp_x = false;
+	level->background.clamp_y = true;
+	level->background.parallax_x = 0.5f;
+	level->background.parallax_y = 1.0f;
+}
+
+/**
+ * Initializes a level with an empty tilemap
+ */
+void level_init(level_t* level, const char* background_res, Color background_color, int width_in_tiles, int height_in_tiles, int tile_size) {
+	level_init_base(level, background_res, background_color);
+	tilemap_init(&level->tilemap, width_in_tiles, height_in_tiles, tile_size);
+	level->camera.bounds_x2 = width_in_tiles * tile_size;
+	level->camera.bounds_y2 = height_in_tiles * tile_size;
+}
+
+/**
+ * Sets a level's spawn table, and indexes it by column
+ * @param level			Level to set the spawns of
+ * @param spawns		Spawns, sorted by x. Not copied, so must outlive the level
+ * @param spawn_count	Number of spawns
+ */
+void level_init_spawns(level_t* level, const level_spawn_t* spawns, int spawn_count) {
+	level->spawns = spawns;
+	level->spawn_count = spawn_count;
+	if (spawn_count == 0) {
+		return;
+	}
+	int width = level->tilemap.width;
+	level->spawn_columns = malloc((width + 1) * sizeof(int));
+	level->spawn_handles = calloc(spawn_count, sizeof(entity_handle_t));
+	int spawn = 0;
+	for (int x = 0; x <= width; ++x) {
+		while (spawn < spawn_count && spawns[spawn].x < x) {
+			++spawn;
+		}
+		level->spawn_columns[x] = spawn;
+	}
+	level->spawn_columns[width] = spawn_count;
+}
+
+void level_free(level_t* level) {
+	free(level->spawn_columns);
+	free(level->spawn_handles);
+	for (int type = 0; type < ENTITY_COUNT; ++type) {
+		entity_pool_free(&level->entities[type]);
+	}
+	broadphase_free(&level->broadphase);
+	background_free(&level->background);
+	tile_layer_free(&level->tile_layer);
+	tilemap_free(&level->tilemap);
+	mapped_file_close(&level->file);
+}
+
+#pragma endregion
+
+#pragma region Render Snapshots
+
+/*
+ * The simulation can run on a thread of its own, apart from drawing (see game_sim_worker). At the end
+ * of each tick it publishes a snapshot of what there is to draw, and the renderer only ever draws from
+ * the latest snapshot, never the live level. Snapshots are exchanged through a lock-free triple buffer:
+ * the simulation fills the back buffer and swaps it with the shared one, and the renderer swaps the
+ * shared one for its front buffer whenever a fresher snapshot is waiting, so neither side ever waits.
+ */
+
+// a physics body as it's drawn: where it was & is, to interpolate between
+typedef struct render_body {
+	float x, y;
+	float x_prev, y_prev;
+	Rectangle bounds;	// collision bounds, at x & y
+} render_body_t;
+
+typedef struct render_entity {
+	entity_type_t type;
+	render_body_t body;
+} render_entity_t;
+
+struct render_snapshot {
+	bool has_level;
+	long tick;
+	double time;		// when it was published, to interpolate towards it over the next tick
+	int camera_x, camera_y;
+	int camera_x_prev, camera_y_prev;
+	Color background_color;
+	int tile_size;
+
+	// player
+	render_body_t player;
+	const sprite_t* player_sprite;	// NULL for none
+	float player_image_index;
+	float player_origin_x, player_origin_y;
+	bool player_flip_x;
+
+	// entities in view that have a draw function, in type order
+	int entity_count;
+	int entities_dropped;	// in view, but past RENDER_SNAPSHOT_ENTITIES
+	render_entity_t entities[RENDER_SNAPSHOT_ENTITIES];
+
+	// chunks covering the camera's view, this tick & last
+	int chunk_count;
+	int chunks_dropped;		// in view, but past RENDER_SNAPSHOT_CHUNKS (the camera jumped)
+	render_chunk_t chunks[RENDER_SNAPSHOT_CHUNKS];
+};
+
+typedef struct render_snapshots {
+	render_snapshot_t buffers[3];
+	atomic_int shared;	// buffer between the two threads, | RENDER_SNAPSHOT_FRESH while it hasn't been read
+	int back;			// simulation only
+	int front;			// renderer only
+} render_snapshots_t;
+
+/**
+ * Allocates a triple buffer of empty snapshots
+ * @return Snapshots, to be freed with free()
+ */
+render_snapshots_t* render_snapshots_create(void) {
+	render_snapshots_t* snapshots = calloc(1, sizeof(render_snapshots_t));
+	snapshots->back = 0;
+	atomic_init(&snapshots->shared, 1);
+	snapshots->front = 2;
+	return snapshots;
+}
+
+/**
+ * Gets the snapshot the simulation fills in next
+ */
+render_snapshot_t* render_snapshots_back(render_snapshots_t* snapshots) {
+	return &snapshots->buffers[snapshots->back];
+}
+
+/**
+ * Hands the back snapshot over to the renderer, replacing any it hasn't picked up yet. Simulation only
+ */
+void render_snapshots_publish(render_snapshots_t* snapshots) {
+	snapshots->back = atomic_exchange(&snapshots->shared, snapshots->back | RENDER_SNAPSHOT_FRESH) & ~RENDER_SNAPSHOT_FRESH;
+}
+
+/**
+ * Gets the latest snapshot published, which stays untouched by the simulation until the next call.
+ * Renderer only
+ */
+const render_snapshot_t* render_snapshots_latest(render_snapshots_t* snapshots) {
+	if (atomic_load(&snapshots->shared) & RENDER_SNAPSHOT_FRESH) {
+		snapshots->front = atomic_exchange(&snapshots->shared, snapshots->front) & ~RENDER_SNAPSHOT_FRESH;
+	}
+	return &snapshots->buffers[snapshots->front];
+}
+
+/**
+ * Fills a render body in from a physics body
+ */
+render_body_t render_body_from(const physics_body_t* body) {
+	return (render_body_t) { body->x, body->y, body->x_prev, body->y_prev, physics_body_get_rectangle(body) };
+}
+
+/**
+ * Gets the position a body should be drawn at, interpolated between the last two ticks
+ * @param body		Body to get the position of
+ * @param context	Current rendering context
+ * @return Interpolated position
+ */
+Vector2 render_body_position(const render_body_t* body, const render_context_t* context) {
+	return (Vector2) {
+		lerp(body->x_prev, body->x, context->interpolation),
+		lerp(body->y_prev, body->y, context->interpolation)
+	};
+}
+
+/**
+ * Gets the collision bounds of a body where it's drawn, in whole pixels
+ */
+Rectangle render_body_bounds(const render_body_t* body, const render_context_t* context) {
+	Vector2 pos = render_body_position(body, context);
+	return (Rectangle) { floorf(body->bounds.x + pos.x - body->x), floorf(body->bounds.y + pos.y - body->y), body->bounds.width, body->bounds.height };
+}
+
+/**
+ * Finds a chunk in a snapshot
+ * @return The chunk, or NULL if it isn't in the snapshot
+ */
+const render_chunk_t* render_snapshot_chunk(const render_snapshot_t* snapshot, int chunk_x, int chunk_y) {
+	for (int i = 0; i < snapshot->chunk_count; ++i) {
+		if (snapshot->chunks[i].chunk_x == chunk_x && snapshot->chunks[i].chunk_y == chunk_y) {
+			return &snapshot->chunks[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Gets the collision of a tile from a snapshot, like tilemap_get
+ * @return Collision of the tile, or COLLISION_AIR if its chunk isn't in the snapshot
+ */
+collision_type_t render_snapshot_tile(const render_snapshot_t* snapshot, int x, int y) {
+	if (x < 0 || y < 0) {
+		return COLLISION_AIR;
+	}
+	const render_chunk_t* chunk = render_snapshot_chunk(snapshot, x >> TILEMAP_CHUNK_SHIFT, y >> TILEMAP_CHUNK_SHIFT);
+	return (chunk == NULL) ? COLLISION_AIR : chunk->collision[(y & TILEMAP_CHUNK_MASK) * TILEMAP_CHUNK_SIZE + (x & TILEMAP_CHUNK_MASK)];
+}
+
+/**
+ * Gets the position the camera should be drawn at, interpolated between the last two ticks
+ * @param snapshot	Snapshot being drawn
+ * @param context	Current rendering context
+ * @return Interpolated position, in whole pixels
+ */
+Vector2 camera_get_render_position(const render_snapshot_t* snapshot, const render_context_t* context) {
+	return (Vector2) {
+		(int)lerp(snapshot->camera_x_prev, snapshot->camera_x, context->interpolation),
+		(int)lerp(snapshot->camera_y_prev, snapshot->camera_y, context->interpolation)
+	};
+}
+
+#pragma endregion
+
+#pragma region Level Files
+
+/*
+ * Binary level format (.sfml). A fixed header is followed by sections, each aligned to
+ * LEVEL_FILE_ALIGNMENT. Tiles & bitplanes are stored exactly as a tilemap_t holds them, so a loaded
+ * level's tilemap points straight into the file mapping, with no per-tile parsing. Integers are
+ * little-endian. Levels are authored in a text format (see assets/levels) and converted with
+ * --convert-level.
+ */
+
+typedef enum level_section {
+	LEVEL_SECTION_TILES = 0,		// packed tiles, in tilemap chunk order
+	LEVEL_SECTION_SOLID_ROWS,		// tilemap bitplanes
+	LEVEL_SECTION_PLATFORM_ROWS,
+	LEVEL_SECTION_SOLID_COLUMNS,
+	LEVEL_SECTION_SPAWNS,			// level_spawn_t, sorted by x
+	LEVEL_SECTION_COUNT
+} level_section_t;
+
+typedef struct level_file_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t width, height, tile_size;
+	uint32_t spawn_count;
+	uint64_t tile_hash;
+	uint8_t background_color[4];
+	char background[LEVEL_BACKGROUND_NAME_LEN];
+	int32_t camera_bounds[4];	// x1, y1, x2, y2, in pixels
+	uint32_t reserved;
+	struct {
+		uint64_t offset;
+		uint64_t size;
+	} sections[LEVEL_SECTION_COUNT];
+} level_file_header_t;
+
+/**
+ * Writes a level file
+ * @param path				Path to write to
+ * @param map				Tilemap of the level
+ * @param background		Background resource name
+ * @param background_color	Background color
+ * @param camera_bounds		World area the camera may show (x1, y1, x2, y2), in pixels
+ * @param spawns			Entity spawns, sorted by x
+ * @param spawn_count		Number of entity spawns
+ * @return Whether the file could be written
+ */
+bool level_file_write(const char* path, const tilemap_t* map, const char* background, Color background_color, const int camera_bounds[4], const level_spawn_t* spawns, int spawn_count) {
+	if (map->stream != NULL) {
+		printd("Can't write level [%s] from a streamed tilemap\n", path);
+		return false;
+	}
+	level_file_header_t header = {
+		.magic = LEVEL_FILE_MAGIC,
+		.version = LEVEL_FILE_VERSION,
+		.width = map->width,
+		.height = map->height,
+		.tile_size = map->tile_size,
+		.spawn_count = spawn_count,
+		.tile_hash = map->hash,
+		.background_color = { background_color.r, background_color.g, background_color.b, background_color.a },
+		.camera_bounds = { camera_bounds[0], camera_bounds[1], camera_bounds[2], camera_bounds[3] }
+	};
+	strncpy(header.background, background, LEVEL_BACKGROUND_NAME_LEN - 1);
+
+	const void* section_data[LEVEL_SECTION_COUNT] = { map->data, map->solid_rows, map->platform_rows, map->solid_columns, spawns };
+	size_t section_sizes[LEVEL_SECTION_COUNT] = {
+		tilemap_tiles_size(map), tilemap_row_plane_size(map), tilemap_row_plane_size(map), tilemap_column_plane_size(map),
+		spawn_count * sizeof(level_spawn_t)
+	};
+	uint64_t offset = sizeof header;
+	for (int i = 0; i < LEVEL_SECTION_COUNT; ++i) {
+		offset = (offset + LEVEL_FILE_ALIGNMENT - 1) & ~(uint64_t)(LEVEL_FILE_ALIGNMENT - 1);
+		header.sections[i].offset = offset;
+		header.sections[i].size = section_sizes[i];
+		offset += section_sizes[i];
+	}
+
+	FILE* file = fopen(path, "wb");
+	if (file == NULL) {
+		printd("Could not open level [%s] for writing\n", path);
+		return false;
+	}
+	static const uint8_t padding[LEVEL_FILE_ALIGNMENT] = { 0 };
+	bool ok = fwrite(&header, sizeof header, 1, file) == 1;
+	uint64_t written = sizeof header;
+	for (int i = 0; i < LEVEL_SECTION_COUNT && ok; ++i) {
+		ok = fwrite(padding, 1, header.sections[i].offset - written, file) == header.sections[i].offset - written;
+		ok = ok && (section_sizes[i] == 0 || fwrite(section_data[i], 1, section_sizes[i], file) == section_sizes[i]);
+		written = header.sections[i].offset + section_sizes[i];
+	}
+	fclose(file);
+	return ok;
+}
+
+/**
+ * Checks that a level file's dimensions fit the tilemap's int indexing: tiles, chunks & pixels
+ * @param header Header of the level file
+ * @return Whether a tilemap of this size can be laid out
+ */
+static bool level_file_dimensions_valid(const level_file_header_t* header) {
+	uint64_t width = header->width, height = header->height, tile_size = header->tile_size;
+	uint64_t chunks_x = (width + TILEMAP_CHUNK_MASK) >> TILEMAP_CHUNK_SHIFT;
+	uint64_t chunks_y = (height + TILEMAP_CHUNK_MASK) >> TILEMAP_CHUNK_SHIFT;
+	return width > 0 && height > 0 && tile_size >= LEVEL_MIN_TILE_SIZE &&
+		(width + 63) * tile_size <= INT_MAX && (height + 63) * tile_size <= INT_MAX &&	// pixels, padded out to a bitplane word
+		chunks_x * chunks_y * TILEMAP_CHUNK_SIZE * TILEMAP_CHUNK_SIZE <= INT_MAX;
+}
+
+/**
+ * Loads a level from a level file. The file is memory mapped and the level's tilemap and spawns
+ * point into the mapping, so load time doesn't depend on level size. Levels wider than the streaming
+ * window have their tiles streamed in around the camera instead (see Tilemap Streaming)
+ * @param level	Level to initialize
+ * @param path	Path of the level file
+ * @return Whether the level could be loaded
+ */
+bool level_load(level_t* level, const char* path) {
+	mapped_file_t file;
+	if (!mapped_file_open(path, &file)) {
+		printd("Could not open level [%s]\n", path);
+		return false;
+	}
+
+	// validate the header & sections against what a tilemap of this size would need
+	const level_file_header_t* header = file.data;
+	tilemap_t map;
+	bool valid = file.size >= sizeof *header && memcmp(header->magic, LEVEL_FILE_MAGIC, 4) == 0 && header->version == LEVEL_FILE_VERSION &&
+		level_file_dimensions_valid(header);
+	if (valid) {
+		tilemap_init_layout(&map, header->width, header->height, header->tile_size);
+		size_t expected_sizes[LEVEL_SECTION_COUNT] = {
+			tilemap_tiles_size(&map), tilemap_row_plane_size(&map), tilemap_row_plane_size(&map), tilemap_column_plane_size(&map),
+			header->spawn_count * sizeof(level_spawn_t)
+		};
+		for (int i = 0; i < LEVEL_SECTION_COUNT && valid; ++i) {
+			valid = header->sections[i].size == expected_sizes[i] && header->sections[i].offset % LEVEL_FILE_ALIGNMENT == 0 &&
+				header->sections[i].offset <= file.size && header->sections[i].size <= file.size - header->sections[i].offset;
+		}
+	}
+	// spawn types index the entity classes, and the spawn index (see level_init_spawns) needs them in column order
+	if (valid) {
+		const level_spawn_t* spawns = (const level_spawn_t*)((uint8_t*)file.data + header->sections[LEVEL_SECTION_SPAWNS].offset);
+		for (int i = 0; i < header->spawn_count && valid; ++i) {
+			valid = spawns[i].type >= 0 && spawns[i].type < ENTITY_COUNT && (i == 0 || spawns[i].x >= spawns[i - 1].x);
+		}
+	}
+	if (!valid) {
+		printd("Level [%s] is invalid\n", path);
+		mapped_file_close(&file);
+		return false;
+	}
+
+	char background[LEVEL_BACKGROUND_NAME_LEN];
+	memcpy(background, header->background, LEVEL_BACKGROUND_NAME_LEN);
+	background[LEVEL_BACKGROUND_NAME_LEN - 1] = '\0';
+	level_init_base(level, background, (Color) { header->background_color[0], header->background_color[1], header->background_color[2], header->background_color[3] });
+
+	uint8_t* base = file.data;
+	bool streamed = false;
+	if (map.width > TILEMAP_STREAM_SEGMENTS * TILEMAP_SEGMENT_WIDTH) {
+		int center_x = (header->camera_bounds[0] + level->camera.width / 2) / (int)header->tile_size;
+		level->tilemap = map;
+		streamed = tilemap_stream_open(&level->tilemap, (const packed_tile_t*)(base + header->sections[LEVEL_SECTION_TILES].offset), center_x);
+		if (!streamed) {
+			printd("Could not stream level [%s], using all of it in place\n", path);
+		}
+	}
+	if (!streamed) {
+		map.data = (packed_tile_t*)(base + header->sections[LEVEL_SECTION_TILES].offset);
+		map.solid_rows = (uint64_t*)(base + header->sections[LEVEL_SECTION_SOLID_ROWS].offset);
+		map.platform_rows = (uint64_t*)(base + header->sections[LEVEL_SECTION_PLATFORM_ROWS].offset);
+		map.solid_columns = (uint64_t*)(base + header->sections[LEVEL_SECTION_SOLID_COLUMNS].offset);
+		map.chunk_revisions = calloc(tilemap_stored_chunk_count(&map), sizeof(uint32_t));
+		level->tilemap = map;
+	}
+	level->tilemap.hash = header->tile_hash;
+
+	level_init_spawns(level, (const level_spawn_t*)(base + header->sections[LEVEL_SECTION_SPAWNS].offset), header->spawn_count);
+
+	level->camera.bounds_x1 = header->camera_bounds[0];
+	level->camera.bounds_y1 = header->camera_bounds[1];
+	level->camera.bounds_x2 = header->camera_bounds[2];
+	level->camera.bounds_y2 = header->camera_bounds[3];
+
+	level->file = file;
+	return true;
+}
+
+ARRAYLIST_DEFINE(char*, string)
+
+/**
+ * Reads a whole line of any length, without its line ending
+ * @param file	File to read from
+ * @param buf	Line buffer, grown as needed (free when done)
+ * @param cap	Capacity of the line buffer
+ * @return Whether a line was read
+ */
+bool read_line(FILE* file, char** buf, size_t* cap) {
+	size_t len = 0;
+	int c;
+	while ((c = fgetc(file)) != EOF && c != '\n') {
+		if (len + 1 >= *cap) {
+			*cap = MAX(*cap * 2, 256);
+			*buf = realloc(*buf, *cap);
+		}
+		(*buf)[len++] = (char)c;
+	}
+	if (c == EOF && len == 0) {
+		return false;
+	}
+	if (len > 0 && (*buf)[len - 1] == '\r') {
+		--len;
+	}
+	if (*cap == 0) {
+		*buf = realloc(*buf, *cap = 256);
+	}
+	(*buf)[len] = '\0';
+	return true;
+}
+
+int compare_spawns(const void* a, const void* b) {
+	const level_spawn_t* spawn_a = a;
+	const level_spawn_t* spawn_b = b;
+	return (spawn_a->x != spawn_b->x) ? (spawn_a->x > spawn_b->x) - (spawn_a->x < spawn_b->x) : (spawn_a->y > spawn_b->y) - (spawn_a->y < spawn_b->y);
+}
+
+/**
+ * Converts a level from the text authoring format to a level file
+ * @param text_path	Path of the text level
+ * @param out_path	Path of the level file to write
+ * @return Whether the level could be converted
+ */
+bool level_convert(const char* text_path, const char* out_path) {
+	FILE* file = fopen(text_path, "r");
+	if (file == NULL) {
+		printf("Could not open level [%s]\n", text_path);
+		return false;
+	}
+
+	char background[LEVEL_BACKGROUND_NAME_LEN] = "";
+	int r = 0, g = 0, b = 0, a = 255, tile_size = DEFAULT_TILE_SIZE;
+	int camera_bounds[4];
+	bool has_camera_bounds = false, ok = true;
+	level_spawn_t* spawns = NULL;
+	int spawn_count = 0;
+	string_arraylist_t rows;
+	string_arraylist_init(&rows, 64);
+
+	char* line = NULL;
+	size_t cap = 0;
+	bool in_tiles = false;
+	int line_number = 0;
+	while (ok && read_line(file, &line, &cap)) {
+		++line_number;
+		if (in_tiles) {
+			size_t len = strlen(line) + 1;
+			char* row = malloc(len);
+			memcpy(row, line, len);
+			string_arraylist_push(&rows, row);
+			continue;
+		}
+		char type_name[32];
+		int x, y;
+		if (line[0] == '#' || line[0] == '\0') {
+			continue;
+		}
+		else if (strncmp(line, "background_color:", 17) == 0) {
+			ok = sscanf(line, "background_color: %d , %d , %d , %d", &r, &g, &b, &a) >= 3;
+		}
+		else if (strncmp(line, "background:", 11) == 0) {
+			ok = sscanf(line, "background: %31s", background) == 1;
+		}
+		else if (strncmp(line, "tile_size:", 10) == 0) {
+			ok = sscanf(line, "tile_size: %d", &tile_size) == 1 && tile_size >= LEVEL_MIN_TILE_SIZE;
+		}
+		else if (strncmp(line, "camera:", 7) == 0) {
+			ok = has_camera_bounds = sscanf(line, "camera: %d , %d , %d , %d", &camera_bounds[0], &camera_bounds[1], &camera_bounds[2], &camera_bounds[3]) == 4;
+		}
+		else if (strncmp(line, "spawn:", 6) == 0) {
+			ok = sscanf(line, "spawn: %31[^ ,] , %d , %d", type_name, &x, &y) == 3;
+			int type = ENTITY_NONE;
+			for (int i = 0; ok && i < ENTITY_COUNT; ++i) {
+				if (strcmp(type_name, entity_type_names[i]) == 0) {
+					type = i;
+				}
+			}
+			ok = ok && type != ENTITY_NONE;
+			if (ok) {
+				spawns = realloc(spawns, (spawn_count + 1) * sizeof(level_spawn_t));
+				spawns[spawn_count++] = (level_spawn_t) { .x = x, .y = y, .type = type };
+			}
+		}
+		else if (strncmp(line, "tiles:", 6) == 0) {
+			in_tiles = true;
+		}
+		else {
+			ok = false;
+		}
+		if (!ok) {
+			printf("Level [%s] line [%d] is invalid: %s\n", text_path, line_number, line);
+		}
+	}
+	free(line);
+	fclose(file);
+
+	// trailing blank lines aren't rows
+	while (rows.count > 0 && rows.data[rows.count - 1][0] == '\0') {
+		free(rows.data[--rows.count]);
+	}
+
+	int width = 0, height = rows.count;
+	for (int i = 0; i < rows.count; ++i) {
+		width = MAX(width, (int)strlen(rows.data[i]));
+	}
+	if (ok && (width == 0 || height == 0)) {
+		printf("Level [%s] has no tiles\n", text_path);
+		ok = false;
+	}
+
+	if (ok) {
+		tilemap_t map;
+		tilemap_init(&map, width, height, tile_size);
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; rows.data[y][x] != '\0'; ++x) {
+				char c = rows.data[y][x];
+				if (c == '#') {
+					tilemap_set(&map, x, y, (tile_t) { .collision = COLLISION_SOLID });
+				}
+				else if (c == '=') {
+					tilemap_set(&map, x, y, (tile_t) { .collision = COLLISION_PLATFORM });
+				}
+			}
+		}
+		if (!has_camera_bounds) {
+			camera_bounds[0] = camera_bounds[1] = 0;
+			camera_bounds[2] = width * tile_size;
+			camera_bounds[3] = height * tile_size;
+		}
+		if (spawn_count > 0) {
+			qsort(spawns, spawn_count, sizeof(level_spawn_t), compare_spawns);
+		}
+		ok = level_file_write(out_path, &map, background, (Color) { r, g, b, a }, camera_bounds, spawns, spawn_count);
+		printf("%s level [%s] [%dx%d] with [%d] spawns to [%s]\n", ok ? "Converted" : "Failed to convert", text_path, width, height, spawn_count, out_path);
+		tilemap_free(&map);
+	}
+
+	for (int i = 0; i < rows.count; ++i) {
+		free(rows.data[i]);
+	}
+	string_arraylist_free(&rows);
+	free(spawns);
+	return ok;
+}
+
+#pragma endregion
+
+#pragma region Entity Functions
+
+/**
+ * Resolves a handle to its entity
+ * @return The entity, or NULL if it has been despawned. Only valid until the next spawn or despawn of its type
+ */
+entity_t* entity_get(level_t* level, entity_handle_t handle) {
+	int type = ENTITY_HANDLE_TYPE(handle);
+	if (handle == ENTITY_HANDLE_NONE || type >= ENTITY_COUNT) {
+		return NULL;
+	}
+	entity_pool_t* pool = &level->entities[type];
+	int block = entity_pool_find(pool, handle);
+	return (block < 0) ? NULL : entity_pool_at(pool, block);
+}
+
+/**
+ * Removes an entity from a level. Stale handles are ignored
+ * @return Whether the entity was live
+ */
+bool entity_despawn(level_t* level, entity_handle_t handle) {
+	int type = ENTITY_HANDLE_TYPE(handle);
+	if (handle == ENTITY_HANDLE_NONE || type >= ENTITY_COUNT) {
+		return false;
+	}
+	return entity_pool_despawn(&level->entities[type], handle);
+}
+
+#pragma endregion
+
+#pragma region Enemies
+
+/*
+ * Entity behavior runs per type, over a batch of a pool at a time, after the batch's bodies have been
+ * stepped. It thinks against the level as of the last tick and writes to the pool's next blocks,
+ * bodies & requests, only within its batch (see Entity Think & Commit)
+ */
+
+typedef struct entity_goomba {
+	entity_t base;
+	int direction;
+} entity_goomba_t;
+
+void goomba_init(entity_t* entity, level_t* level) {
+	((entity_goomba_t*)entity)->direction = -1;
+}
+
+void goomba_think(const level_t* level, const entity_pool_t* pool, int begin, int end) {
+	float* xspd = pool->next_bodies.xspd;
+	for (int i = begin; i < end; ++i) {
+		entity_goomba_t* g = (entity_goomba_t*)(pool->next_blocks + (size_t)i * pool->block_size);
+		// walls stop a body, so turn around whenever stopped
+		if (xspd[i] == 0.0f) {
+			g->direction = -g->direction;
+		}
+		xspd[i] = g->direction * GOOMBA_WALK_SPEED;
+	}
+}
+
+void goomba_draw(const render_entity_t* goomba, render_context_t* context) {
+	// no goomba sprites yet, so just its bounds
+	sprite_batch_rectangle_lines(render_body_bounds(&goomba->body, context), 1, BROWN, context);
+}
+
+/**
+ * Reacts to two entities overlapping. Called for each overlapping pair by the broadphase
+ */
+void entity_collide(const broadphase_entry_t* a, const broadphase_entry_t* b, void* context) {
+	level_t* level = context;
+	// goombas bounce off of each other
+	if (ENTITY_HANDLE_TYPE(a->handle) == ENTITY_GOOMBA && ENTITY_HANDLE_TYPE(b->handle) == ENTITY_GOOMBA) {
+		entity_goomba_t* left = (entity_goomba_t*)entity_get(level, a->handle);
+		entity_goomba_t* right = (entity_goomba_t*)entity_get(level, b->handle);
+		if (a->rect.x > b->rect.x) {
+			entity_goomba_t* swap = left;
+			left = right;
+			right = swap;
+		}
+		left->direction = -1;
+		right->direction = 1;
+	}
+}
+
+/**
+ * Reacts to the player overlapping an entity. Called for each entity the player overlaps by the broadphase
+ */
+void player_collide(const broadphase_entry_t* entry, void* context) {
+	level_t* level = context;
+	physics_body_t* body = &level->player.body;
+	Rectangle rect = physics_body_get_rectangle(body);
+	float bottom_prev = rect.y + rect.height - (body->y - body->y_prev);
+	// landing on a goomba from above stomps it, and bounces the player back up
+	if (ENTITY_HANDLE_TYPE(entry->handle) == ENTITY_GOOMBA && body->yspd > 0.0f && bottom_prev <= entry->rect.y) {
+		entity_despawn(level, entry->handle);
+		body->yspd = -PLAYER_STOMP_BOUNCE;
+		sound_play(SOUND_BUMP);
+	}
+}
+
+// what each entity type's pool is made of, and how it behaves
+typedef struct entity_class {
+	size_t size;
+	int width, height;
+	void (*init)(entity_t*, level_t*);
+	void (*think)(const level_t*, const entity_pool_t*, int begin, int end);
+	void (*draw)(const render_entity_t*, render_context_t*);	// from a render snapshot (see level_snapshot)
+} entity_class_t;
+
+const entity_class_t entity_classes[ENTITY_COUNT] = {
+	[ENTITY_GOOMBA] = { sizeof(entity_goomba_t), 8, 6, goomba_init, goomba_think, goomba_draw },
+	[ENTITY_KOOPA] = { sizeof(entity_t), DEFAULT_TILE_SIZE, DEFAULT_TILE_SIZE },
+	[ENTITY_PIRANHA] = { sizeof(entity_t), DEFAULT_TILE_SIZE, DEFAULT_TILE_SIZE },
+};
+
+/**
+ * Spawns an entity into a level's pool for its type
+ * @param level	Level to spawn into
+ * @param type	Type of entity
+ * @return Handle of the new entity, or ENTITY_HANDLE_NONE if it couldn't be spawned
+ */
+entity_handle_t entity_spawn(level_t* level, entity_type_t type) {
+	const entity_class_t* class = &entity_classes[type];
+	entity_pool_t* pool = &level->entities[type];
+	entity_handle_t handle = entity_pool_spawn(pool, type, class->size);
+	if (handle != ENTITY_HANDLE_NONE) {
+		int block = entity_pool_find(pool, handle);
+		entity_t* entity = entity_pool_at(pool, block);
+		*entity = (entity_t) {
+			.handle = handle,
+			.type = type,
+			.is_active = true
+		};
+		physics_body_t body;
+		physics_body_init(&body, class->width, class->height);
+		physics_bodies_set(&pool->bodies, block, &body);
+		if (class->init != NULL) {
+			class->init(entity, level);
+		}
+	}
+	return handle;
+}
+
+/**
+ * Spawns an entity at a position, with its body's origin there
+ * @return Handle of the new entity, or ENTITY_HANDLE_NONE if it couldn't be spawned
+ */
+entity_handle_t entity_spawn_at(level_t* level, entity_type_t type, float x, float y) {
+	entity_handle_t handle = entity_spawn(level, type);
+	if (handle != ENTITY_HANDLE_NONE) {
+		entity_pool_t* pool = &level->entities[type];
+		int block = entity_pool_find(pool, handle);
+		pool->bodies.x[block] = pool->bodies.x_prev[block] = x;
+		pool->bodies.y[block] = pool->bodies.y_prev[block] = y;
+	}
+	return handle;
+}
+
+#pragma endregion
+
+#pragma region Entity Activation
+
+/*
+ * Only entities around the camera exist, so that the cost of a tick depends on what's on screen
+ * rather than on the size of the level. Spawns are triggered column by column as they come within
+ * ENTITY_SPAWN_MARGIN tiles of the view. Entities further than ENTITY_SLEEP_MARGIN tiles out of view
+ * sleep: they keep their state but aren't updated or drawn. Past ENTITY_DESPAWN_MARGIN tiles (or
+ * below the level) they're despawned, and their spawn can trigger again once the camera comes back.
+ */
+
+/**
+ * Spawns an entity from a level's spawn table, unless the entity it last spawned is still around
+ */
+void level_spawn(level_t* level, int spawn) {
+	if (entity_get(level, level->spawn_handles[spawn]) != NULL) {
+		return;
+	}
+	const level_spawn_t* s = &level->spawns[spawn];
+	int tile_size = level->tilemap.tile_size;
+	level->spawn_handles[spawn] = entity_spawn_at(level, s->type, (s->x + 0.5f) * tile_size, (s->y + 1.0f) * tile_size);
+}
+
+/**
+ * Triggers spawns for the columns entering the spawn window, and wakes, sleeps & despawns entities
+ * by their distance from the view
+ */
+void level_activate_entities(level_t* level) {
+	const camera_t* camera = &level->camera;
+	int tile_size = level->tilemap.tile_size;
+
+	// spawn window, in columns
+	if (level->spawn_columns != NULL) {
+		int x1 = CLAMP(camera->x / tile_size - ENTITY_SPAWN_MARGIN, 0, level->tilemap.width);
+		int x2 = CLAMP((camera->x + camera->width + tile_size - 1) / tile_size + ENTITY_SPAWN_MARGIN, 0, level->tilemap.width);
+		for (int x = x1; x < x2; ++x) {
+			if (x >= level->spawn_window_x1 && x < level->spawn_window_x2) {
+				x = level->spawn_window_x2 - 1;
+				continue;
+			}
+			for (int spawn = level->spawn_columns[x]; spawn < level->spawn_columns[x + 1]; ++spawn) {
+				level_spawn(level, spawn);
+			}
+		}
+		level->spawn_window_x1 = x1;
+		level->spawn_window_x2 = x2;
+	}
+
+	// walked from the back, so entities moved around by sleeping & despawning have already been seen. Waking
+	// swaps in an unseen sleeping entity from the active boundary, so that block is visited again
+	float view_x1 = camera->x, view_x2 = camera->x + camera->width;
+	float bottom = (level->tilemap.height + ENTITY_DESPAWN_MARGIN) * (float)tile_size;
+	for (int type = 0; type < ENTITY_COUNT; ++type) {
+		entity_pool_t* pool = &level->entities[type];
+		for (int i = pool->count - 1; i >= 0; --i) {
+			Rectangle rect = physics_bodies_get_rectangle(&pool->bodies, i);
+			float distance = MAX(MAX(view_x1 - (rect.x + rect.width), rect.x - view_x2), 0.0f) / tile_size;
+			if (distance > ENTITY_DESPAWN_MARGIN || rect.y > bottom) {
+				entity_pool_despawn(pool, entity_pool_at(pool, i)->handle);
+			}
+			else if (entity_pool_set_active(pool, i, distance <= ENTITY_SLEEP_MARGIN) < i) {
+				++i;
+			}
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region Entity Think & Commit
+
+/*
+ * Active entities are updated in two phases. Thinking steps each entity's body and runs its type's
+ * behavior, in batches spread across the job system's threads. It only reads the level as it was
+ * after the last tick, and each batch only writes its own range of the pools' next blocks, bodies &
+ * requests, so batches can run in any order on any thread. Committing then swaps the next blocks &
+ * bodies in and carries out the requests (sounds, despawns & spawns) on one thread, in pool & block
+ * order, so the results are the same whatever the number of threads.
+ */
+
+typedef struct entity_think {
+	const level_t* level;
+	const entity_pool_t* pool;
+	void (*think)(const level_t*, const entity_pool_t*, int begin, int end);
+} entity_think_t;
+
+void entity_think_batch(void* context, int begin, int end) {
+	const entity_think_t* think = context;
+	const entity_pool_t* pool = think->pool;
+	memcpy(pool->next_blocks + (size_t)begin * pool->block_size, pool->blocks + (size_t)begin * pool->block_size, (size_t)(end - begin) * pool->block_size);
+	physics_bodies_t next = pool->next_bodies;
+	physics_bodies_copy(&next, &pool->bodies, begin, end);
+
+	physics_bodies_t batch = physics_bodies_offset(&next, begin);
+	physics_bodies_update(&batch, end - begin, &think->level->tilemap);
+	for (int i = begin; i < end; ++i) {
+		pool->requests[i] = (entity_request_t) { .events = next.bumped[i] ? ENTITY_EVENT_BUMP : 0 };
+	}
+	if (think->think != NULL) {
+		think->think(think->level, pool, begin, end);
+	}
+}
+
+/**
+ * Thinks for every active entity of a level, filling in their pools' next blocks, bodies & requests
+ * @param level	Level to think for. Nothing in it is written besides the pools' next state
+ * @param jobs	Job system to spread the batches over
+ */
+void level_think_entities(const level_t* level, job_system_t* jobs) {
+	for (int type = 0; type < ENTITY_COUNT; ++type) {
+		entity_think_t think = { level, &level->entities[type], entity_classes[type].think };
+		job_system_run(jobs, entity_think_batch, &think, think.pool->active_count, ENTITY_THINK_BATCH_SIZE);
+	}
+}
+
+/**
+ * Swaps in the state the active entities of a level thought up, then carries out their requests
+ * @param level Level to commit
+ */
+void level_commit_entities(level_t* level) {
+	// sleeping entities carry over as they are
+	int thought[ENTITY_COUNT] = { 0 };
+	for (int type = 0; type < ENTITY_COUNT; ++type) {
+		entity_pool_t* pool = &level->entities[type];
+		if (pool->capacity == 0) {
+			continue;
+		}
+		int begin = pool->active_count, end = pool->count;
+		memcpy(pool->next_blocks + (size_t)begin * pool->block_size, pool->blocks + (size_t)begin * pool->block_size, (size_t)(end - begin) * pool->block_size);
+		physics_bodies_copy(&pool->next_bodies, &pool->bodies, begin, end);
+
+		uint8_t* blocks = pool->blocks;
+		pool->blocks = pool->next_blocks;
+		pool->next_blocks = blocks;
+		physics_bodies_t bodies = pool->bodies;
+		pool->bodies = pool->next_bodies;
+		pool->next_bodies = bodies;
+		thought[type] = pool->active_count;
+	}
+
+	// walked from the back, so a despawn only moves blocks whose requests have been carried out.
+	// spawned entities land past the blocks that thought, so they're left alone until the next tick
+	for (int type = 0; type < ENTITY_COUNT; ++type) {
+		entity_pool_t* pool = &level->entities[type];
+		for (int i = thought[type] - 1; i >= 0; --i) {
+			entity_request_t request = pool->requests[i];
+			if (request.events & ENTITY_EVENT_BUMP) {
+				sound_play(SOUND_BUMP);
+			}
+			if (request.events & ENTITY_EVENT_DESPAWN) {
+				entity_pool_despawn(pool, entity_pool_at(pool, i)->handle);
+			}
+			if (request.events & ENTITY_EVENT_SPAWN) {
+				entity_spawn_at(level, request.spawn_type, request.spawn_x, request.spawn_y);
+			}
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region State Hashing
+
+uint64_t physics_body_hash(uint64_t h, const physics_body_t* body) {
+	h = hash_combine(h, hash_floats(body->x, body->y));
+	h = hash_combine(h, hash_floats(body->xspd, body->yspd));
+	h = hash_combine(h, hash_floats(body->xspd_max, body->yspd_max));
+	h = hash_combine(h, hash_floats(body->origin_x, body->origin_y));
+	h = hash_combine(h, hash_floats(body->grav, 0.0f));
+	return hash_combine(h, ((uint64_t)body->width << 33) | ((uint64_t)body->height << 1) | body->grounded);
+}
+
+/**
+ * Hashes the simulation state of a level. The tilemap's hash is maintained as tiles are set, so
+ * the cost of this only depends on the number of entities
+ * @param h		Running hash
+ * @param level	Level to hash
+ * @return New running hash
+ */
+uint64_t level_hash(uint64_t h, const level_t* level) {
+	const player_t* player = &level->player;
+	h = physics_body_hash(h, &player->body);
+	h = hash_combine(h, hash_floats(player->image_index, 0.0f));
+	h = hash_combine(h, ((player->sprites_index == NULL) ? 0 : (uint64_t)(player->sprites_index - (sprite_t*)&mario_sprites)) << 3 |
+		(player->flip_x << 2) | (player->is_big << 1) | player->is_crouching);
+
+	h = hash_combine(h, ((uint64_t)(uint32_t)level->camera.x << 32) | (uint32_t)level->camera.y);
+	h = hash_combine(h, level->tilemap.hash);
+
+	for (int type = 0; type < ENTITY_COUNT; ++type) {
+		const entity_pool_t* pool = &level->entities[type];
+		h = hash_combine(h, ((uint64_t)pool->count << 32) | (uint32_t)pool->slot_count);
+		h = hash_combine(h, pool->active_count);
+		for (int i = 0; i < pool->count; ++i) {
+			const entity_t* e = entity_pool_at(pool, i);
+			physics_body_t body = physics_bodies_get(&pool->bodies, i);
+			h = hash_combine(h, e->handle);
+			h = hash_combine(h, ((uint64_t)(e->type + 1) << 1) | e->is_active);
+			h = physics_body_hash(h, &body);
+		}
+	}
+	return h;
+}
+
+/**
+ * Compares two state hash logs (as written with --hash-log) and finds where they diverge
+ * @param path_a	First log
+ * @param path_b	Second log
+ * @return First tick with differing hashes, -1 if the logs match, or -2 if either log couldn't be opened
+ */
+long state_hash_log_compare(const char* path_a, const char* path_b) {
+	FILE* a = fopen(path_a, "r");
+	FILE* b = fopen(path_b, "r");
+	long result = -2;
+	if (a != NULL && b != NULL) {
+		result = -1;
+		long tick_a, tick_b;
+		unsigned long long hash_a, hash_b;
+		while (true) {
+			int read_a = fscanf(a, "%ld %llx", &tick_a, &hash_a);
+			int read_b = fscanf(b, "%ld %llx", &tick_b, &hash_b);
+			if (read_a != 2 || read_b != 2) {
+				// one log is longer than the other
+				if ((read_a == 2) != (read_b == 2)) {
+					result = (read_a == 2) ? tick_a : tick_b;
+				}
+				break;
+			}
+			if (tick_a != tick_b || hash_a != hash_b) {
+				result = MIN(tick_a, tick_b);
+				break;
+			}
+		}
+	}
+	if (a != NULL) fclose(a);
+	if (b != NULL) fclose(b);
+	return result;
+}
+
+#pragma endregion
+
+#pragma region Game Control
+
+struct game {
+	int controller_count;
+	render_context_t render_context;
+	controller_state_t* controllers;
+	level_t* level;
+	long tick;
+	input_recorder_t recorder;
+	input_playback_t playback;
+	uint64_t state_hash;	// hash of the whole simulation, as of the end of the last tick
+	FILE* hash_log;
+	job_system_t jobs;
+	hud_t hud;
+	soft_renderer_t soft;		// only set up by --render (see game_init_soft)
+	FILE* frame_log;			// hash of every frame the software renderer drew
+	char frame_dir[MAX_PATH_LEN];
+	long frames_rendered;
+	double render_time;
+	frame_capture_t capture;	// only started by --capture or --capture-png
+	render_snapshots_t* snapshots;	// what there is to draw, published every tick; NULL if nothing draws
+	thrd_t sim_thread;				// runs the simulation apart from drawing (see game_sim_worker)
+	atomic_bool sim_quit;
+	atomic_uint keyboard;			// packed keyboard buttons, sampled on the main thread for the simulation
+};
+
+/**
+ * Hashes the full simulation state: controllers, rng, and the level
+ * @param game Game to hash
+ * @return State hash
+ */
+uint64_t game_hash_state(const game_t* game) {
+	uint64_t h = hash_combine(0, game->tick);
+	h = hash_combine(h, rng_state);
+	for (int i = 0; i < game->controller_count; ++i) {
+		h = hash_combine(h, ((uint64_t)controller_buttons_pack(game->controllers[i].previous) << 32) | controller_buttons_pack(game->controllers[i].current));
+	}
+	if (game->level != NULL) {
+		h = level_hash(h, game->level);
+	}
+	return h;
+}
+
+/**
+ * Generates scripted input for when no keyboard is available (i.e. headless soak runs).
+ * Walks back and forth across the level, running, jumping and crouching on a fixed pattern,
+ * turning around before the player can walk off either end of the level.
+ * @param tick	Current simulation tick
+ * @param level	Level the player is in
+ * @return Buttons held down
+ */
+controller_buttons_t controller_poll_script(long tick, const level_t* level) {
+	controller_buttons_t buttons = {
+		.h = ((tick / 600) % 2 == 0) ? 1 : -1,
+		.v = ((tick / 1000) % 7 == 6) ? 1 : 0,
+		.a = (tick % 90) < 20,
+		.b = (tick / 240) % 2 == 0
+	};
+	if (level != NULL) {
+		float edge = level->tilemap.tile_size * 4.0f;
+		if (level->player.body.x < edge) buttons.h = 1;
+		else if (level->player.body.x > level->tilemap.width * level->tilemap.tile_size - edge) buttons.h = -1;
+	}
+	return buttons;
+}
+
+/**
+ * Snapshots what there is to draw as of the tick just simulated, and hands it to the renderer
+ * @param game Game to snapshot
+ */
+void game_publish_snapshot(game_t* game) {
+	if (game->snapshots == NULL) {
+		return;
+	}
+	render_snapshot_t* snapshot = render_snapshots_back(game->snapshots);
+	snapshot->has_level = false;
+	if (game->level != NULL) {
+		level_snapshot(game->level, snapshot);
+	}
+	snapshot->tick = game->tick;
+	snapshot->time = time_now();
+	render_snapshots_publish(game->snapshots);
+}
+
+void game_update(game_t* game) {
+	// recorded input takes over from the keyboard (or script) until it runs out
+	controller_buttons_t played_back[MAX_CONTROLLERS];
+	bool is_playing_back = input_playback_next(&game->playback, played_back);
+
+	for (int i = 0; i < game->controller_count; ++i) {
+		if (is_playing_back) {
+			controller_state_update(&game->controllers[i], played_back[i]);
+			continue;
+		}
+#ifdef HEADLESS
+		controller_state_update(&game->controllers[i], controller_poll_script(game->tick, game->level));
+#else
+		// raylib's input is only safe to poll on the main thread (see game_run)
+		controller_state_update(&game->controllers[i], controller_buttons_unpack(atomic_load(&game->keyboard)));
+#endif
+	}
+	input_recorder_push(&game->recorder, game->controllers);
+
+	if (game->level) {
+		level_update(game->level, game);
+	}
+	++game->tick;
+
+	game->state_hash = game_hash_state(game);
+	if (game->hash_log != NULL) {
+		fprintf(game->hash_log, "%ld %016llx\n", game->tick, (unsigned long long)game->state_hash);
+	}
+	game_publish_snapshot(game);
+}
+
+void game_draw(game_t* game, const render_snapshot_t* snapshot) {
+	if (game->level && snapshot->has_level) {
+		level_draw(game->level, snapshot, &game->render_context);
+	}
+}
+
+/**
+ * Registers the HUD's elements
+ * @param game Game the HUD is for
+ */
+void game_init_hud(game_t* game) {
+	hud_init(&game->hud);
+	hud_add_text(&game->hud, "HELLO WORLD", &fnt_hud, 0, 0);
+}
+
+/**
+ * Hands the frame just drawn to the frame capture, reading it back after compositing the HUD over the
+ * render texture, or straight from the software renderer's framebuffer (which already has the HUD).
+ * Dropped without a read back if the ring is full
+ * @param game Game to capture
+ */
+void game_capture_frame(game_t* game) {
+	Color* slot = frame_capture_begin(&game->capture);
+	if (slot == NULL) {
+		return;
+	}
+	if (game->render_context.soft != NULL) {
+		frame_capture_copy(&game->capture, slot, game->soft.framebuffer.data, false);
+	}
+	else {
+		// composited the same way game_run puts them on screen, into a target of its own so the screen
+		// doesn't get the HUD blended in twice
+		render_context_t* context = &game->render_context;
+		if (context->capture_texture.id == 0) {
+			context->capture_texture = LoadRenderTexture(GAME_WIDTH, GAME_HEIGHT);
+		}
+		Rectangle area = { 0, 0, GAME_WIDTH, GAME_HEIGHT };
+		Rectangle source_area = { 0, 0, GAME_WIDTH, -GAME_HEIGHT };
+		BeginTextureMode(context->capture_texture);
+		ClearBackground(BLACK);
+		DrawTexturePro(context->render_texture.texture, source_area, area, (Vector2) { 0, 0 }, 0, WHITE);
+		DrawTexturePro(context->hud_texture.texture, source_area, area, (Vector2) { 0, 0 }, 0, WHITE);
+		EndTextureMode();
+
+		// render textures are stored upside down
+		Texture texture = context->capture_texture.texture;
+		void* pixels = rlReadTexturePixels(texture.id, texture.width, texture.height, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+		frame_capture_copy(&game->capture, slot, pixels, true);
+		RL_FREE(pixels);
+	}
+	frame_capture_end(&game->capture);
+}
+
+/**
+ * Opens the window and audio device, and builds the sprite and tile atlases
+ * @param window_title	Title of the window
+ * @param game			Game to initialize the render context of
+ */
+void game_init_platform(const char* window_title, game_t* game) {
+	// start window
+	SetTraceLogLevel(LOG_NONE);
+#ifdef EDIT_MODE
+#endif
+#ifdef EDIT_MODE
+	SetConfigFlags(FLAG_WINDOW_RESIZABLE);
+#else
+	// the simulation runs on a fixed tick (see game_run), so drawing only needs to keep up with the display
+	SetConfigFlags(FLAG_WINDOW_RESIZABLE | FLAG_VSYNC_HINT);
+#endif
+	InitWindow(256, 224, window_title);
+	InitAudioDevice();
+#ifdef EDIT_MODE
+	SetTargetFPS(120);
+#endif
+
+	Image icon = LoadImage("assets/icon_editor.png");
+	SetWindowIcon(icon);
+	UnloadImage(icon);
+
+	// sprite & tile atlases, from the atlas cache when it's up to date
+	{
+		atlas_set_t atlases;
+		atlas_timings_t timings;
+		atlas_load(&atlases, &timings);
+		font_init("0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.,*-!@|=:", &fnt_hud);
+
+		double start = time_now();
+		const atlas_pages_t* sprite_atlas = &atlases.atlases[ATLAS_SPRITES];
+		for (int i = 0; i < sprite_atlas->page_count; ++i) {
+			game->render_context.sprite_atlas[i] = LoadTextureFromImage(sprite_atlas->pages[i]);
+		}
+		game->render_context.sprite_atlas_pages = sprite_atlas->page_count;
+		timings.upload = time_now() - start;
+
+		printd("Atlases %s: hash [%.2f] ms, %s cache [%.2f] ms, decode [%.2f] ms, pack [%.2f] ms, upload [%.2f] ms\n",
+			timings.cache_hit ? "loaded from cache" : "built", timings.hash * 1000.0, timings.cache_hit ? "load" : "write",
+			timings.cache * 1000.0, timings.decode * 1000.0, timings.pack * 1000.0, timings.upload * 1000.0);
+
+#ifdef DUMP_ATLASES
+		for (int k = 0; k < ATLAS_KIND_COUNT; ++k) {
+			for (int i = 0; i < atlases.atlases[k].page_count; ++i) {
+				ExportImage(atlases.atlases[k].pages[i], TextFormat("%s_atlas_dump_%d.png", k == ATLAS_SPRITES ? "sprite" : "tile", i));
+			}
+		}
+#endif
+		atlas_free(&atlases);
+	}
+
+#ifndef EDIT_MODE
+	sounds = (struct sounds) {
+		.bump = LoadSound("assets/sounds/bump.wav"),
+		.jump = LoadSound("assets/sounds/jump.wav")
+	};
+
+	// create rendering surface 
+	game->render_context.render_texture = LoadRenderTexture(GAME_WIDTH, GAME_HEIGHT);
+	game->render_context.hud_texture = LoadRenderTexture(GAME_WIDTH, GAME_HEIGHT);
+	game->render_context.tile_glow = true;
+	game->snapshots = render_snapshots_create();
+
+	game_init_hud(game);
+#endif
+}
+
+/**
+ * Sets up the software renderer, for drawing frames without a window or GPU (see game_render_soft).
+ * Loads the atlases for their images, which are kept instead of being uploaded
+ * @param game		Game to render
+ * @param frame_dir	Existing directory the frame hashes & images are written to
+ * @return Whether the frame hash log could be opened
+ */
+bool game_init_soft(game_t* game, const char* frame_dir) {
+	snprintf(game->frame_dir, sizeof(game->frame_dir), "%s", frame_dir);
+	game->frame_log = fopen(TextFormat("%s/frames.txt", frame_dir), "w");
+	if (game->frame_log == NULL) {
+		printf("Could not open [%s/frames.txt]\n", frame_dir);
+		return false;
+	}
+
+	atlas_set_t atlases;
+	atlas_timings_t timings;
+	atlas_load(&atlases, &timings);
+	font_init("0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.,*-!@|=:", &fnt_hud);
+
+	soft_renderer_init(&game->soft);
+	const atlas_pages_t* sprite_atlas = &atlases.atlases[ATLAS_SPRITES];
+	for (int i = 0; i < sprite_atlas->page_count; ++i) {
+		game->soft.sprite_atlas[i] = ImageCopy(sprite_atlas->pages[i]);
+	}
+	game->render_context.sprite_atlas_pages = sprite_atlas->page_count;
+	atlas_free(&atlases);
+
+	// frames show the state as of the tick just simulated
+	game->render_context.soft = &game->soft;
+	game->render_context.interpolation = 1.0f;
+	game->render_context.tile_glow = true;
+	game->snapshots = render_snapshots_create();
+	game_init_hud(game);
+	return true;
+}
+
+/**
+ * Initializes the game. The simulation (controllers & level) is set up last, so that headless
+ * builds can skip the platform layer entirely
+ * @param window_title	Title of the window (unused when headless)
+ * @param game			Game to initialize
+ */
+void game_init(const char* window_title, game_t* game) {
 	// set all game values to 0 (nullified)
 	*game = (game_t) { 0 };
 
-	// rng
-	srand(0);
+	// rng
+	rng_seed(0);
+
+	job_system_init(&game->jobs, JOB_THREADS);
+
+#ifndef HEADLESS
+	game_init_platform(window_title, game);
+#endif
+
+#ifndef EDIT_MODE
+	// controller set-up
+	game->controller_count = 1;
+	game->controllers = calloc(MAX_CONTROLLERS, sizeof(controller_state_t));	// zeroed so that the first tick is reproducible
+
+	// first level init
+	game->level = malloc(sizeof(level_t));
+	if (level_load(game->level, LEVELS_PATH "/overworld.sfml")) {
+		printd("Loaded level [overworld] [%dx%d] with [%d] spawns\n", game->level->tilemap.width, game->level->tilemap.height, game->level->spawn_count);
+	}
+	else {
+		level_init(game->level, "overworld", BLACK_SKY, 48, 16, DEFAULT_TILE_SIZE);
+	}
+#endif
+}
+
+/**
+ * Steps the simulation at a fixed rate on a thread of its own, until game_run asks it to stop. Every tick
+ * publishes a render snapshot, so the main thread never has to touch the live level to draw
+ * @param arg Game to simulate
+ */
+int game_sim_worker(void* arg) {
+	game_t* game = arg;
+	const double tick_time = 1.0 / SIM_TICK_RATE;
+	double previous_time = time_now();
+	double accumulator = 0.0;
+
+	while (!atomic_load(&game->sim_quit)) {
+		double current_time = time_now();
+		accumulator += MIN(current_time - previous_time, tick_time * SIM_MAX_TICKS_PER_FRAME);
+		previous_time = current_time;
+
+		// update at a fixed rate, catching up on whatever ticks are due
+		while (accumulator >= tick_time) {
+			game_update(game);
+			accumulator -= tick_time;
+		}
+
+		double wait = tick_time - accumulator;
+		thrd_sleep(&(struct timespec) { .tv_sec = 0, .tv_nsec = (long)(wait * 1e9) }, NULL);
+	}
+	return 0;
+}
+
+/**
+ * Runs the main loop until the window is closed. The simulation runs on its own thread (see
+ * game_sim_worker), while this one polls input, plays sounds & draws the latest render snapshot
+ * @param game Game to run
+ */
+void game_run(game_t* game) {
+#ifdef EDIT_MODE
+	GuiLoadStyleDark();
+	editor_t editor;
+	editor_init(&editor);
+	while (!WindowShouldClose()) {
+		BeginDrawing();
+		ClearBackground(BLACK);
+		editor_run(&editor);
+		EndDrawing();
+	}
+#else
+	const double tick_time = 1.0 / SIM_TICK_RATE;
+
+	// something to draw before the first tick
+	game_publish_snapshot(game);
+	atomic_store(&game->keyboard, controller_buttons_pack(controller_poll_keyboard()));
+	atomic_init(&game->sim_quit, false);
+	bool sim_threaded = thrd_create(&game->sim_thread, game_sim_worker, game) == thrd_success;
+	if (!sim_threaded) {
+		printd("Could not start the simulation thread, simulating on the main thread instead\n");
+	}
+	double previous_time = time_now();
+	double accumulator = 0.0;
+
+	while (!WindowShouldClose()) {
+		atomic_store(&game->keyboard, controller_buttons_pack(controller_poll_keyboard()));
+		if (!sim_threaded) {
+			double current_time = time_now();
+			accumulator += MIN(current_time - previous_time, tick_time * SIM_MAX_TICKS_PER_FRAME);
+			previous_time = current_time;
+			while (accumulator >= tick_time) {
+				game_update(game);
+				accumulator -= tick_time;
+			}
+		}
+		sound_play_queued();
+
+		// draw the latest tick, interpolating towards it from the one before over a tick's time
+		const render_snapshot_t* snapshot = render_snapshots_latest(game->snapshots);
+		game->render_context.interpolation = CLAMP((time_now() - snapshot->time) / tick_time, 0.0, 1.0);
+
+#ifdef DEV
+		if (IsKeyPressed(KEY_F3)) {
+			game->render_context.tile_glow = !game->render_context.tile_glow;
+		}
+		if (IsKeyPressed(KEY_F4)) {
+			game->render_context.batch_stats = !game->render_context.batch_stats;
+		}
+#endif
+		game->render_context.sprite_batch_stats = (sprite_batch_stats_t) { 0 };
+
+		// redraw anything cached that changed, before drawing the game to its render target
+		if (game->level != NULL && snapshot->has_level) {
+			level_draw_prepare(game->level, snapshot, &game->render_context);
+		}
+		hud_update(&game->hud, &game->render_context);
+
+		// draw game to render target
+		BeginTextureMode(game->render_context.render_texture);
+		if (snapshot->has_level) {
+			ClearBackground(snapshot->background_color);
+		}
+		game_draw(game, snapshot);
+		EndTextureMode();
+		if (game->capture.active) {
+			game_capture_frame(game);
+		}
+
+		// draw render target to screen
+		BeginDrawing();
+		ClearBackground(BLACK);
+
+		int window_width = GetScreenWidth();
+		int window_height = GetScreenHeight();
+
+		int render_width = game->render_context.render_texture.texture.width;
+		int render_height = game->render_context.render_texture.texture.height;
+
+		int res_scale = MIN(window_width / render_width, window_height / render_height);
+
+		Rectangle source_area = { 0, 0, render_width, -render_height };
+		Rectangle dest_area = { (int)((window_width / 2.0f) - (render_width * res_scale / 2.0f)), (int)((window_height / 2.0f) - (render_height * res_scale / 2.0f)), render_width * res_scale, -render_height * res_scale };
+
+		DrawTexturePro(game->render_context.render_texture.texture, source_area, dest_area, (Vector2) { 0, 0 }, 0, WHITE);
+		DrawTexturePro(game->render_context.hud_texture.texture, source_area, dest_area, (Vector2) { 0, 0 }, 0, WHITE);
+
+#ifdef DEV
+		if (game->render_context.batch_stats) {
+			const sprite_batch_stats_t* stats = &game->render_context.sprite_batch_stats;
+			DrawText(TextFormat("sprite batch: %d draws, %d quads, %d binds, %d dropped", stats->draw_calls, stats->quads, stats->texture_binds, stats->dropped), 4, 4, 10, GREEN);
+		}
+#endif
+		
+		EndDrawing();
+	}
+
+	if (sim_threaded) {
+		atomic_store(&game->sim_quit, true);
+		thrd_join(game->sim_thread, NULL);
+	}
+#endif
+}
+
+/**
+ * Draws a frame with the software renderer, the same as game_run draws one to the window (minus the
+ * upscale), then logs its hash, writing it out as an image every SOFT_RENDER_IMAGE_TICKS ticks
+ * @param game Game to render
+ */
+void game_render_soft(game_t* game) {
+	soft_renderer_t* soft = &game->soft;
+	Rectangle screen = { 0, 0, GAME_WIDTH, GAME_HEIGHT };
+	double start = time_now();
+
+	const render_snapshot_t* snapshot = render_snapshots_latest(game->snapshots);
+	game->render_context.sprite_batch_stats = (sprite_batch_stats_t) { 0 };
+	hud_update(&game->hud, &game->render_context);
+	soft_begin(soft, &soft->framebuffer);
+	soft_clear(soft, snapshot->has_level ? snapshot->background_color : BLANK);
+	game_draw(game, snapshot);
+	soft_draw_quad(soft, &soft->hud, screen, screen, WHITE, BLEND_ALPHA);
+
+	game->render_time += time_now() - start;
+	++game->frames_rendered;
+	if (game->capture.active) {
+		game_capture_frame(game);
+	}
+
+	uint64_t hash = hash_bytes(0, soft->framebuffer.data, GAME_WIDTH * GAME_HEIGHT * sizeof(Color));
+	fprintf(game->frame_log, "%ld %016llx\n", game->tick, (unsigned long long)hash);
+	if (game->tick % SOFT_RENDER_IMAGE_TICKS == 0) {
+		ExportImage(soft->framebuffer, TextFormat("%s/frame_%06ld.png", game->frame_dir, game->tick));
+	}
+}
+
+/**
+ * Steps the simulation a fixed number of ticks as fast as possible, without a window or audio,
+ * and reports the raw tick rate
+ * @param game	Game to run
+ * @param ticks	Number of ticks to simulate
+ */
+void game_run_headless(game_t* game, long ticks) {
+	double start = time_now();
+	for (long i = 0; i < ticks; ++i) {
+		game_update(game);
+		if (game->render_context.soft != NULL) {
+			game_render_soft(game);
+		}
+		if (game->playback.finished) {
+			ticks = i + 1;
+			break;
+		}
+	}
+	double elapsed = time_now() - start;
+
+	printf("Simulated [%ld] ticks in [%.3f] s ([%.0f] ticks/s)\n", ticks, elapsed, ticks / MAX(elapsed, 1e-9));
+	printf("Final state hash [%016llx]\n", (unsigned long long)game->state_hash);
+	if (game->level != NULL) {
+		printf("Player ended at [%.2f, %.2f]\n", game->level->player.body.x, game->level->player.body.y);
+	}
+	if (game->frames_rendered > 0) {
+		printf("Rendered [%ld] frames in software in [%.3f] s ([%.1f] us per frame)\n",
+			game->frames_rendered, game->render_time, game->render_time * 1e6 / game->frames_rendered);
+	}
+}
+
+void game_end(game_t* game) {
+	input_recorder_close(&game->recorder);
+	input_playback_close(&game->playback);
+	if (game->hash_log != NULL) {
+		fclose(game->hash_log);
+	}
+	job_system_free(&game->jobs);
+	frame_capture_close(&game->capture);
+	free(game->render_context.sprite_batch);
+	free(game->render_context.sprite_batch_sorted);
+	hud_free(&game->hud);
+	if (game->render_context.soft != NULL) {
+		soft_renderer_free(&game->soft);
+		tile_atlas_free();
+	}
+	if (game->frame_log != NULL) {
+		fclose(game->frame_log);
+	}
+	free(game->snapshots);
+
+#ifndef HEADLESS
+	for (int i = 0; i < game->render_context.sprite_atlas_pages; ++i) {
+		UnloadTexture(game->render_context.sprite_atlas[i]);
+	}
+	tile_atlas_free();
+#ifndef EDIT_MODE
+	UnloadRenderTexture(game->render_context.render_texture);
+	UnloadRenderTexture(game->render_context.hud_texture);
+	if (game->render_context.capture_texture.id != 0) {
+		UnloadRenderTexture(game->render_context.capture_texture);
+	}
+#endif
+#endif
+
+	if (game->controllers != NULL) {
+		free(game->controllers);
+	}
+
+	if (game->level != NULL) {
+		level_free(game->level);
+		free(game->level);
+	}
+
+#ifndef HEADLESS
+	CloseWindow();
+#endif
+}
+
+#pragma endregion
+
+#pragma region Level Update & Draw
+
+/**
+ * Updates every active entity: first activation around the camera, then thinking (bodies & behavior)
+ * across the job system and committing the results, then collisions between entities & with the player
+ * @param level	Level to update
+ * @param jobs	Job system to think on
+ */
+void level_update_entities(level_t* level, job_system_t* jobs) {
+	level_activate_entities(level);
+
+	// thinking only reads the tilemap, so the occupancy cache is brought up to date around the active entities first
+	int tile_size = level->tilemap.tile_size;
+	int margin = ENTITY_SLEEP_MARGIN + 1;
+	tilemap_update_occupancy(&level->tilemap, level->camera.x / tile_size - margin, (level->camera.x + level->camera.width) / tile_size + margin + 1);
+
+	level_think_entities(level, jobs);
+	level_commit_entities(level);
+	broadphase_build(&level->broadphase, level->entities, BROADPHASE_CELL_TILES * tile_size);
+	broadphase_pairs(&level->broadphase, entity_collide, level);
+	broadphase_query(&level->broadphase, physics_body_get_rectangle(&level->player.body), player_collide, level);
+}
+
+void camera_set_position(camera_t* camera, int x, int y) {
+	camera->x_prev = camera->x;
+	camera->y_prev = camera->y;
+	camera->x = CLAMP(x + camera->offset_x, camera->bounds_x1, camera->bounds_x2 - camera->width);
+	camera->y = CLAMP(y + camera->offset_y, camera->bounds_y1, camera->bounds_y2 - camera->height);
+}
+
+void level_update(level_t* level, game_t* game) {
+	if (level->tilemap.stream != NULL) {
+		int center_x = (level->camera.x + level->camera.width / 2) / level->tilemap.tile_size;
+		tilemap_stream_update(&level->tilemap, center_x, level->player.body.xspd);
+	}
+	player_update(&level->player, level, &game->controllers[0]);
+	level_update_entities(level, &game->jobs);
+	camera_set_position(&level->camera, level->player.body.x, level->player.body.y);
+}
+
+/**
+ * Fills a snapshot in with what there is to draw of a level, as of the end of the tick just simulated
+ * @param level		Level to snapshot
+ * @param snapshot	Snapshot to fill in
+ */
+void level_snapshot(const level_t* level, render_snapshot_t* snapshot) {
+	const camera_t* camera = &level->camera;
+	const player_t* player = &level->player;
+	snapshot->has_level = true;
+	snapshot->camera_x = camera->x;
+	snapshot->camera_y = camera->y;
+	snapshot->camera_x_prev = camera->x_prev;
+	snapshot->camera_y_prev = camera->y_prev;
+	snapshot->background_color = level->background_color;
+	snapshot->tile_size = level->tilemap.tile_size;
+
+	snapshot->player = render_body_from(&player->body);
+	snapshot->player_sprite = (player->sprites_index == NULL) ? NULL : &player->sprites_index[player->is_big];
+	snapshot->player_image_index = player->image_index;
+	snapshot->player_origin_x = player->body.origin_x;
+	snapshot->player_origin_y = player->body.origin_y;
+	snapshot->player_flip_x = player->flip_x;
+
+	// whatever the camera can show between last tick & this one
+	Rectangle view = {
+		MIN(camera->x, camera->x_prev), MIN(camera->y, camera->y_prev),
+		abs(camera->x - camera->x_prev) + GAME_WIDTH, abs(camera->y - camera->y_prev) + GAME_HEIGHT
+	};
+
+	snapshot->entity_count = 0;
+	snapshot->entities_dropped = 0;
+	for (int type = 0; type < ENTITY_COUNT; ++type) {
+		const entity_pool_t* pool = &level->entities[type];
+		if (entity_classes[type].draw == NULL) {
+			continue;
+		}
+		for (int i = 0; i < pool->active_count; ++i) {
+			physics_body_t body = physics_bodies_get(&pool->bodies, i);
+			Rectangle bounds = physics_body_get_rectangle(&body);
+			// padded by how far it moved, so it's still caught while interpolating in from out of view
+			Rectangle reach = { bounds.x - fabsf(body.x - body.x_prev), bounds.y - fabsf(body.y - body.y_prev), bounds.width + fabsf(body.x - body.x_prev) * 2, bounds.height + fabsf(body.y - body.y_prev) * 2 };
+			if (!rectangle_collision(reach, view)) {
+				continue;
+			}
+			if (snapshot->entity_count == RENDER_SNAPSHOT_ENTITIES) {
+				++snapshot->entities_dropped;
+				continue;
+			}
+			snapshot->entities[snapshot->entity_count++] = (render_entity_t) { type, render_body_from(&body) };
+		}
+	}
+
+	int cx1, cy1, cx2, cy2, last_cx1, last_cy1, last_cx2, last_cy2;
+	tile_layer_view_chunks(&level->tilemap, camera->x, camera->y, &cx1, &cy1, &cx2, &cy2);
+	tile_layer_view_chunks(&level->tilemap, camera->x_prev, camera->y_prev, &last_cx1, &last_cy1, &last_cx2, &last_cy2);
+	snapshot->chunk_count = 0;
+	snapshot->chunks_dropped = 0;
+	for (int cy = MIN(cy1, last_cy1); cy <= MAX(cy2, last_cy2); ++cy) {
+		for (int cx = MIN(cx1, last_cx1); cx <= MAX(cx2, last_cx2); ++cx) {
+			if (snapshot->chunk_count == RENDER_SNAPSHOT_CHUNKS) {
+				++snapshot->chunks_dropped;
+				continue;
+			}
+			render_chunk_t* chunk = &snapshot->chunks[snapshot->chunk_count++];
+			chunk->chunk_x = cx;
+			chunk->chunk_y = cy;
+			chunk->revision = tilemap_chunk_revision(&level->tilemap, cx, cy);
+			for (int y = 0; y < TILEMAP_CHUNK_SIZE; ++y) {
+				for (int x = 0; x < TILEMAP_CHUNK_SIZE; ++x) {
+					chunk->collision[y * TILEMAP_CHUNK_SIZE + x] = tilemap_get(&level->tilemap, cx * TILEMAP_CHUNK_SIZE + x, cy * TILEMAP_CHUNK_SIZE + y).collision;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Updates the level's render caches for the coming frame. Must be called outside of texture mode
+ * @param level		Level to prepare
+ * @param snapshot	Snapshot to be drawn
+ * @param context	Current rendering context
+ */
+void level_draw_prepare(level_t* level, const render_snapshot_t* snapshot, render_context_t* context) {
+	tile_layer_update(&level->tile_layer, snapshot->chunks, snapshot->chunk_count, snapshot->tile_size);
+}
+
+/**
+ * Draws a snapshot of a level. Only the level's render resources (background & tile layer) are used,
+ * so this is safe while the simulation updates the level on another thread
+ * @param level		Level the snapshot is of
+ * @param snapshot	Snapshot to draw
+ * @param context	Current rendering context
+ */
+void level_draw(level_t* level, const render_snapshot_t* snapshot, render_context_t* context) {
+	// camera & player positions interpolated between the last two ticks
+	Vector2 cam_pos = camera_get_render_position(snapshot, context);
+	int cam_x = cam_pos.x, cam_y = cam_pos.y;
+	Vector2 player_pos = render_body_position(&snapshot->player, context);
+
+	level->background.x = -cam_x;
+	level->background.y = ((float)(-cam_y) / 2.0f) - 128;
+	background_draw(&level->background, context);
+
+	// localize camera space coordinates to local coordinates by offsetting the current model matrix
+	render_translate_begin(context, -cam_x, -cam_y);
+
+	tile_layer_draw(&level->tile_layer, snapshot->chunks, snapshot->chunk_count, snapshot->tile_size, cam_x, cam_y, context);
+
+	// debug glow, limited to the tiles in reach of the player
+	int tile_size = snapshot->tile_size;
+	int glow_tile_x1 = MAX(cam_x / tile_size, (int)floorf((player_pos.x - TILE_GLOW_RADIUS) / tile_size));
+	int glow_tile_x2 = MIN((int)((cam_x + GAME_WIDTH) / (float)tile_size), (int)floorf((player_pos.x + TILE_GLOW_RADIUS) / tile_size));
+	int glow_tile_y1 = MAX(cam_y / tile_size, (int)floorf((player_pos.y - TILE_GLOW_RADIUS) / tile_size));
+	int glow_tile_y2 = MIN((int)((cam_y + GAME_HEIGHT) / (float)tile_size), (int)floorf((player_pos.y + TILE_GLOW_RADIUS) / tile_size));
+
+	// queued with the sprites, which sorts the additive fills after (over) all of the outlines
+	for (int i = glow_tile_x1; i <= glow_tile_x2 && context->tile_glow; ++i) {
+		for (int j = glow_tile_y1; j <= glow_tile_y2; ++j) {
+			collision_type_t tile_type = render_snapshot_tile(snapshot, i, j);
+			if (tile_type != COLLISION_AIR) {
+				float alpha = 1.0f - CLAMP(distance(player_pos.x, player_pos.y, (i * tile_size) + (tile_size / 2.0f), (j * tile_size) + (tile_size / 2.0f)) / TILE_GLOW_RADIUS, 0.0f, 1.0f);
+				Rectangle rect = { i * (float)tile_size, j * (float)tile_size, (float)tile_size, (float)tile_size };
+				sprite_batch_rectangle_lines(rect, 1, (Color) { 0, 200, 255, (const char)((alpha * 128.0f)) }, context);
+				sprite_batch_rectangle(rect, (Color) { 0, 128, 255, (const char)((alpha * 128.0f)) }, BLEND_ADDITIVE, context);
+			}
+		}
+	}
+
+	for (int i = 0; i < snapshot->entity_count; ++i) {
+		const render_entity_t* entity = &snapshot->entities[i];
+		entity_classes[entity->type].draw(entity, context);
+	}
+
+	player_draw(snapshot, context);
+	sprite_batch_flush(context);
+
+	render_translate_end(context);
+}
+
+#pragma endregion
 
-	// start window
-	SetTraceLogLevel(LOG_NONE);
-#ifdef EDIT_MODE
-#endif
-	SetConfigFlags(FLAG_WINDOW_RESIZABLE);
-	InitWindow(256, 224, window_title);
-	InitAudioDevice();
-#ifdef EDIT_MODE
-	SetTargetFPS(120);
-#else
-	SetTargetFPS(60);
-#endif
+#pragma region Player Functions
 
-	Image icon = LoadImage("assets/icon_editor.png");
-	SetWindowIcon(icon);
-	UnloadImage(icon);
+void player_init(player_t* player) {
+	*player = (player_t) {
+        .sprites_index = mario_sprites.idle,
+        .is_big = true
+    };
+	physics_body_init(&player->body, 8, 18);
+}
 
-	// atlas image
-	// todo: asset loading automation!
-	{
-		Image atlas_img = GenImageColor(TEXTURE_ATLAS_WIDTH, TEXTURE_ATLAS_HEIGHT, (Color) { 255, 255, 255, 0 });
+inline sprite_t* player_get_sprite(player_t* player) {
+	return (player->sprites_index == NULL) ? NULL : &player->sprites_index[player->is_big];
+}
 
-		stbrp_context rect_packer;
-		stbrp_node* nodes = malloc(sizeof(stbrp_node) * MAX_TEXTURE_NODES);
-		stbrp_init_target(&rect_packer, TEXTURE_ATLAS_WIDTH, TEXTURE_ATLAS_HEIGHT, nodes, MAX_TEXTURE_NODES);
+void player_animate(player_t* player, controller_state_t* controller) {
+	// crouch
+	if (player->is_crouching) {
+		player->sprites_index = mario_sprites.crouch;
+		player->image_index = 0;
+		return;
+	}
+
+	// jump
+	if (!player->body.grounded) {
+		player->sprites_index = mario_sprites.jump;
+		player->image_index = player->body.yspd > 0 ? 1 : 0;
+		return;
+	}
+
+	// skid
+	if (controller->current.h * player->body.xspd < 0.0f) {
+		player->sprites_index = mario_sprites.skid;
+		return;
+	}
+
+	// walk
+	if (player->body.xspd != 0.0f) {
+		player->sprites_index = mario_sprites.walk;
+		player->image_index += MAX(0.125f, fabsf(player->body.xspd) / 6.0f);
+		return;
+	}
 
-		sprite_init("mario.idle_small",	&mario_sprites.idle[POWERUP_SMALL],	&atlas_img, &rect_packer);
-		sprite_init("mario.walk_small",	&mario_sprites.walk[POWERUP_SMALL],	&atlas_img, &rect_packer);
-		sprite_init("mario.run_small", 	&mario_sprites.run[POWERUP_SMALL], 	&atlas_img, &rect_packer);
-		sprite_init("mario.jump_small",	&mario_sprites.jump[POWERUP_SMALL],	&atlas_img, &rect_packer);
-		sprite_init("mario.skid_small",	&mario_sprites.skid[POWERUP_SMALL],	&atlas_img, &rect_packer);
+	// idle
+	player->sprites_index = mario_sprites.idle;
+	player->image_index = (controller->current.v < 0) ? 1 : 0;
+}
 
-		sprite_init("mario.idle_big", 	&mario_sprites.idle[POWERUP_BIG], 	&atlas_img, &rect_packer);
-		sprite_init("mario.crouch_big", &mario_sprites.crouch[POWERUP_BIG], &atlas_img, &rect_packer);
-		sprite_init("mario.walk_big", 	&mario_sprites.walk[POWERUP_BIG], 	&atlas_img, &rect_packer);
-		sprite_init("mario.run_big", 	&mario_sprites.run[POWERUP_BIG], 	&atlas_img, &rect_packer);
-		sprite_init("mario.jump_big", 	&mario_sprites.jump[POWERUP_BIG], 	&atlas_img, &rect_packer);
-		sprite_init("mario.skid_big", 	&mario_sprites.skid[POWERUP_BIG], 	&atlas_img, &rect_packer);
+void player_draw(const render_snapshot_t* snapshot, render_context_t* context) {
+	Vector2 pos = render_body_position(&snapshot->player, context);
+	const sprite_t* sprite_index = snapshot->player_sprite;
+	if (sprite_index != NULL) {
+		sprite_draw_ex((sprite_t*)sprite_index, snapshot->player_image_index, pos.x, pos.y + 1, sprite_index->width * snapshot->player_origin_x, sprite_index->height * snapshot->player_origin_y, snapshot->player_flip_x, false, context);
+	}
+
+	sprite_batch_rectangle_lines(render_body_bounds(&snapshot->player, context), 1, RED, context);
+	sprite_batch_rectangle((Rectangle) { floorf(pos.x), floorf(pos.y), 1, 1 }, BLUE, BLEND_ALPHA, context);
+}
 
-		font_init("font.hud", "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.,*-!@|=:", &fnt_hud, &atlas_img, &rect_packer);
-		fnt_hud.spacing = 0;
+void player_jump(player_t* player) {
+	float variable_jump = (fabsf(player->body.xspd / PLAYER_RUN_SPEED)) * 1.0f; // normalize jump between 0 and 1 based on player speed from walk to full height
+	player->body.yspd = -PLAYER_JUMP - variable_jump;
+	sound_play(SOUND_JUMP);
+}
 
-		free(nodes);
+void player_move(player_t* player, level_t* level, controller_state_t* controller) {
+	// A lower gravity is used to make the player jump higher if the player is variable jumping
+	player->body.grav = (controller->current.a) ? PLAYER_GRAVITY_HOLD : PLAYER_GRAVITY;
 
-		game->render_context.sprite_atlas = LoadTextureFromImage(atlas_img);
+	if (player->body.grounded && controller->current.a && !controller->previous.a) {
+		player_jump(player);
+	}
 
-		ExportImage(atlas_img, "sprite_atlas_dump.png");
-		UnloadImage(atlas_img);
+	if (player->body.grounded) {
+		if (controller->current.v > 0) {
+			if (!player->is_crouching) {
+				player->is_crouching = true;
+				player->body.height = 10;
+			}
+			controller->current.h = 0;
+		}
+		else {
+			if (player->is_crouching) {
+				player->is_crouching = false;
+				player->body.height = 18;
+			}
+		}
 	}
-	{
-		Image atlas_img = GenImageColor(TILE_ATLAS_WIDTH, TILE_ATLAS_HEIGHT, (Color) { 255, 255, 255, 0 });
 
-		stbrp_context rect_packer;
-		stbrp_node* nodes = malloc(sizeof(stbrp_node) * MAX_TEXTURE_NODES);
-		stbrp_init_target(&rect_packer, TILE_ATLAS_WIDTH, TILE_ATLAS_HEIGHT, nodes, MAX_TEXTURE_NODES);
+	float h = controller->current.h;
+	float traction = 1.0f; // ice would be something like 0.2 for snowy levels
 
-		const char* tilesets[2] = { "glade", "ice" };
-		const int tile_size = DEFAULT_TILE_SIZE;
-		for (int i = 0; i < 2; ++i) {
-			Image tls = LoadImage(TextFormat("assets/tiles/%s.png", tilesets[i]));
-			for (int i = 0; i < tls.width / tile_size; ++i) {
-				for (int j = 0; j < tls.height / tile_size; ++j) {
-					bool has_img_data = false;
-					for (int x = 0; x < tile_size; ++x) {
-						for (int y = 0; y < tile_size; ++y) {
-							Color c_at = GetImageColor(tls, (i * tile_size) + x, (j * tile_size) + y);
-							if (c_at.a != 0) {
-								has_img_data = true;
-							}
-						}
+	// player speed can be changed any time on ground, or when the player is in the air and sign of input = spd
+	if ((player->body.grounded) || ((!player->body.grounded && h * player->body.xspd >= 0))) {
+		if (controller->current.b && fabsf(player->body.xspd) >= PLAYER_WALK_SPEED && h * player->body.xspd > 0) {
+			player->body.xspd_max = PLAYER_RUN_SPEED;
+		}
+		else {
+			player->body.xspd_max = PLAYER_WALK_SPEED;
+		}
+	}
+	else {
+		player->body.xspd_max = 0.0f;
+	}
+
+	// horizontal input when less than max speed
+	if (h != 0) {
+		if (h * player->body.xspd < player->body.xspd_max) {
+			player->flip_x = (h < 0) ? true : false;
+			// normal forward acceleration
+			if (h * player->body.xspd > 0) {
+				player->body.xspd += h * PLAYER_ACCEL;
+			}
+			// skidding
+			else {
+				// ground skid
+				if (player->body.grounded) {
+					// multiplies the turn speed by an amount
+					float skid_factor = 1.0f;
+					float current_xspd = fabsf(player->body.xspd);
+					if (current_xspd <= PLAYER_WALK_SPEED) {
+						skid_factor = 1.0f;
 					}
-					if (!has_img_data) {
-						continue;
+					else if (current_xspd <= PLAYER_RUN_SPEED) {
+						skid_factor = 2.0f;
 					}
-					stbrp_rect r = { .w = tile_size, .h = tile_size };
-					if (stbrp_pack_rects(&rect_packer, &r, 1)) {
-						ImageDraw(&atlas_img, tls, (Rectangle) { (i * tile_size), (j * tile_size), tile_size, tile_size }, (Rectangle) { r.x, r.y, tile_size, tile_size }, WHITE);
+					else if (current_xspd > PLAYER_RUN_SPEED) {
+						skid_factor = 4.0f;
 					}
+					player->body.xspd += h * (PLAYER_TURN * skid_factor * traction);
+				}
+				else if (h * player->body.xspd > -PLAYER_WALK_SPEED) {
+					player->body.xspd += h * PLAYER_TURN;
+				}
+				else {
+					player->body.xspd += h * (PLAYER_TURN_AIR * 2);
 				}
 			}
 		}
-
-		free(nodes);
-
-		ExportImage(atlas_img, "tile_atlas_dump.png");
-		UnloadImage(atlas_img);
 	}
-
-#ifdef EDIT_MODE
-	GuiLoadStyleDark();
-	editor_t editor;
-	editor_init(&editor);
-	while (!WindowShouldClose()) {
-		BeginDrawing();
-		ClearBackground(BLACK);
-		editor_run(&editor);
-		EndDrawing();
+	// no input held down- slow player
+	else if (player->body.xspd != 0) {
+		float xspd_dir = (player->body.xspd > 0) ? 1.0f : -1.0f; // which way the player is moving
+		player->body.xspd -= ((player->body.grounded) ? PLAYER_DECEL : PLAYER_DECEL_AIR) * xspd_dir;
+		if (player->body.xspd * xspd_dir < 0) {
+			player->body.xspd = 0;
+		}
 	}
-#else
-	sounds = (struct sounds) {
-		.bump = LoadSound("assets/sounds/bump.wav"),
-		.jump = LoadSound("assets/sounds/jump.wav")
-	};
 
-	// initialization would be something like this for an entity:
-	entity_goomba_t goomba = (entity_goomba_t){
-		.base = {
-			.id = 1,
-			.type = ENTITY_GOOMBA,
-			.update = goomba_update,
-			.draw = goomba_draw
-		}
-	};
+	physics_body_update(&player->body, &level->tilemap);
+}
 
-	// controller set-up
-	game->controller_count = 1;
-	game->controllers = malloc(MAX_CONTROLLERS * sizeof(controller_state_t));
+void player_update(player_t* player, level_t* level, controller_state_t* controller) {
+	player_move(player, level, controller);
+	player_animate(player, controller);
+}
 
-	// first level init
-	game->level = malloc(sizeof(level_t));
-	level_init(game->level, "overworld", BLACK_SKY, 48, 16, DEFAULT_TILE_SIZE);
+#pragma endregion
 
-	// create rendering surface 
-	game->render_context.render_texture = LoadRenderTexture(GAME_WIDTH, GAME_HEIGHT);
-	RenderTexture hud_texture = LoadRenderTexture(GAME_WIDTH, GAME_HEIGHT);
+#pragma region Benchmarks
 
-	while (!WindowShouldClose()) {
-		// update
-		game_update(game);
+/*
+ * Micro-benchmarks for the simulation core, run with `--bench <name>`. They don't need a window,
+ * so they're meant to be run from the headless target.
+ */
 
-		// draw game to render target
-		BeginTextureMode(game->render_context.render_texture);
-		if (game->level != NULL) {
-			ClearBackground(game->level->background_color);
+// keeps benchmark results observable so the compiler can't drop the work being measured
+volatile uint64_t bench_sink;
+
+/**
+ * Fills a tilemap with rough terrain: uneven solid ground along the bottom, with random platforms above it
+ * @param map Tilemap to fill
+ */
+void bench_fill_terrain(tilemap_t* map) {
+	rng_seed(1);
+	for (int x = 0; x < map->width; ++x) {
+		int ground = map->height - 1 - (int)RAND_INT(0, 8);
+		for (int y = ground; y < map->height; ++y) {
+			tilemap_set(map, x, y, (tile_t) { .collision = COLLISION_SOLID });
 		}
-		game_draw(game);
-		EndTextureMode();
+		if (RAND_INT(0, 3) == 0) {
+			tilemap_set(map, x, ground - (int)RAND_INT(3, 6), (tile_t) { .collision = COLLISION_PLATFORM });
+		}
+	}
+}
 
-		BeginTextureMode(hud_texture);
-		ClearBackground((Color) { 0 });
-		EndTextureMode();
+/**
+ * Checks that a rectangle is clear of every tile with collision, edges included
+ * @param map	Tilemap to check
+ * @param rect	World space rectangle
+ */
+bool bench_rectangle_clear(const tilemap_t* map, Rectangle rect) {
+	int x1 = floor_to_int(rect.x / map->tile_size), x2 = floor_to_int((rect.x + rect.width) / map->tile_size);
+	int y1 = floor_to_int(rect.y / map->tile_size), y2 = floor_to_int((rect.y + rect.height) / map->tile_size);
+	for (int y = y1; y <= y2; ++y) {
+		for (int x = x1; x <= x2; ++x) {
+			if (tilemap_get(map, x, y).collision != COLLISION_AIR) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
 
-		// draw render target to screen
-		BeginDrawing();
-		ClearBackground(BLACK);
+void bench_tilemap(void) {
+	const int width = 10000, height = 1000;
+	const long lookups = 50000000;
+
+	tilemap_t map;
+	double start = time_now();
+	tilemap_init(&map, width, height, DEFAULT_TILE_SIZE);
+	double init_time = time_now() - start;
+
+	start = time_now();
+	bench_fill_terrain(&map);
+	double fill_time = time_now() - start;
+
+	printf("Tilemap [%dx%d]: [%.2f] MiB tile data (column-per-x layout would be [%.2f] MiB)\n", width, height,
+		tilemap_data_size(&map) / (1024.0 * 1024.0),
+		((size_t)width * sizeof(tile_t*) + (size_t)width * height * sizeof(tile_t)) / (1024.0 * 1024.0));
+	printf("  init [%.3f] ms, fill [%.3f] ms\n", init_time * 1000.0, fill_time * 1000.0);
+
+	// random lookups across the whole map
+	uint64_t sum = 0;
+	uint32_t seed = 12345;
+	start = time_now();
+	for (long i = 0; i < lookups; ++i) {
+		seed = seed * 1664525u + 1013904223u;
+		sum += tilemap_get(&map, (seed >> 8) % width, (seed >> 4) % height).collision;
+	}
+	double elapsed = time_now() - start;
+	printf("  random lookups:     [%.1f] M/s\n", lookups / elapsed / 1e6);
+
+	// collision-window style lookups: a small neighborhood around a body walking along the map
+	start = time_now();
+	long window_lookups = 0;
+	for (long i = 0; window_lookups < lookups; ++i) {
+		int bx = (int)(i % (width - 4)), by = height - 12 + (int)(i % 8);
+		for (int y = by - 1; y <= by + 2; ++y) {
+			for (int x = bx - 1; x <= bx + 2; ++x) {
+				sum += tilemap_get(&map, x, y).collision;
+			}
+		}
+		window_lookups += 16;
+	}
+	elapsed = time_now() - start;
+	printf("  windowed lookups:   [%.1f] M/s\n", window_lookups / elapsed / 1e6);
+
+	// full scan, as a renderer or level saver would
+	start = time_now();
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			sum += tilemap_get(&map, x, y).collision;
+		}
+	}
+	elapsed = time_now() - start;
+	printf("  row-major scan:     [%.1f] M/s\n", ((double)width * height) / elapsed / 1e6);
 
-		int window_width = GetScreenWidth();
-		int window_height = GetScreenHeight();
+	bench_sink = sum;
+	tilemap_free(&map);
+}
 
-		int render_width = game->render_context.render_texture.texture.width;
-		int render_height = game->render_context.render_texture.texture.height;
+void bench_physics(void) {
+	const int body_count = 1000, ticks = 2000;
+	const int sizes[][2] = { { 8, 16 }, { 32, 32 }, { 128, 128 } };
+
+	tilemap_t map;
+	tilemap_init(&map, 4096, 64, DEFAULT_TILE_SIZE);
+	bench_fill_terrain(&map);
+	tilemap_update_occupancy(&map, 0, map.width);
+	physics_body_t* bodies = malloc(body_count * sizeof(physics_body_t));
+	physics_bodies_t batch = { 0 };
+	physics_bodies_reserve(&batch, body_count);
+
+	for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+		rng_seed(2);
+		for (int i = 0; i < body_count; ++i) {
+			physics_body_init(&bodies[i], sizes[s][0], sizes[s][1]);
+			bodies[i].x = RAND_INT(0, map.width * map.tile_size);
+			bodies[i].y = RAND_INT(0, 40 * map.tile_size);
+			bodies[i].xspd = (RAND_INT(0, 1) ? 1.0f : -1.0f) * PLAYER_RUN_SPEED;
+			physics_bodies_set(&batch, i, &bodies[i]);
+		}
 
-		int res_scale = MIN(window_width / render_width, window_height / render_height);
+		double start = time_now();
+		for (int t = 0; t < ticks; ++t) {
+			for (int i = 0; i < body_count; ++i) {
+				// walk back and forth, hopping whenever grounded
+				physics_body_t* body = &bodies[i];
+				if (body->xspd == 0.0f) {
+					body->xspd = ((t + i) & 1) ? PLAYER_RUN_SPEED : -PLAYER_RUN_SPEED;
+				}
+				if (body->grounded && ((t + i) & 63) == 0) {
+					body->yspd = -PLAYER_JUMP;
+				}
+				physics_body_update(body, &map);
+			}
+		}
+		double elapsed = time_now() - start;
+		printf("Physics [%d] bodies of [%dx%d] px: [%.1f] M body updates/s ([%.1f] ns each)\n", body_count, sizes[s][0], sizes[s][1],
+			(double)body_count * ticks / elapsed / 1e6, elapsed * 1e9 / ((double)body_count * ticks));
+
+		// the same walk as parallel arrays, updated in batches
+		start = time_now();
+		for (int t = 0; t < ticks; ++t) {
+			for (int i = 0; i < body_count; ++i) {
+				if (batch.xspd[i] == 0.0f) {
+					batch.xspd[i] = ((t + i) & 1) ? PLAYER_RUN_SPEED : -PLAYER_RUN_SPEED;
+				}
+				if (batch.grounded[i] && ((t + i) & 63) == 0) {
+					batch.yspd[i] = -PLAYER_JUMP;
+				}
+			}
+			physics_bodies_update(&batch, body_count, &map);
+		}
+		elapsed = time_now() - start;
+		int mismatches = 0;
+		for (int i = 0; i < body_count; ++i) {
+			physics_body_t body = physics_bodies_get(&batch, i);
+			mismatches += (physics_body_hash(0, &body) != physics_body_hash(0, &bodies[i]));
+		}
+		printf("  batched: [%.1f] M body updates/s ([%.1f] ns each), [%d] bodies differing from unbatched\n",
+			(double)body_count * ticks / elapsed / 1e6, elapsed * 1e9 / ((double)body_count * ticks), mismatches);
+	}
 
-		Rectangle source_area = { 0, 0, render_width, -render_height };
-		Rectangle dest_area = { (int)((window_width / 2.0f) - (render_width * res_scale / 2.0f)), (int)((window_height / 2.0f) - (render_height * res_scale / 2.0f)), render_width * res_scale, -render_height * res_scale };
+	// bodies mostly out in the open, where the chunk check skips collision resolution
+	rng_seed(2);
+	tilemap_t sparse;
+	tilemap_init(&sparse, 4096, 64, DEFAULT_TILE_SIZE);
+	for (int x = 0; x < sparse.width; x += 256) {
+		tilemap_set(&sparse, x, 63, (tile_t) { .collision = COLLISION_SOLID });
+	}
+	tilemap_update_occupancy(&sparse, 0, sparse.width);
+	for (int i = 0; i < body_count; ++i) {
+		physics_body_t body;
+		physics_body_init(&body, 8, 16);
+		body.x = RAND_INT(0, sparse.width * sparse.tile_size);
+		body.grav = 0.0f;
+		body.xspd = PLAYER_WALK_SPEED;
+		bodies[i] = body;
+		physics_bodies_set(&batch, i, &body);
+	}
+	double start = time_now();
+	for (int t = 0; t < ticks; ++t) {
+		for (int i = 0; i < body_count; ++i) {
+			physics_body_update(&bodies[i], &sparse);
+		}
+	}
+	double unbatched = time_now() - start;
+	start = time_now();
+	for (int t = 0; t < ticks; ++t) {
+		physics_bodies_update(&batch, body_count, &sparse);
+	}
+	double batched = time_now() - start;
+	printf("Physics [%d] floating bodies: [%.1f] ns each unbatched, [%.1f] ns each batched\n", body_count,
+		unbatched * 1e9 / ((double)body_count * ticks), batched * 1e9 / ((double)body_count * ticks));
+
+	tilemap_free(&sparse);
+	physics_bodies_free(&batch);
+	free(bodies);
+	tilemap_free(&map);
+}
 
-		DrawTexturePro(game->render_context.render_texture.texture, source_area, dest_area, (Vector2) { 0, 0 }, 0, WHITE);
-		
-		EndDrawing();
+void bench_sweep(void) {
+	const int body_count = 1000, ticks = 1000, rays = 1000000;
+	const float speeds[] = { 1.0f, 4.0f, 16.0f, 48.0f };
+
+	// terrain with thin walls to tunnel through
+	tilemap_t map;
+	tilemap_init(&map, 4096, 64, DEFAULT_TILE_SIZE);
+	bench_fill_terrain(&map);
+	for (int x = 0; x < map.width; x += 24) {
+		for (int y = 20; y < 50; ++y) {
+			tilemap_set(&map, x, y, (tile_t) { .collision = COLLISION_SOLID });
+		}
+	}
+	physics_body_t* bodies = malloc(body_count * sizeof(physics_body_t));
+
+	for (int s = 0; s < sizeof(speeds) / sizeof(speeds[0]); ++s) {
+		// the current routines (resolving where a move ends up), then sweeping, each timed & then checked for tunneling
+		double times[2];
+		long tunneled[2];
+		for (int swept = 0; swept < 2; ++swept) {
+			for (int pass = 0; pass < 2; ++pass) {
+				rng_seed(7);
+				for (int i = 0; i < body_count; ++i) {
+					physics_body_t* body = &bodies[i];
+					physics_body_init(body, 8, 16);
+					body->grav = 0.0f;
+					body->xspd_max = body->yspd_max = 1000.0f;
+					// whole bounds clear of solids, so nothing starts out already inside a wall
+					do {
+						body->x = RAND_INT(0, map.width * map.tile_size);
+						body->y = RAND_INT(16 * map.tile_size, 50 * map.tile_size);
+					} while (!bench_rectangle_clear(&map, physics_body_get_rectangle(body)));
+				}
+				long hits = 0;
+				double start = time_now();
+				for (int t = 0; t < ticks; ++t) {
+					for (int i = 0; i < body_count; ++i) {
+						physics_body_t* body = &bodies[i];
+						if (body->xspd == 0.0f) {
+							body->xspd = ((t + i) & 1) ? speeds[s] : -speeds[s];
+						}
+						if (body->yspd == 0.0f) {
+							body->yspd = ((t + i) & 2) ? speeds[s] * 0.5f : -speeds[s] * 0.5f;
+						}
+						body->x_prev = body->x;
+						body->y_prev = body->y;
+						if (swept) {
+							physics_body_move_x(body, &map);
+							physics_body_move_y(body, &map);
+						}
+						else {
+							body->x += body->xspd;
+							resolve_collisions_x(body, &map);
+							body->y += body->yspd;
+							resolve_collisions_y(body, &map);
+						}
+						if (pass == 1) {
+							// the body's center passing through a solid tile (moving along x, then y) means it went through a wall
+							Vector2 corner = { body->x, body->y_prev - 8 };
+							hits += tilemap_raycast(&map, (Vector2) { body->x_prev, body->y_prev - 8 }, corner, NULL) ||
+								tilemap_raycast(&map, corner, (Vector2) { body->x, body->y - 8 }, NULL);
+						}
+					}
+				}
+				if (pass == 0) {
+					times[swept] = time_now() - start;
+				}
+				tunneled[swept] = hits;
+			}
+		}
+		double updates = (double)body_count * ticks;
+		printf("Sweep [%.0f] px per tick: resolve [%.1f] ns per body, [%ld] tunneled; swept [%.1f] ns per body, [%ld] tunneled\n",
+			speeds[s], times[0] * 1e9 / updates, tunneled[0], times[1] * 1e9 / updates, tunneled[1]);
+	}
+
+	// rays up to 16 tiles long, against sampling along them every quarter pixel
+	rng_seed(8);
+	Vector2* ends = malloc(rays * 2 * sizeof(Vector2));
+	for (int i = 0; i < rays * 2; i += 2) {
+		ends[i] = (Vector2) { RAND_INT(0, map.width * map.tile_size), RAND_INT(0, map.height * map.tile_size) };
+		ends[i + 1] = (Vector2) { ends[i].x + RAND_INT(0, 512) - 256.0f, ends[i].y + RAND_INT(0, 512) - 256.0f };
+	}
+	long ray_hits = 0;
+	double start = time_now();
+	for (int i = 0; i < rays * 2; i += 2) {
+		ray_hits += tilemap_raycast(&map, ends[i], ends[i + 1], NULL);
+	}
+	double ray_time = time_now() - start;
+	const int sampled_rays = rays / 100;
+	long sampled_hits = 0, disagreements = 0;
+	start = time_now();
+	for (int i = 0; i < sampled_rays * 2; i += 2) {
+		float dx = ends[i + 1].x - ends[i].x, dy = ends[i + 1].y - ends[i].y;
+		int samples = (int)(sqrtf(dx * dx + dy * dy) * 4.0f) + 1;
+		bool hit = false;
+		for (int j = 0; j <= samples && !hit; ++j) {
+			float x = ends[i].x + dx * j / samples, y = ends[i].y + dy * j / samples;
+			hit = tilemap_get(&map, floor_to_int(x / map.tile_size), floor_to_int(y / map.tile_size)).collision == COLLISION_SOLID;
+		}
+		sampled_hits += hit;
+		disagreements += hit != tilemap_raycast(&map, ends[i], ends[i + 1], NULL);
 	}
+	double sample_time = time_now() - start;
+	printf("Raycast: [%.1f] ns per ray, [%.1f%%] blocked; sampling [%.1f] ns per ray, [%ld] of [%d] disagreeing\n",
+		ray_time * 1e9 / rays, ray_hits * 100.0 / rays, sample_time * 1e9 / sampled_rays, disagreements, sampled_rays);
 
-	UnloadRenderTexture(game->render_context.render_texture);
-	UnloadRenderTexture(hud_texture);
-#endif
+	free(ends);
+	free(bodies);
+	tilemap_free(&map);
 }
 
-void game_end(game_t* game) {
-	UnloadTexture(game->render_context.sprite_atlas);
+void bench_entities(void) {
+	const int live = 10000, per_second = 100000, seconds = 10;
+	const int churn = per_second / SIM_TICK_RATE, ticks = seconds * SIM_TICK_RATE;
 
-	if (game->controllers != NULL) {
-		free(game->controllers);
+	level_t level = { 0 };
+	entity_handle_t* handles = malloc(live * sizeof(entity_handle_t));
+	entity_handle_t* stale = malloc(churn * sizeof(entity_handle_t));
+	rng_seed(3);
+	for (int i = 0; i < live; ++i) {
+		handles[i] = entity_spawn(&level, ENTITY_GOOMBA);
 	}
 
-	if (game->level != NULL) {
-		level_free(game->level);
-		free(game->level);
+	// every tick, despawn random goombas and spawn as many new ones
+	double start = time_now();
+	long stale_hits = 0;
+	for (int t = 0; t < ticks; ++t) {
+		for (int c = 0; c < churn; ++c) {
+			int i = (int)RAND_INT(0, live - 1);
+			entity_despawn(&level, handles[i]);
+			stale[c] = handles[i];
+			handles[i] = entity_spawn(&level, ENTITY_GOOMBA);
+		}
+		for (int c = 0; c < churn; ++c) {
+			stale_hits += (entity_get(&level, stale[c]) != NULL);
+		}
+	}
+	double elapsed = time_now() - start;
+	long ops = (long)ticks * churn;
+	printf("Entities: [%d] live goombas, [%d] spawns & despawns per second for [%d] s\n", live, churn * SIM_TICK_RATE, seconds);
+	printf("  pool:            [%.1f] ns per spawn + despawn, [%.3f] ms per simulated second, [%ld] stale handles resolved\n",
+		elapsed * 1e9 / ops, elapsed * 1000.0 / seconds, stale_hits);
+
+	// iterating the packed blocks
+	const entity_pool_t* pool = &level.entities[ENTITY_GOOMBA];
+	uint64_t sum = 0;
+	start = time_now();
+	for (int t = 0; t < ticks; ++t) {
+		for (int i = 0; i < pool->count; ++i) {
+			sum += entity_pool_at(pool, i)->handle;
+		}
+	}
+	elapsed = time_now() - start;
+	printf("  pool iteration:  [%.2f] ns per entity\n", elapsed * 1e9 / ((double)ticks * pool->count));
+	bench_sink = sum;
+
+	// the previous scheme: a malloc per entity, and despawns shifting the pointer list down
+	entity_t** list = malloc(live * sizeof(entity_t*));
+	for (int i = 0; i < live; ++i) {
+		list[i] = calloc(1, sizeof(entity_goomba_t));
+	}
+	rng_seed(3);
+	start = time_now();
+	for (int t = 0; t < ticks; ++t) {
+		for (int c = 0; c < churn; ++c) {
+			int i = (int)RAND_INT(0, live - 1);
+			free(list[i]);
+			memmove(&list[i], &list[i + 1], (live - 1 - i) * sizeof(entity_t*));
+			list[live - 1] = calloc(1, sizeof(entity_goomba_t));
+		}
 	}
+	elapsed = time_now() - start;
+	printf("  malloc + list:   [%.1f] ns per spawn + despawn, [%.3f] ms per simulated second\n",
+		elapsed * 1e9 / ops, elapsed * 1000.0 / seconds);
+	for (int i = 0; i < live; ++i) {
+		free(list[i]);
+	}
+	free(list);
 
-	CloseWindow();
+	for (int type = 0; type < ENTITY_COUNT; ++type) {
+		entity_pool_free(&level.entities[type]);
+	}
+	free(handles);
+	free(stale);
 }
 
-#pragma endregion
+void bench_broadphase(void) {
+	const int entity_count = 10000, ticks = 600, queries = 100000;
+
+	level_t level = { 0 };
+	tilemap_init(&level.tilemap, 4096, 64, DEFAULT_TILE_SIZE);
+	bench_fill_terrain(&level.tilemap);
+	tilemap_update_occupancy(&level.tilemap, 0, level.tilemap.width);
+	job_system_t jobs;
+	job_system_init(&jobs, 1);
+	rng_seed(4);
+	for (int i = 0; i < entity_count; ++i) {
+		entity_spawn(&level, ENTITY_GOOMBA);
+		level.entities[ENTITY_GOOMBA].bodies.x[i] = RAND_INT(0, level.tilemap.width * level.tilemap.tile_size);
+		level.entities[ENTITY_GOOMBA].bodies.y[i] = RAND_INT(0, 40 * level.tilemap.tile_size);
+	}
+	const entity_pool_t* pool = &level.entities[ENTITY_GOOMBA];
+	float cell_size = BROADPHASE_CELL_TILES * level.tilemap.tile_size;
+
+	// a tick's worth of entity updates, with the broadphase part timed on its own
+	double build_time = 0.0, pair_time = 0.0, start;
+	long pairs = 0;
+	for (int t = 0; t < ticks; ++t) {
+		level_think_entities(&level, &jobs);
+		level_commit_entities(&level);
+		start = time_now();
+		broadphase_build(&level.broadphase, level.entities, cell_size);
+		build_time += time_now() - start;
+		start = time_now();
+		pairs += broadphase_pairs(&level.broadphase, entity_collide, &level);
+		pair_time += time_now() - start;
+	}
+	printf("Broadphase: [%d] goombas, [%d] ticks, [%.1f] overlapping pairs per tick\n", entity_count, ticks, (double)pairs / ticks);
+	printf("  build [%.3f] ms, pairs [%.3f] ms per tick ([%d] entries in [%d] buckets)\n", build_time * 1000.0 / ticks,
+		pair_time * 1000.0 / ticks, level.broadphase.entry_count, level.broadphase.bucket_count);
+
+	// every pair against every other, for comparison
+	Rectangle* rects = malloc(entity_count * sizeof(Rectangle));
+	for (int i = 0; i < entity_count; ++i) {
+		rects[i] = physics_bodies_get_rectangle(&pool->bodies, i);
+	}
+	long naive_pairs = 0;
+	start = time_now();
+	for (int i = 0; i < entity_count; ++i) {
+		for (int j = i + 1; j < entity_count; ++j) {
+			naive_pairs += rectangle_collision(rects[i], rects[j]);
+		}
+	}
+	double naive_time = time_now() - start;
+	printf("  all pairs tested: [%.3f] ms, [%ld] pairs (broadphase found [%d])\n", naive_time * 1000.0, naive_pairs,
+		broadphase_pairs(&level.broadphase, NULL, NULL));
+
+	// player sized queries, against a linear scan
+	rng_seed(5);
+	long found = 0, scanned = 0;
+	start = time_now();
+	for (int q = 0; q < queries; ++q) {
+		Rectangle rect = { RAND_INT(0, level.tilemap.width * level.tilemap.tile_size), RAND_INT(0, 60 * level.tilemap.tile_size), 8, 18 };
+		found += broadphase_query(&level.broadphase, rect, NULL, NULL);
+	}
+	double query_time = time_now() - start;
+	rng_seed(5);
+	start = time_now();
+	for (int q = 0; q < queries / 100; ++q) {
+		Rectangle rect = { RAND_INT(0, level.tilemap.width * level.tilemap.tile_size), RAND_INT(0, 60 * level.tilemap.tile_size), 8, 18 };
+		for (int i = 0; i < entity_count; ++i) {
+			scanned += rectangle_collision(rect, rects[i]);
+		}
+	}
+	double scan_time = time_now() - start;
+	printf("  queries: [%.1f] ns each, linear scan [%.1f] ns each ([%ld] hits, [%ld] in the scanned 1%%)\n",
+		query_time * 1e9 / queries, scan_time * 1e9 / (queries / 100), found, scanned);
 
-#pragma region Level Update & Draw
+	free(rects);
+	for (int type = 0; type < ENTITY_COUNT; ++type) {
+		entity_pool_free(&level.entities[type]);
+	}
+	broadphase_free(&level.broadphase);
+	tilemap_free(&level.tilemap);
+	job_system_free(&jobs);
+}
 
-void level_update_entities(level_t* level) {
-	for (int i = 0; i < level->entities.count; ++i) {
-		entity_t* e = entityptr_arraylist_get(&level->entities, i);
-		if (e != NULL) {
-			entity_update(e, level);	// all entity update
-			if (e->update != NULL) {	// uniquely assigned update
-				e->update(e, level);
-			}
+void bench_activation(void) {
+	const int height = 16, scroll = 2, columns_per_spawn = 4, scrolled_columns = 2000;
+	const int widths[] = { 2000, 20000, 200000 };
+	job_system_t jobs;
+	job_system_init(&jobs, 1);
+
+	for (int w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+		int width = widths[w], spawn_count = width / columns_per_spawn;
+		level_t level = { .camera = { .width = GAME_WIDTH, .height = GAME_HEIGHT } };
+		tilemap_init(&level.tilemap, width, height, DEFAULT_TILE_SIZE);
+		for (int x = 0; x < width; ++x) {
+			tilemap_set(&level.tilemap, x, height - 1, (tile_t) { .collision = COLLISION_SOLID });
 		}
+		level_spawn_t* spawns = malloc(spawn_count * sizeof(level_spawn_t));
+		for (int i = 0; i < spawn_count; ++i) {
+			spawns[i] = (level_spawn_t) { .x = i * columns_per_spawn, .y = height - 2 - (i % 8), .type = ENTITY_GOOMBA };
+		}
+		level_init_spawns(&level, spawns, spawn_count);
+
+		// scroll the camera across the start of the level
+		int ticks = (scrolled_columns * DEFAULT_TILE_SIZE - GAME_WIDTH) / scroll;
+		long live = 0, active = 0;
+		double start = time_now();
+		for (int t = 0; t < ticks; ++t) {
+			level.camera.x = t * scroll;
+			level_update_entities(&level, &jobs);
+			live += level.entities[ENTITY_GOOMBA].count;
+			active += level.entities[ENTITY_GOOMBA].active_count;
+		}
+		double elapsed = time_now() - start;
+		printf("Activation: [%d] spawns over [%d] columns: [%.2f] us per tick, [%.1f] live & [%.1f] active entities on average\n",
+			spawn_count, width, elapsed * 1e6 / ticks, (double)live / ticks, (double)active / ticks);
+
+		// every spawn alive & updated, as without activation
+		for (int i = 0; i < spawn_count; ++i) {
+			level_spawn(&level, i);
+		}
+		entity_pool_t* pool = &level.entities[ENTITY_GOOMBA];
+		while (pool->active_count < pool->count) {
+			entity_pool_set_active(pool, pool->active_count, true);
+		}
+		const int all_ticks = 60;
+		tilemap_update_occupancy(&level.tilemap, 0, level.tilemap.width);
+		start = time_now();
+		for (int t = 0; t < all_ticks; ++t) {
+			level_think_entities(&level, &jobs);
+			level_commit_entities(&level);
+			broadphase_build(&level.broadphase, level.entities, BROADPHASE_CELL_TILES * level.tilemap.tile_size);
+			broadphase_pairs(&level.broadphase, entity_collide, &level);
+		}
+		elapsed = time_now() - start;
+		printf("  with all [%d] spawned & active: [%.2f] us per tick\n", pool->active_count, elapsed * 1e6 / all_ticks);
+
+		for (int type = 0; type < ENTITY_COUNT; ++type) {
+			entity_pool_free(&level.entities[type]);
+		}
+		broadphase_free(&level.broadphase);
+		free(level.spawn_columns);
+		free(level.spawn_handles);
+		free(spawns);
+		tilemap_free(&level.tilemap);
 	}
+	job_system_free(&jobs);
 }
 
-void camera_set_position(camera_t* camera, int x, int y, const tilemap_t* tilemap_bounds) {
-	camera->x = CLAMP(x + camera->offset_x, 0, (tilemap_bounds->width * tilemap_bounds->tile_size) - camera->width);
-	camera->y = CLAMP(y + camera->offset_y, 0, (tilemap_bounds->height * tilemap_bounds->tile_size) - camera->height);
-}
+void bench_jobs(void) {
+	const int entity_count = 100000, ticks = 120;
+	const int thread_counts[] = { 1, 2, 4, 8 };
+
+	uint64_t first_hash = 0;
+	double first_time = 0.0;
+	for (int n = 0; n < sizeof(thread_counts) / sizeof(thread_counts[0]); ++n) {
+		// the same level for every thread count, with everything in view & active
+		level_t level = { 0 };
+		tilemap_init(&level.tilemap, 4096, 64, DEFAULT_TILE_SIZE);
+		bench_fill_terrain(&level.tilemap);
+		tilemap_update_occupancy(&level.tilemap, 0, level.tilemap.width);
+		rng_seed(6);
+		for (int i = 0; i < entity_count; ++i) {
+			entity_spawn_at(&level, ENTITY_GOOMBA, RAND_INT(0, level.tilemap.width * level.tilemap.tile_size), RAND_INT(0, 40 * level.tilemap.tile_size));
+		}
+		job_system_t jobs;
+		job_system_init(&jobs, thread_counts[n]);
+
+		double think_time = 0.0, commit_time = 0.0, collide_time = 0.0, start;
+		for (int t = 0; t < ticks; ++t) {
+			start = time_now();
+			level_think_entities(&level, &jobs);
+			think_time += time_now() - start;
+			start = time_now();
+			level_commit_entities(&level);
+			commit_time += time_now() - start;
+			start = time_now();
+			broadphase_build(&level.broadphase, level.entities, BROADPHASE_CELL_TILES * level.tilemap.tile_size);
+			broadphase_pairs(&level.broadphase, entity_collide, &level);
+			collide_time += time_now() - start;
+		}
+		uint64_t hash = level_hash(0, &level);
+		if (n == 0) {
+			first_hash = hash;
+			first_time = think_time;
+			printf("Jobs: [%d] goombas, [%d] ticks\n", entity_count, ticks);
+		}
+		printf("  [%d] threads: think [%.3f] ms ([%.2fx] of [1] thread), commit [%.3f] ms, collide [%.3f] ms per tick; state %s\n",
+			jobs.thread_count, think_time * 1000.0 / ticks, first_time / think_time, commit_time * 1000.0 / ticks, collide_time * 1000.0 / ticks,
+			(hash == first_hash) ? "matches" : "DOES NOT match");
 
-void level_update(level_t* level, game_t* game) {
-	player_update(&level->player, level, &game->controllers[0]);
-	level_update_entities(level);
-	camera_set_position(&level->camera, level->player.body.x, level->player.body.y, &level->tilemap);
-	level->background.x = -level->camera.x;
-	level->background.y = ((float)(-level->camera.y) / 2.0f) - 128;
+		job_system_free(&jobs);
+		for (int type = 0; type < ENTITY_COUNT; ++type) {
+			entity_pool_free(&level.entities[type]);
+		}
+		broadphase_free(&level.broadphase);
+		tilemap_free(&level.tilemap);
+	}
 }
 
-void level_draw(level_t* level, render_context_t* context) {
-	background_draw(&level->background);
+void bench_sprites(void) {
+	const int sprite_counts[] = { 1000, 10000, 20000 };
+	const int frames = 60;
 
-	// localize camera space coordinates to local coordinates by offsetting the current model matrix
-	rlPushMatrix();
-	rlTranslatef(-level->camera.x, -level->camera.y, 0);
+	// a sprite with frames spread across atlas pages, drawn with its debug bounds like entities are
+	render_context_t context = { .sprite_atlas_pages = 4 };
+	sprite_frame_t frames_data[8];
+	for (int i = 0; i < 8; ++i) {
+		frames_data[i] = (sprite_frame_t) { (i * 16) % TEXTURE_ATLAS_WIDTH, 0, i % context.sprite_atlas_pages };
+	}
+	sprite_t sprite = { .width = 16, .height = 16, .frame_count = 8, .frames = frames_data };
+
+	for (int c = 0; c < sizeof(sprite_counts) / sizeof(sprite_counts[0]); ++c) {
+		int run_starts[SPRITE_BATCH_KEYS + 1];
+		long switches = 0, runs = 0, quads = 0, dropped = 0;
+		double queue_time = 0.0, sort_time = 0.0;
+		rng_seed(9);
+		for (int f = 0; f < frames; ++f) {
+			context.sprite_batch_stats = (sprite_batch_stats_t) { 0 };
+			double start = time_now();
+			for (int i = 0; i < sprite_counts[c]; ++i) {
+				float x = RAND_INT(0, GAME_WIDTH), y = RAND_INT(0, GAME_HEIGHT);
+				sprite_draw(&sprite, i, x, y, i & 1, false, &context);
+				sprite_batch_rectangle_lines((Rectangle) { x, y, sprite.width, sprite.height }, 1, RED, &context);
+			}
+			queue_time += time_now() - start;
+			start = time_now();
+			sprite_batch_sort(&context, run_starts);
+			sort_time += time_now() - start;
+
+			// drawn one at a time in queue order, every change of texture would be a draw of its own
+			for (int i = 1; i < context.sprite_batch_count; ++i) {
+				switches += context.sprite_batch[i].key != context.sprite_batch[i - 1].key;
+			}
+			for (int key = 0; key < SPRITE_BATCH_KEYS; ++key) {
+				runs += run_starts[key + 1] > run_starts[key];
+			}
+			quads += context.sprite_batch_count;
+			dropped += context.sprite_batch_stats.dropped;
+			context.sprite_batch_count = 0;
+		}
+		printf("Sprites: [%d] sprites & bounds, [%ld] quads per frame ([%ld] dropped): queue [%.1f] us, sort [%.1f] us per frame; [%ld] draws sorted, [%ld] in queue order\n",
+			sprite_counts[c], quads / frames, dropped / frames, queue_time * 1e6 / frames, sort_time * 1e6 / frames, runs / frames, switches / frames + 1);
+	}
 
-	int tile_size = level->tilemap.tile_size;
-	int cam_tile_x1 = level->camera.x / level->tilemap.tile_size, cam_tile_x2 = (level->camera.x + GAME_WIDTH) / (float)tile_size;
-	int cam_tile_y1 = level->camera.y / level->tilemap.tile_size, cam_tile_y2 = (level->camera.y + GAME_HEIGHT) / (float)tile_size;
-
-	for (int it = 0; it < 2; ++it) {
-		if (it == 1) {
-			BeginBlendMode(BLEND_ADDITIVE);
-		}
-		for (int i = cam_tile_x1; i <= cam_tile_x2; ++i) {
-			for (int j = cam_tile_y1; j <= cam_tile_y2; ++j) {
-				collision_type_t tile_type = tilemap_get(&level->tilemap, i, j).collision;
-				if (tile_type != COLLISION_AIR) {
-					float alpha = 1.0f - CLAMP(distance(level->player.body.x, level->player.body.y, (i * tile_size) + (tile_size / 2.0f), (j * tile_size) + (tile_size / 2.0f)) / 64.0f, 0.0f, 1.0f);
-					if (it == 0) {
-						DrawRectangleLinesEx(tilemap_get_rectangle(&level->tilemap, i, j), 1, (Color) { 0, 200, 255, (const char)((alpha * 128.0f)) });
+	free(context.sprite_batch);
+	free(context.sprite_batch_sorted);
+}
+
+void bench_text(void) {
+	const int player_counts[] = { 1, 4, 16 };
+	const int frames = 6000;
+	const char* order = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.,*-!@|=:";
+
+	render_context_t context = { .sprite_atlas_pages = 1 };
+	int order_len = strlen(order);
+	sprite_frame_t* frames_data = malloc(order_len * sizeof(sprite_frame_t));
+	for (int i = 0; i < order_len; ++i) {
+		frames_data[i] = (sprite_frame_t) { i * 8, 0, 0 };
+	}
+	font_t font = { .sprite_data = { .width = 8, .height = 8, .frame_count = order_len, .frames = frames_data } };
+	font_init(order, &font);
+
+	for (int c = 0; c < sizeof(player_counts) / sizeof(player_counts[0]); ++c) {
+		// a label, score, timer & coin counter per player, ticking over at 60 frames a second
+		int players = player_counts[c], strings = players * 4;
+		text_run_t* runs = calloc(strings, sizeof(text_run_t));
+		char(*texts)[32] = malloc(strings * sizeof(*texts));
+		double time_scan = 0.0, time_lut = 0.0, time_run = 0.0;
+		long quads[3] = { 0 };
+		uint64_t hashes[3] = { 0 };
+		for (int method = 0; method < 3; ++method) {
+			double start = time_now();
+			for (int f = 0; f < frames; ++f) {
+				for (int p = 0; p < players; ++p) {
+					snprintf(texts[p * 4 + 0], 32, "PLAYER %d", p + 1);
+					snprintf(texts[p * 4 + 1], 32, "SCORE %06d", (f / 7 + p * 100) * 50);
+					snprintf(texts[p * 4 + 2], 32, "TIME %03d", 400 - f / 60 % 400);
+					snprintf(texts[p * 4 + 3], 32, "*%02d", (f / 90 + p) % 100);
+				}
+				for (int i = 0; i < strings; ++i) {
+					float x = (i / 4) % 4 * 64, y = (i / 16) * 40 + (i % 4) * 8;
+					if (method == 0) {
+						// what text_draw used to do: a search through the font's order for every character
+						size_t string_len = strlen(texts[i]), font_order_len = strlen(font.order);
+						int _x = x, _y = y;
+						for (int k = 0; k < string_len; ++k) {
+							if (texts[i][k] == ' ') {
+								_x += font.spacing + font.sprite_data.width;
+								continue;
+							}
+							for (int j = 0; j < font_order_len; ++j) {
+								if (font.order[j] == texts[i][k]) {
+									sprite_draw(&font.sprite_data, j, _x, _y, false, false, &context);
+									_x += font.sprite_data.width + font.spacing;
+									break;
+								}
+							}
+						}
+					}
+					else if (method == 1) {
+						text_draw(texts[i], &font, x, y, &context);
 					}
 					else {
-						DrawRectangleRec(tilemap_get_rectangle(&level->tilemap, i, j), (Color) { 0, 128, 255, (const char)((alpha * 128.0f)) });
+						text_run_draw(&runs[i], texts[i], &font, x, y, &context);
 					}
 				}
+				quads[method] += context.sprite_batch_count;
+				for (int i = 0; i < context.sprite_batch_count; ++i) {
+					const sprite_draw_command_t* quad = &context.sprite_batch[i];
+					hashes[method] = hash_combine(hashes[method], ((uint64_t)(int)quad->dest.x << 32) ^ ((uint64_t)(int)quad->dest.y << 16) ^ ((uint64_t)(int)quad->source.x << 4) ^ quad->key);
+				}
+				context.sprite_batch_count = 0;
 			}
+			double elapsed = time_now() - start;
+			*(method == 0 ? &time_scan : method == 1 ? &time_lut : &time_run) = elapsed;
 		}
-		if (it == 1) {
-			EndBlendMode();
+		printf("Text: [%d] players, [%d] strings, [%ld] glyphs per frame: order search [%.2f] us, glyph table [%.2f] us, text runs [%.2f] us per frame (quads %s)\n",
+			players, strings, quads[0] / frames, time_scan * 1e6 / frames, time_lut * 1e6 / frames, time_run * 1e6 / frames,
+			(hashes[0] == hashes[1] && hashes[1] == hashes[2]) ? "match" : "DIFFER");
+		for (int i = 0; i < strings; ++i) {
+			text_run_free(&runs[i]);
 		}
+		free(runs);
+		free(texts);
 	}
 
-	for (int i = 0; i < level->entities.count; ++i) {
-		entity_t* e = entityptr_arraylist_get(&level->entities, i);
-		if (e != NULL && e->update != NULL) {
-			e->draw(e, level, context);
-		}
-	}
+	free(frames_data);
+	free(context.sprite_batch);
+	free(context.sprite_batch_sorted);
+}
 
-	player_draw(&level->player, level, context);
+void bench_hud(void) {
+	const int player_counts[] = { 1, 4, 16 };
+	const int frames = 6000;
+	const char* order = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.,*-!@|=:";
 
-	rlPopMatrix();
-}
+	render_context_t context = { .sprite_atlas_pages = 1 };
+	int order_len = strlen(order);
+	sprite_frame_t* frames_data = malloc(order_len * sizeof(sprite_frame_t));
+	for (int i = 0; i < order_len; ++i) {
+		frames_data[i] = (sprite_frame_t) { i * 8, 0, 0 };
+	}
+	font_t font = { .sprite_data = { .width = 8, .height = 8, .frame_count = order_len, .frames = frames_data } };
+	font_init(order, &font);
+	sprite_frame_t coin_frames[4] = { { 0, 8, 0 }, { 8, 8, 0 }, { 16, 8, 0 }, { 24, 8, 0 } };
+	sprite_t coin = { .width = 8, .height = 8, .frame_count = 4, .frames = coin_frames };
+
+	for (int c = 0; c < sizeof(player_counts) / sizeof(player_counts[0]); ++c) {
+		// a label, score, timer, coin icon & coin counter per player, at 60 frames a second
+		int players = player_counts[c];
+		hud_t hud;
+		hud_init(&hud);
+		int* ids = malloc(players * 4 * sizeof(int));
+		for (int p = 0; p < players; ++p) {
+			float x = p % 4 * 64, y = p / 4 * 48;
+			char label[HUD_TEXT_SIZE];
+			snprintf(label, sizeof(label), "PLAYER %d", p + 1);
+			hud_add_text(&hud, label, &font, x, y);
+			ids[p * 4 + 0] = hud_add_counter(&hud, "%06d", 0, &font, x, y + 8);
+			ids[p * 4 + 1] = hud_add_counter(&hud, "TIME %03d", 400, &font, x, y + 16);
+			ids[p * 4 + 2] = hud_add_icon(&hud, &coin, 0, x, y + 24);
+			ids[p * 4 + 3] = hud_add_counter(&hud, "*%02d", 0, &font, x + 8, y + 24);
+		}
 
-#pragma endregion
+		// drawn every frame, like the HUD text used to be
+		long immediate_quads = 0;
+		double start = time_now();
+		for (int f = 0; f < frames; ++f) {
+			char text[HUD_TEXT_SIZE];
+			for (int p = 0; p < players; ++p) {
+				float x = p % 4 * 64, y = p / 4 * 48;
+				snprintf(text, sizeof(text), "PLAYER %d", p + 1);
+				text_draw(text, &font, x, y, &context);
+				snprintf(text, sizeof(text), "%06d", (f / 45 + p) * 50);
+				text_draw(text, &font, x, y + 8, &context);
+				snprintf(text, sizeof(text), "TIME %03d", 400 - f / 60 % 400);
+				text_draw(text, &font, x, y + 16, &context);
+				sprite_draw(&coin, f / 8 % 4 * (p == 0), x, y + 24, false, false, &context);
+				snprintf(text, sizeof(text), "*%02d", (f / 90 + p) % 100);
+				text_draw(text, &font, x + 8, y + 24, &context);
+			}
+			immediate_quads += context.sprite_batch_count;
+			context.sprite_batch_count = 0;
+		}
+		double immediate_time = time_now() - start;
+
+		// retained; only the first player's coin spins, the rest only redraw when a value changes
+		long retained_quads = 0, redraws = 0;
+		double area = 0.0;
+		start = time_now();
+		for (int f = 0; f < frames; ++f) {
+			for (int p = 0; p < players; ++p) {
+				hud_set_value(&hud, ids[p * 4 + 0], (f / 45 + p) * 50);
+				hud_set_value(&hud, ids[p * 4 + 1], 400 - f / 60 % 400);
+				hud_set_frame(&hud, ids[p * 4 + 2], f / 8 % 4 * (p == 0));
+				hud_set_value(&hud, ids[p * 4 + 3], (f / 90 + p) % 100);
+			}
+			Rectangle dirty;
+			if (hud_layout(&hud, &context, &dirty)) {
+				hud_queue(&hud, dirty, &context);
+				area += dirty.width * dirty.height;
+				++redraws;
+			}
+			retained_quads += context.sprite_batch_count + 1;	// + the HUD texture laid over the game
+			context.sprite_batch_count = 0;
+		}
+		double retained_time = time_now() - start;
 
-#pragma region Player Functions
+		printf("HUD: [%d] players, [%d] elements: immediate [%.2f] us & [%ld] quads per frame; retained [%.2f] us & [%.1f] quads per frame, redrawn [%.1f]%% of frames over [%.0f] px on average\n",
+			players, hud.element_count, immediate_time * 1e6 / frames, immediate_quads / frames, retained_time * 1e6 / frames, (double)retained_quads / frames,
+			redraws * 100.0 / frames, area / MAX(redraws, 1));
+		free(ids);
+		hud_free(&hud);
+	}
 
-void player_init(player_t* player) {
-	*player = (player_t) {
-        .sprites_index = mario_sprites.idle,
-        .is_big = true
-    };
-	physics_body_init(&player->body, 8, 18);
+	free(frames_data);
+	free(context.sprite_batch);
+	free(context.sprite_batch_sorted);
 }
 
-inline sprite_t* player_get_sprite(player_t* player) {
-	return (player->sprites_index == NULL) ? NULL : &player->sprites_index[player->is_big];
+void bench_snapshot(void) {
+	const int entity_counts[] = { 100, 1000, 10000, 100000 };
+	const int ticks = 1000;
+
+	render_snapshots_t* snapshots = render_snapshots_create();
+	printf("Snapshot: [%zu] bytes per snapshot, [%zu] per entity, [%zu] per chunk\n", sizeof(render_snapshot_t), sizeof(render_entity_t), sizeof(render_chunk_t));
+	for (int n = 0; n < sizeof(entity_counts) / sizeof(entity_counts[0]); ++n) {
+		// goombas over the first 64 columns, a quarter of which the camera sees
+		level_t level = { .camera = { .width = GAME_WIDTH, .height = GAME_HEIGHT } };
+		tilemap_init(&level.tilemap, 4096, 64, DEFAULT_TILE_SIZE);
+		level.camera.bounds_x2 = level.tilemap.width * level.tilemap.tile_size;
+		level.camera.bounds_y2 = level.tilemap.height * level.tilemap.tile_size;
+		bench_fill_terrain(&level.tilemap);
+		rng_seed(7);
+		for (int i = 0; i < entity_counts[n]; ++i) {
+			entity_spawn_at(&level, ENTITY_GOOMBA, RAND_INT(0, 64 * level.tilemap.tile_size), RAND_INT(0, 40 * level.tilemap.tile_size));
+		}
+
+		double gather_time = 0.0, publish_time = 0.0, latest_time = 0.0, start;
+		long drawn = 0, dropped = 0, chunks = 0;
+		for (int t = 0; t < ticks; ++t) {
+			// pan back and forth across the goombas, and up and down, so the chunks in view change
+			camera_set_position(&level.camera, abs(t % 384 - 192) * 4, abs(t % 200 - 100) * 4);
+
+			start = time_now();
+			render_snapshot_t* snapshot = render_snapshots_back(snapshots);
+			level_snapshot(&level, snapshot);
+			gather_time += time_now() - start;
+			start = time_now();
+			render_snapshots_publish(snapshots);
+			publish_time += time_now() - start;
+			start = time_now();
+			const render_snapshot_t* latest = render_snapshots_latest(snapshots);
+			latest_time += time_now() - start;
+			drawn += latest->entity_count;
+			dropped += latest->entities_dropped + latest->chunks_dropped;
+			chunks += latest->chunk_count;
+		}
+		printf("  [%d] goombas: gather [%.2f] us, publish [%.3f] us, latest [%.3f] us per tick; [%.0f] entities, [%.1f] chunks & [%.0f] dropped per snapshot\n",
+			entity_counts[n], gather_time * 1e6 / ticks, publish_time * 1e6 / ticks, latest_time * 1e6 / ticks, (double)drawn / ticks, (double)chunks / ticks, (double)dropped / ticks);
+
+		for (int type = 0; type < ENTITY_COUNT; ++type) {
+			entity_pool_free(&level.entities[type]);
+		}
+		tilemap_free(&level.tilemap);
+	}
+	free(snapshots);
 }
 
-void player_animate(player_t* player, controller_state_t* controller) {
-	// crouch
-	if (player->is_crouching) {
-		player->sprites_index = mario_sprites.crouch;
-		player->image_index = 0;
+void bench_level_load(void) {
+	const char* path = "bench_level.sfml";
+	const int width = 4000, height = 250, loads = 1000;
+
+	// a 1M tile level
+	tilemap_t map;
+	tilemap_init(&map, width, height, DEFAULT_TILE_SIZE);
+	bench_fill_terrain(&map);
+	int camera_bounds[4] = { 0, 0, width * DEFAULT_TILE_SIZE, height * DEFAULT_TILE_SIZE };
+	bool written = level_file_write(path, &map, "", BLACK_SKY, camera_bounds, NULL, 0);
+	tilemap_free(&map);
+	if (!written) {
+		printf("Could not write [%s]\n", path);
 		return;
 	}
 
-	// jump
-	if (!player->body.grounded) {
-		player->sprites_index = mario_sprites.jump;
-		player->image_index = player->body.yspd > 0 ? 1 : 0;
-		return;
+	level_t level;
+	double start = time_now();
+	for (int i = 0; i < loads; ++i) {
+		if (!level_load(&level, path)) {
+			printf("Could not load [%s]\n", path);
+			remove(path);
+			return;
+		}
+		level_free(&level);
+	}
+	double load_time = (time_now() - start) / loads;
+
+	// first touch of every tile pulls the mapping's pages in
+	level_load(&level, path);
+	uint64_t sum = 0;
+	start = time_now();
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			sum += tilemap_get(&level.tilemap, x, y).collision;
+		}
 	}
+	double touch_time = time_now() - start;
+	bench_sink = sum;
+	level_free(&level);
+	remove(path);
 
-	// skid
-	if (controller->current.h * player->body.xspd < 0.0f) {
-		player->sprites_index = mario_sprites.skid;
+	printf("Level load [%dx%d] ([%.2f] MiB): [%.1f] us per load, [%.3f] ms to first touch every tile\n",
+		width, height, tilemap_data_size(&map) / (1024.0 * 1024.0), load_time * 1e6, touch_time * 1000.0);
+}
+
+void bench_streaming(void) {
+	const char* path = "bench_level.sfml";
+	const int width = 100000, height = 32, view = 32;
+	const int speeds[] = { 1, 4, 16 };	// tiles per tick
+
+	tilemap_t map;
+	tilemap_init(&map, width, height, DEFAULT_TILE_SIZE);
+	bench_fill_terrain(&map);
+	int camera_bounds[4] = { 0, 0, width * DEFAULT_TILE_SIZE, height * DEFAULT_TILE_SIZE };
+	if (!level_file_write(path, &map, "", BLACK_SKY, camera_bounds, NULL, 0)) {
+		printf("Could not write [%s]\n", path);
+		tilemap_free(&map);
 		return;
 	}
 
-	// walk
-	if (player->body.xspd != 0.0f) {
-		player->sprites_index = mario_sprites.walk;
-		player->image_index += MAX(0.125f, fabsf(player->body.xspd) / 6.0f);
+	level_t level;
+	if (!level_load(&level, path) || level.tilemap.stream == NULL) {
+		printf("Could not stream [%s]\n", path);
+		tilemap_free(&map);
+		remove(path);
 		return;
 	}
-
-	// idle
-	player->sprites_index = mario_sprites.idle;
-	player->image_index = (controller->current.v < 0) ? 1 : 0;
-}
-
-void player_draw(player_t* player, level_t* level, render_context_t* context) {
-	if (player->sprites_index != NULL) {
-		sprite_t* sprite_index = &player->sprites_index[player->is_big];
-		sprite_draw_ex(sprite_index, player->image_index, player->body.x, player->body.y + 1, sprite_index->width * player->body.origin_x, sprite_index->height * player->body.origin_y, player->flip_x, false, context);
+	tilemap_t* streamed = &level.tilemap;
+	printf("Streaming [%dx%d]: [%.2f] MiB resident of [%.2f] MiB\n", width, height,
+		tilemap_data_size(streamed) / (1024.0 * 1024.0), tilemap_data_size(&map) / (1024.0 * 1024.0));
+
+	// sweep across the level and back, checking everything in view against the whole level in memory
+	for (int s = 0; s < sizeof(speeds) / sizeof(speeds[0]); ++s) {
+		long ticks = 0, mismatches = 0, waits = streamed->stream->waits, loads = streamed->stream->loads;
+		double start = time_now();
+		for (int pass = 0; pass < 2; ++pass) {
+			int direction = pass == 0 ? 1 : -1;
+			for (int x = pass == 0 ? 0 : width - 1; x >= 0 && x < width; x += direction * speeds[s], ++ticks) {
+				tilemap_stream_update(streamed, x, (float)direction);
+				for (int tx = x - view; tx <= x + view; ++tx) {
+					for (int ty = 0; ty < height; ++ty) {
+						mismatches += tilemap_get(streamed, tx, ty).collision != tilemap_get(&map, tx, ty).collision;
+						mismatches += (tilemap_row_span(streamed, streamed->solid_rows, ty, tx, 1) != tilemap_row_span(&map, map.solid_rows, ty, tx, 1));
+						mismatches += (tilemap_solid_column_span(streamed, tx, ty, 1) != tilemap_solid_column_span(&map, tx, ty, 1));
+					}
+				}
+			}
+		}
+		double elapsed = time_now() - start;
+		printf("  [%2d] tiles/tick: [%ld] ticks, [%ld] segment loads, waited on [%ld] ticks, [%ld] mismatches, [%.2f] us per tick\n",
+			speeds[s], ticks, streamed->stream->loads - loads, streamed->stream->waits - waits, mismatches, elapsed * 1e6 / ticks);
 	}
 
-	Rectangle bounds = physics_body_get_rectangle(&player->body);
-	bounds = (Rectangle) { floorf(bounds.x), floorf(bounds.y), bounds.width, bounds.height };
-	DrawRectangleLinesEx(bounds, 1, RED);
-	DrawPixel(floorf(player->body.x), floorf(player->body.y), BLUE);
+	level_free(&level);
+	tilemap_free(&map);
+	remove(path);
 }
 
-void player_jump(player_t* player) {
-	float variable_jump = (fabsf(player->body.xspd / PLAYER_RUN_SPEED)) * 1.0f; // normalize jump between 0 and 1 based on player speed from walk to full height
-	player->body.yspd = -PLAYER_JUMP - variable_jump;
-	PlaySound(sounds.jump);
-}
+void bench_atlas(void) {
+	const char* path = "bench_atlas.cache";
+	const int sprite_count = sizeof(atlas_sprites) / sizeof(atlas_sprites[0]), loads = 100;
 
-void player_move(player_t* player, level_t* level, controller_state_t* controller) {
-	// A lower gravity is used to make the player jump higher if the player is variable jumping
-	player->body.grav = (controller->current.a) ? PLAYER_GRAVITY_HOLD : PLAYER_GRAVITY;
+	double start = time_now();
+	uint64_t source_hash = atlas_source_hash();
+	double hash_time = time_now() - start;
 
-	if (player->body.grounded && controller->current.a && !controller->previous.a) {
-		player_jump(player);
+	// cold, decoding on a single thread
+	atlas_set_t built;
+	atlas_timings_t serial, timings;
+	atlas_build(&built, 1, &serial);
+	for (int i = 0; i < sprite_count; ++i) {
+		sprite_free(atlas_sprites[i].sprite);
 	}
-
-	if (player->body.grounded) {
-		if (controller->current.v > 0) {
-			if (!player->is_crouching) {
-				player->is_crouching = true;
-				player->body.height = 10;
-			}
-			controller->current.h = 0;
-		}
-		else {
-			if (player->is_crouching) {
-				player->is_crouching = false;
-				player->body.height = 18;
+	atlas_free(&built);
+
+	// cold: decode & pack everything, then write the cache
+	start = time_now();
+	atlas_build(&built, ASSET_DECODE_THREADS, &timings);
+	double build_time = time_now() - start;
+	start = time_now();
+	bool saved = atlas_cache_save(path, source_hash, &built);
+	double save_time = time_now() - start;
+	sprite_t* built_sprites = malloc(sprite_count * sizeof(sprite_t));
+	for (int i = 0; i < sprite_count; ++i) {
+		built_sprites[i] = *atlas_sprites[i].sprite;
+	}
+	struct tile_atlas built_tiles = tile_atlas;
+	tile_atlas = (struct tile_atlas) { 0 };
+
+	// warm: map the cache
+	atlas_set_t loaded = { 0 };
+	bool hit = saved;
+	start = time_now();
+	for (int i = 0; i < loads && hit; ++i) {
+		if (i > 0) {
+			for (int j = 0; j < sprite_count; ++j) {
+				sprite_free(atlas_sprites[j].sprite);
 			}
+			atlas_free(&loaded);
 		}
+		hit = atlas_cache_load(path, source_hash, &loaded);
 	}
-
-	float h = controller->current.h;
-	float traction = 1.0f; // ice would be something like 0.2 for snowy levels
-
-	// player speed can be changed any time on ground, or when the player is in the air and sign of input = spd
-	if ((player->body.grounded) || ((!player->body.grounded && h * player->body.xspd >= 0))) {
-		if (controller->current.b && fabsf(player->body.xspd) >= PLAYER_WALK_SPEED && h * player->body.xspd > 0) {
-			player->body.xspd_max = PLAYER_RUN_SPEED;
-		}
-		else {
-			player->body.xspd_max = PLAYER_WALK_SPEED;
+	double load_time = (time_now() - start) / loads;
+
+	// the cache has to reproduce the build exactly
+	bool match = hit;
+	for (int k = 0; k < ATLAS_KIND_COUNT && match; ++k) {
+		match = built.atlases[k].page_count == loaded.atlases[k].page_count;
+		for (int p = 0; p < built.atlases[k].page_count && match; ++p) {
+			const Image* a = &built.atlases[k].pages[p];
+			match = memcmp(a->data, loaded.atlases[k].pages[p].data, (size_t)a->width * a->height * 4) == 0;
 		}
 	}
-	else {
-		player->body.xspd_max = 0.0f;
+	for (int i = 0; i < sprite_count && match; ++i) {
+		const sprite_t* a = &built_sprites[i];
+		const sprite_t* b = atlas_sprites[i].sprite;
+		match = a->width == b->width && a->height == b->height && a->frame_count == b->frame_count && a->order_count == b->order_count &&
+			(a->frame_count == 0 || memcmp(a->frames, b->frames, a->frame_count * sizeof(sprite_frame_t)) == 0) &&
+			(a->order_count == 0 || memcmp(a->order, b->order, a->order_count * sizeof(int)) == 0);
+	}
+	match = match && built_tiles.slot_count == tile_atlas.slot_count &&
+		(built_tiles.slot_count == 0 || memcmp(built_tiles.slots, tile_atlas.slots, built_tiles.slot_count * sizeof(tile_slot_t)) == 0);
+	for (int i = 0; i < sizeof(atlas_tilesets) / sizeof(atlas_tilesets[0]) && match; ++i) {
+		const tileset_t* a = &built_tiles.tilesets[i];
+		const tileset_t* b = &tile_atlas.tilesets[i];
+		match = a->columns == b->columns && a->rows == b->rows && memcmp(a->slots, b->slots, sizeof(int) * a->columns * a->rows) == 0;
 	}
 
-	// horizontal input when less than max speed
-	if (h != 0) {
-		if (h * player->body.xspd < player->body.xspd_max) {
-			player->flip_x = (h < 0) ? true : false;
-			// normal forward acceleration
-			if (h * player->body.xspd > 0) {
-				player->body.xspd += h * PLAYER_ACCEL;
-			}
-			// skidding
-			else {
-				// ground skid
-				if (player->body.grounded) {
-					// multiplies the turn speed by an amount
-					float skid_factor = 1.0f;
-					float current_xspd = fabsf(player->body.xspd);
-					if (current_xspd <= PLAYER_WALK_SPEED) {
-						skid_factor = 1.0f;
-					}
-					else if (current_xspd <= PLAYER_RUN_SPEED) {
-						skid_factor = 2.0f;
-					}
-					else if (current_xspd > PLAYER_RUN_SPEED) {
-						skid_factor = 4.0f;
+	// empty tile detection: a GetImageColor call per pixel, against scanning raw rows
+	const int tile_size = DEFAULT_TILE_SIZE, scans = 20;
+	double per_pixel_time = 0.0, scan_time = 0.0;
+	long empty_per_pixel = 0, empty_scan = 0, tiles_scanned = 0;
+	for (int t = 0; t < sizeof(atlas_tilesets) / sizeof(atlas_tilesets[0]); ++t) {
+		Image tls = LoadImage(TextFormat(TILES_PATH "/%s.png", atlas_tilesets[t]));
+		if (tls.data == NULL) {
+			continue;
+		}
+		ImageFormat(&tls, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+		const size_t stride = (size_t)tls.width * 4;
+		start = time_now();
+		for (int s = 0; s < scans; ++s) {
+			for (int i = 0; i < tls.width / tile_size; ++i) {
+				for (int j = 0; j < tls.height / tile_size; ++j) {
+					bool has_img_data = false;
+					for (int x = 0; x < tile_size; ++x) {
+						for (int y = 0; y < tile_size; ++y) {
+							if (GetImageColor(tls, (i * tile_size) + x, (j * tile_size) + y).a != 0) {
+								has_img_data = true;
+							}
+						}
 					}
-					player->body.xspd += h * (PLAYER_TURN * skid_factor * traction);
-				}
-				else if (h * player->body.xspd > -PLAYER_WALK_SPEED) {
-					player->body.xspd += h * PLAYER_TURN;
+					empty_per_pixel += !has_img_data;
 				}
-				else {
-					player->body.xspd += h * (PLAYER_TURN_AIR * 2);
+			}
+		}
+		per_pixel_time += time_now() - start;
+		start = time_now();
+		for (int s = 0; s < scans; ++s) {
+			for (int j = 0; j < tls.height / tile_size; ++j) {
+				for (int i = 0; i < tls.width / tile_size; ++i) {
+					empty_scan += pixels_transparent((const uint8_t*)tls.data + (size_t)j * tile_size * stride + (size_t)i * tile_size * 4, stride, tile_size, tile_size);
 				}
 			}
 		}
+		scan_time += time_now() - start;
+		tiles_scanned += (long)(tls.width / tile_size) * (tls.height / tile_size) * scans;
+		UnloadImage(tls);
 	}
-	// no input held down- slow player
-	else if (player->body.xspd != 0) {
-		float xspd_dir = (player->body.xspd > 0) ? 1.0f : -1.0f; // which way the player is moving
-		player->body.xspd -= ((player->body.grounded) ? PLAYER_DECEL : PLAYER_DECEL_AIR) * xspd_dir;
-		if (player->body.xspd * xspd_dir < 0) {
-			player->body.xspd = 0;
+	match = match && empty_per_pixel == empty_scan;
+
+	printf("Atlas: hash sources [%.3f] ms, build [%.3f] ms, write cache [%.3f] ms, load cache [%.3f] ms ([%.0fx] faster than building)\n",
+		hash_time * 1000.0, build_time * 1000.0, save_time * 1000.0, load_time * 1000.0, (hash_time + build_time) / (hash_time + load_time));
+	printf("  build: decode [%.3f] ms on [1] thread, [%.3f] ms on [%d] threads; pack [%.3f] ms\n",
+		serial.decode * 1000.0, timings.decode * 1000.0, ASSET_DECODE_THREADS, timings.pack * 1000.0);
+	printf("  empty tile detection: [%.1f] ns per tile per pixel, [%.1f] ns per tile scanning rows\n",
+		per_pixel_time * 1e9 / MAX(tiles_scanned, 1), scan_time * 1e9 / MAX(tiles_scanned, 1));
+	printf("  [%d] distinct tiles; [%d] sprite atlas pages, [%d] tile atlas pages; cache %s the build\n", built_tiles.slot_count,
+		built.atlases[ATLAS_SPRITES].page_count, built.atlases[ATLAS_TILES].page_count, match ? "matches" : "DOES NOT match");
+
+	for (int i = 0; i < sprite_count; ++i) {
+		sprite_free(&built_sprites[i]);
+		if (hit) {
+			sprite_free(atlas_sprites[i].sprite);
 		}
+		*atlas_sprites[i].sprite = (sprite_t) { 0 };
 	}
-
-	physics_body_update(&player->body, &level->tilemap);
+	free(built_sprites);
+	tile_atlas_free();
+	tile_atlas = built_tiles;
+	tile_atlas_free();
+	atlas_free(&built);
+	atlas_free(&loaded);
+	remove(path);
 }
 
-void player_update(player_t* player, level_t* level, controller_state_t* controller) {
-	player_move(player, level, controller);
-	player_animate(player, controller);
+/**
+ * Runs a named benchmark
+ * @param name Name of the benchmark to run
+ * @return Whether a benchmark of that name exists
+ */
+bool bench_run(const char* name) {
+	struct {
+		const char* name;
+		void (*run)(void);
+	} benches[] = {
+		{ "tilemap", bench_tilemap },
+		{ "physics", bench_physics },
+		{ "sweep", bench_sweep },
+		{ "level_load", bench_level_load },
+		{ "streaming", bench_streaming },
+		{ "atlas", bench_atlas },
+		{ "entities", bench_entities },
+		{ "broadphase", bench_broadphase },
+		{ "activation", bench_activation },
+		{ "jobs", bench_jobs },
+		{ "sprites", bench_sprites },
+		{ "text", bench_text },
+		{ "hud", bench_hud },
+		{ "snapshot", bench_snapshot },
+	};
+	for (int i = 0; i < sizeof(benches) / sizeof(benches[0]); ++i) {
+		if (strcmp(name, benches[i].name) == 0) {
+			benches[i].run();
+			return true;
+		}
+	}
+	printf("Unknown benchmark [%s]. Available benchmarks:", name);
+	for (int i = 0; i < sizeof(benches) / sizeof(benches[0]); ++i) {
+		printf(" %s", benches[i].name);
+	}
+	printf("\n");
+	return false;
 }
 
 #pragma endregion
 
 int main(int argc, char** argv) {
+	// usage: single_file_mario[_headless] --hash-compare <log_a> <log_b>
+	if (argc == 4 && strcmp(argv[1], "--hash-compare") == 0) {
+		long tick = state_hash_log_compare(argv[2], argv[3]);
+		if (tick == -2) {
+			printf("Could not open hash logs\n");
+		}
+		else if (tick == -1) {
+			printf("Hash logs match\n");
+		}
+		else {
+			printf("Hash logs diverge at tick [%ld]\n", tick);
+		}
+		return (tick == -1) ? 0 : 1;
+	}
+
+	// usage: single_file_mario[_headless] --convert-level <in.txt> <out.sfml>
+	if (argc == 4 && strcmp(argv[1], "--convert-level") == 0) {
+		return level_convert(argv[2], argv[3]) ? 0 : 1;
+	}
+
+	// usage: single_file_mario[_headless] --bench <name>
+	if (argc == 3 && strcmp(argv[1], "--bench") == 0) {
+		return bench_run(argv[2]) ? 0 : 1;
+	}
+
 	game_t game;
 	game_init(WINDOW_CAPTION, &game);
+
+	// usage: single_file_mario[_headless] [--record <file>] [--replay <file>] [--hash-log <file>] [--threads <count>] [--render <dir> (headless only)] [--capture <file>] [--capture-png <dir>] [tick_count (headless only)]
+	long ticks = -1;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			input_recorder_open(&game.recorder, argv[++i], game.controller_count);
+		}
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			input_playback_open(&game.playback, argv[++i]);
+		}
+		else if (strcmp(argv[i], "--hash-log") == 0 && i + 1 < argc) {
+			game.hash_log = fopen(argv[++i], "w");
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			job_system_free(&game.jobs);
+			job_system_init(&game.jobs, atoi(argv[++i]));
+		}
+		else if ((strcmp(argv[i], "--capture") == 0 || strcmp(argv[i], "--capture-png") == 0) && i + 1 < argc) {
+			capture_format_t format = (strcmp(argv[i], "--capture") == 0) ? CAPTURE_RAW : CAPTURE_PNG;
+			frame_capture_close(&game.capture);
+			if (!frame_capture_open(&game.capture, argv[++i], format, GAME_WIDTH, GAME_HEIGHT)) {
+				game_end(&game);
+				return 1;
+			}
+		}
+#ifdef HEADLESS
+		else if (strcmp(argv[i], "--render") == 0 && i + 1 < argc) {
+			if (!game_init_soft(&game, argv[++i])) {
+				game_end(&game);
+				return 1;
+			}
+		}
+#endif
+		else {
+			ticks = atol(argv[i]);
+		}
+	}
+	if (ticks < 0) {
+		// replays run until they end, unless a tick count is given
+		ticks = (game.playback.file != NULL) ? LONG_MAX : HEADLESS_DEFAULT_TICKS;
+	}
+
+#ifdef HEADLESS
+	game_run_headless(&game, ticks);
+#else
+	game_run(&game);
+#endif
 	game_end(&game);
-}
\ No newline at end of file
+}
\ No newline at end of file